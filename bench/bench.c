@@ -0,0 +1,157 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include <json.h>
+
+#include "corpus.h"
+
+#define BENCH_MIN_REPS     3
+#define BENCH_MAX_REPS     50
+#define BENCH_MIN_SECONDS  0.25
+
+typedef struct bench_corpus
+{
+  const char *name;
+  const corpus_shape *shape;
+  corpus corpus;
+} bench_corpus;
+
+static double
+now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+run_corpus (bench_corpus *corpus, int first)
+{
+  json_counting_allocator counting;
+  json_decoder_opts opts = STD_DECODER_OPTS;
+  double decode = 1e30, print = 1e30, destroy = 1e30, total = 0;
+  size_t printed = 0, allocs = 0, peak = 0;
+  int reps       = 0;
+
+  json_counting_allocator_init (&counting, NULL);
+  opts.allocator = &counting.allocator;
+  opts.ext_flags |= corpus->shape->ext_flags;
+
+  while (reps < BENCH_MIN_REPS
+         || (reps < BENCH_MAX_REPS && total < BENCH_MIN_SECONDS))
+    {
+      json_decode_error error;
+      json_value *value;
+      double t0, t1, t2, t3, t4;
+      char *str;
+
+      json_counting_allocator_reset (&counting);
+
+      t0    = now ();
+      value = json_decode (&opts, corpus->corpus.text.data,
+                           corpus->corpus.text.len, &error);
+      t1    = now ();
+
+      if (!value)
+        {
+          fprintf (stderr, "%s: %zu:%zu: error: %s\n", corpus->name,
+                   error.row, error.col, json_error_to_str (error.error));
+          exit (-1);
+        }
+
+      allocs = counting.stats.allocs + counting.stats.reallocs;
+      peak   = counting.stats.bytes_peak;
+
+      json_value_asprint (&str, value);
+      t2 = now ();
+
+      printed = strlen (str);
+      free (str);
+
+      t3 = now ();
+      json_value_destroy_ext (&counting.allocator, value);
+      t4 = now ();
+
+      decode  = t1 - t0 < decode ? t1 - t0 : decode;
+      print   = t2 - t1 < print ? t2 - t1 : print;
+      destroy = t4 - t3 < destroy ? t4 - t3 : destroy;
+      total += t4 - t0;
+      ++reps;
+    }
+
+  printf ("%s    {\n", first ? "" : ",\n");
+  printf ("      \"corpus\": \"%s\",\n", corpus->name);
+  printf ("      \"bytes\": %zu,\n", corpus->corpus.text.len);
+  printf ("      \"values\": %zu,\n", corpus->corpus.values);
+  printf ("      \"reps\": %d,\n", reps);
+  printf ("      \"decode_mb_s\": %.1f,\n",
+          corpus->corpus.text.len / decode / 1e6);
+  printf ("      \"decode_ns_per_value\": %.1f,\n",
+          decode * 1e9 / corpus->corpus.values);
+  printf ("      \"print_mb_s\": %.1f,\n", printed / print / 1e6);
+  printf ("      \"destroy_ns_per_value\": %.1f,\n",
+          destroy * 1e9 / corpus->corpus.values);
+  printf ("      \"allocs_per_doc\": %zu,\n", allocs);
+  printf ("      \"peak_bytes_per_doc\": %zu\n", peak);
+  printf ("    }");
+}
+
+int
+main (int argc, char *argv[])
+{
+  static struct
+  {
+    const char *name, *shape;
+    unsigned indent;
+  } corpora[] = {
+    { "numbers", "numbers", 0 },
+    { "digits", "digits", 0 },
+    { "strings", "strings", 0 },
+    { "escapes", "escapes", 0 },
+    { "unicode", "unicode", 0 },
+    { "deep", "deep", 0 },
+    { "wide", "wide", 0 },
+    { "records_minified", "records", 0 },
+    { "records_pretty", "records", 2 },
+    { "records_commented", "comments", 0 },
+  };
+  corpus_opts opts = CORPUS_DEFAULT_OPTS;
+  size_t size;
+  struct rusage usage;
+
+  if (argc > 1)
+    opts.size = strtoull (argv[1], NULL, 10);
+
+  size = opts.size;
+
+  printf ("{\n  \"corpus_size\": %zu,\n  \"results\": [\n", size);
+
+  for (size_t i = 0; i < sizeof (corpora) / sizeof (corpora[0]); ++i)
+    {
+      bench_corpus corpus = {
+        .name  = corpora[i].name,
+        .shape = corpus_find_shape (corpora[i].shape),
+      };
+
+      // indentation makes the records about 5/3 as large
+      opts.indent = corpora[i].indent;
+      opts.size   = opts.indent ? size * 3 / 5 : size;
+
+      corpus_generate (&corpus.corpus, corpus.shape, &opts);
+      run_corpus (&corpus, !i);
+      corpus_free (&corpus.corpus);
+    }
+
+  getrusage (RUSAGE_SELF, &usage);
+
+  printf ("\n  ],\n  \"peak_rss_kb\": %ld\n}\n", usage.ru_maxrss);
+
+  return 0;
+}
@@ -0,0 +1,548 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <json.h>
+
+#include "corpus.h"
+
+/**
+ * xorshift64*, so the corpora only depend on the seed.
+ */
+
+static unsigned long long
+rng (corpus *corpus)
+{
+  corpus->rng ^= corpus->rng >> 12;
+  corpus->rng ^= corpus->rng << 25;
+  corpus->rng ^= corpus->rng >> 27;
+
+  return corpus->rng * 0x2545F4914F6CDD1DULL;
+}
+
+static void
+buf_reserve (corpus_buf *buf, size_t n)
+{
+  if (buf->len + n + 1 <= buf->cap)
+    return;
+
+  while (buf->len + n + 1 > buf->cap)
+    buf->cap = buf->cap ? buf->cap * 2 : 4096;
+
+  if (!(buf->data = realloc (buf->data, buf->cap)))
+    {
+      fprintf (stderr, "out of memory\n");
+      exit (-1);
+    }
+}
+
+static void
+buf_putc (corpus_buf *buf, char ch)
+{
+  buf_reserve (buf, 1);
+  buf->data[buf->len++] = ch;
+  buf->data[buf->len]   = '\0';
+}
+
+static void
+buf_puts (corpus_buf *buf, const char *str)
+{
+  size_t n = strlen (str);
+
+  buf_reserve (buf, n);
+  memcpy (buf->data + buf->len, str, n + 1);
+  buf->len += n;
+}
+
+static void
+buf_printf (corpus_buf *buf, const char *fmt, ...)
+{
+  va_list args;
+  int n;
+
+  va_start (args, fmt);
+  n = vsnprintf (NULL, 0, fmt, args);
+  va_end (args);
+
+  buf_reserve (buf, (size_t) n);
+
+  va_start (args, fmt);
+  vsnprintf (buf->data + buf->len, (size_t) n + 1, fmt, args);
+  va_end (args);
+
+  buf->len += (size_t) n;
+}
+
+static void
+buf_put_utf8 (corpus_buf *buf, unsigned long cp)
+{
+  if (cp < 0x80)
+    buf_putc (buf, (char) cp);
+  else if (cp < 0x800)
+    {
+      buf_putc (buf, (char) (0xC0 | (cp >> 6)));
+      buf_putc (buf, (char) (0x80 | (cp & 0x3F)));
+    }
+  else if (cp < 0x10000)
+    {
+      buf_putc (buf, (char) (0xE0 | (cp >> 12)));
+      buf_putc (buf, (char) (0x80 | ((cp >> 6) & 0x3F)));
+      buf_putc (buf, (char) (0x80 | (cp & 0x3F)));
+    }
+  else
+    {
+      buf_putc (buf, (char) (0xF0 | (cp >> 18)));
+      buf_putc (buf, (char) (0x80 | ((cp >> 12) & 0x3F)));
+      buf_putc (buf, (char) (0x80 | ((cp >> 6) & 0x3F)));
+      buf_putc (buf, (char) (0x80 | (cp & 0x3F)));
+    }
+}
+
+/**
+ * Integers, negative integers, fractions and exponents in equal measure.
+ */
+
+static void
+gen_numbers (corpus *corpus, const corpus_opts *opts)
+{
+  corpus_buf *buf = &corpus->text;
+
+  buf_puts (buf, "[");
+
+  while (buf->len < opts->size)
+    {
+      unsigned long long r = rng (corpus);
+
+      if (corpus->values++)
+        buf_puts (buf, ",");
+
+      switch (r % 4)
+        {
+        case 0:
+          buf_printf (buf, "%llu", (r >> 8) % 1000);
+          break;
+        case 1:
+          buf_printf (buf, "-%llu", r >> 20);
+          break;
+        case 2:
+          buf_printf (buf, "%.17g", (double) (r >> 11) / 9007199254740992.0);
+          break;
+        default:
+          buf_printf (buf, "%llu.%02llue%d", (r >> 8) % 100, (r >> 16) % 100,
+                      (int) ((r >> 32) % 600) - 300);
+          break;
+        }
+    }
+
+  buf_puts (buf, "]");
+  ++corpus->values;
+}
+
+/**
+ * Numbers with min_digits to max_digits integer digits, half of them
+ * negative, each followed by frac_digits fraction digits.
+ */
+
+static void
+gen_digits (corpus *corpus, const corpus_opts *opts)
+{
+  corpus_buf *buf = &corpus->text;
+  unsigned lo     = opts->min_digits ? opts->min_digits : 1;
+  unsigned hi     = opts->max_digits > lo ? opts->max_digits : lo;
+
+  buf_puts (buf, "[");
+
+  while (buf->len < opts->size)
+    {
+      unsigned long long r = rng (corpus);
+      unsigned n           = lo + (unsigned) ((r >> 1) % (hi - lo + 1));
+
+      if (corpus->values++)
+        buf_puts (buf, ",");
+
+      if (r & 1)
+        buf_putc (buf, '-');
+
+      // no leading zeros
+      buf_putc (buf, (char) ('0' + (n > 1 ? 1 + rng (corpus) % 9
+                                          : rng (corpus) % 10)));
+
+      for (unsigned i = 1; i < n; ++i)
+        buf_putc (buf, (char) ('0' + rng (corpus) % 10));
+
+      if (opts->frac_digits)
+        {
+          buf_putc (buf, '.');
+
+          for (unsigned i = 0; i < opts->frac_digits; ++i)
+            buf_putc (buf, (char) ('0' + rng (corpus) % 10));
+        }
+    }
+
+  buf_puts (buf, "]");
+  ++corpus->values;
+}
+
+/**
+ * Mostly ASCII words with the odd escape and multi-byte character.
+ */
+
+static void
+gen_strings (corpus *corpus, const corpus_opts *opts)
+{
+  static const char *words[] = {
+    "lorem", "ipsum", "dolor", "sit", "amet", "caf\xC3\xA9", "\\n",
+    "\\\"quoted\\\"", "\\u00e9t\\u00e9", "\xE6\x97\xA5\xE6\x9C\xAC", "path\\/to",
+  };
+  corpus_buf *buf = &corpus->text;
+
+  buf_puts (buf, "[");
+
+  while (buf->len < opts->size)
+    {
+      unsigned long long r = rng (corpus);
+      size_t n_words       = 1 + r % 24;
+
+      if (corpus->values++)
+        buf_puts (buf, ",");
+
+      buf_puts (buf, "\"");
+
+      for (size_t i = 0; i < n_words; ++i)
+        {
+          if (i)
+            buf_puts (buf, " ");
+
+          buf_puts (buf, words[(rng (corpus) >> 8)
+                               % (sizeof (words) / sizeof (words[0]))]);
+        }
+
+      buf_puts (buf, "\"");
+    }
+
+  buf_puts (buf, "]");
+  ++corpus->values;
+}
+
+/**
+ * Strings in which about half of the characters are escape sequences,
+ * including \u escapes of control characters.
+ */
+
+static void
+gen_escapes (corpus *corpus, const corpus_opts *opts)
+{
+  static const char *escapes[] = {
+    "\\\"", "\\\\", "\\/", "\\b", "\\f", "\\n", "\\r", "\\t",
+  };
+  corpus_buf *buf = &corpus->text;
+
+  buf_puts (buf, "[");
+
+  while (buf->len < opts->size)
+    {
+      size_t n_chars = 1 + rng (corpus) % 64;
+
+      if (corpus->values++)
+        buf_puts (buf, ",");
+
+      buf_puts (buf, "\"");
+
+      for (size_t i = 0; i < n_chars; ++i)
+        {
+          unsigned long long r = rng (corpus);
+
+          if (r % 2)
+            buf_putc (buf, (char) ('a' + (r >> 8) % 26));
+          else if (r % 16)
+            buf_puts (buf, escapes[(r >> 8) % (sizeof (escapes)
+                                               / sizeof (escapes[0]))]);
+          else
+            buf_printf (buf, "\\u%04x", (unsigned) ((r >> 8) % 0x20));
+        }
+
+      buf_puts (buf, "\"");
+    }
+
+  buf_puts (buf, "]");
+  ++corpus->values;
+}
+
+/**
+ * Strings of non-ASCII text: two, three and four byte UTF-8 sequences, and
+ * \u escapes of BMP characters and surrogate pairs.
+ */
+
+static void
+gen_unicode (corpus *corpus, const corpus_opts *opts)
+{
+  corpus_buf *buf = &corpus->text;
+
+  buf_puts (buf, "[");
+
+  while (buf->len < opts->size)
+    {
+      size_t n_chars = 1 + rng (corpus) % 32;
+
+      if (corpus->values++)
+        buf_puts (buf, ",");
+
+      buf_puts (buf, "\"");
+
+      for (size_t i = 0; i < n_chars; ++i)
+        {
+          unsigned long long r = rng (corpus);
+          unsigned long cp;
+
+          switch (r % 8)
+            {
+            case 0:
+              buf_putc (buf, ' ');
+              continue;
+            case 1:
+            case 2:
+              cp = 0x80 + (r >> 8) % (0x800 - 0x80);
+              break;
+            case 3:
+            case 4:
+              // skip the surrogates, which UTF-8 cannot encode
+              cp = 0x800 + (r >> 8) % (0x10000 - 0x800 - 0x800);
+              cp += cp >= 0xD800 ? 0x800 : 0;
+              break;
+            case 5:
+              cp = 0x10000 + (r >> 8) % (0x110000 - 0x10000);
+              break;
+            case 6:
+              buf_printf (buf, "\\u%04lx",
+                          0x80 + (unsigned long) ((r >> 8) % 0xD780));
+              continue;
+            default:
+              cp = (unsigned long) ((r >> 8) % 0x100000);
+              buf_printf (buf, "\\u%04lx\\u%04lx", 0xD800 + (cp >> 10),
+                          0xDC00 + (cp & 0x3FF));
+              continue;
+            }
+
+          buf_put_utf8 (buf, cp);
+        }
+
+      buf_puts (buf, "\"");
+    }
+
+  buf_puts (buf, "]");
+  ++corpus->values;
+}
+
+/**
+ * Elements nested depth levels deep in alternating arrays and objects.
+ */
+
+static void
+gen_deep (corpus *corpus, const corpus_opts *opts)
+{
+  corpus_buf *buf = &corpus->text;
+  size_t depth    = opts->depth;
+
+  buf_puts (buf, "[");
+
+  while (buf->len < opts->size)
+    {
+      if (corpus->values++)
+        buf_puts (buf, ",");
+
+      for (size_t i = 0; i < depth; ++i)
+        buf_puts (buf, i % 2 ? "{\"a\":" : "[");
+
+      buf_puts (buf, "1");
+
+      for (size_t i = depth; i--;)
+        buf_puts (buf, i % 2 ? "}" : "]");
+
+      corpus->values += depth;
+    }
+
+  buf_puts (buf, "]");
+  ++corpus->values;
+}
+
+/**
+ * A single object with as many members as fit.
+ */
+
+static void
+gen_wide (corpus *corpus, const corpus_opts *opts)
+{
+  corpus_buf *buf = &corpus->text;
+
+  buf_puts (buf, "{");
+
+  while (buf->len < opts->size)
+    {
+      if (corpus->values)
+        buf_puts (buf, ",");
+
+      buf_printf (buf, "\"key_%08zu\":%llu", corpus->values++,
+                  rng (corpus) % 100);
+    }
+
+  buf_puts (buf, "}");
+  ++corpus->values;
+}
+
+/**
+ * An array of small records of mixed types, like a typical API response.
+ */
+
+static void
+gen_records (corpus *corpus, const corpus_opts *opts)
+{
+  corpus_buf *buf = &corpus->text;
+  size_t id       = 0;
+
+  buf_puts (buf, "[");
+
+  while (buf->len < opts->size)
+    {
+      unsigned long long r = rng (corpus);
+
+      if (id)
+        buf_puts (buf, ",");
+
+      buf_printf (buf,
+                  "{\"id\":%zu,\"name\":\"user%llu\",\"active\":%s,"
+                  "\"score\":%.2f,\"tags\":[\"red\",\"green\",\"blue\"],"
+                  "\"geo\":{\"lat\":%.6f,\"lon\":%.6f},\"note\":null}",
+                  id++, r % 100000, r & 1 ? "true" : "false",
+                  (double) (r % 10000) / 100.0,
+                  (double) (r % 180000000) / 1e6 - 90.0,
+                  (double) ((r >> 24) % 360000000) / 1e6 - 180.0);
+
+      // the record, its 7 members and the 5 values nested in tags and geo
+      corpus->values += 13;
+    }
+
+  buf_puts (buf, "]");
+  ++corpus->values;
+}
+
+/**
+ * Records like gen_records, each under a block comment and with a line
+ * comment on every member, as in a hand-maintained config file.
+ */
+
+static void
+gen_comments (corpus *corpus, const corpus_opts *opts)
+{
+  corpus_buf *buf = &corpus->text;
+  size_t id       = 0;
+
+  buf_puts (buf, "[\n");
+
+  while (buf->len < opts->size)
+    {
+      unsigned long long r = rng (corpus);
+
+      if (id)
+        buf_puts (buf, ",\n");
+
+      buf_printf (buf,
+                  "/*\n * record %zu\n *\n * generated, do not edit\n */\n"
+                  "{\n\"id\": %zu, // the key\n"
+                  "\"name\": \"user%llu\", // display name\n"
+                  "\"active\": %s, // may log in\n"
+                  "\"score\": %.2f, /* 0 to 100 */\n"
+                  "\"tags\": [\"red\", \"green\", \"blue\"], // free form\n"
+                  "\"geo\": {\"lat\": %.6f, \"lon\": %.6f}, // degrees\n"
+                  "\"note\": null // unused\n}",
+                  id, id, r % 100000, r & 1 ? "true" : "false",
+                  (double) (r % 10000) / 100.0,
+                  (double) (r % 180000000) / 1e6 - 90.0,
+                  (double) ((r >> 24) % 360000000) / 1e6 - 180.0);
+
+      ++id;
+      corpus->values += 13;
+    }
+
+  buf_puts (buf, "\n]");
+  ++corpus->values;
+}
+
+const corpus_shape corpus_shapes[] = {
+  { "numbers", gen_numbers, 0 },
+  { "digits", gen_digits, 0 },
+  { "strings", gen_strings, 0 },
+  { "escapes", gen_escapes, 0 },
+  { "unicode", gen_unicode, 0 },
+  { "deep", gen_deep, 0 },
+  { "wide", gen_wide, 0 },
+  { "records", gen_records, 0 },
+  { "comments", gen_comments, JSON_EXT_COMMENTS },
+};
+
+const size_t corpus_n_shapes
+    = sizeof (corpus_shapes) / sizeof (corpus_shapes[0]);
+
+const corpus_shape *
+corpus_find_shape (const char *name)
+{
+  for (size_t i = 0; i < corpus_n_shapes; ++i)
+    if (!strcmp (corpus_shapes[i].name, name))
+      return corpus_shapes + i;
+
+  return NULL;
+}
+
+static json_error
+corpus_write (const char *src, size_t size, void *ctx)
+{
+  corpus_buf *buf = ctx;
+
+  buf_reserve (buf, size);
+  memcpy (buf->data + buf->len, src, size);
+  buf->len += size;
+  buf->data[buf->len] = '\0';
+
+  return JSON_ERROR_NONE;
+}
+
+void
+corpus_generate (corpus *corpus, const corpus_shape *shape,
+                 const corpus_opts *opts)
+{
+  json_decoder_opts decoder_opts = STD_DECODER_OPTS;
+  json_writer writer;
+  corpus_buf minified;
+
+  // xorshift never leaves zero
+  corpus->rng = opts->seed ? opts->seed : 0x9E3779B97F4A7C15ULL;
+
+  shape->gen (corpus, opts);
+
+  if (!opts->indent)
+    return;
+
+  minified     = corpus->text;
+  corpus->text = (corpus_buf) { 0 };
+
+  // comments are dropped along with the rest of the whitespace
+  decoder_opts.ext_flags |= shape->ext_flags;
+  writer = (json_writer) { .ctx = &corpus->text, .json_write = corpus_write };
+
+  if (json_prettify (&decoder_opts, opts->indent, minified.data, minified.len,
+                     &writer, NULL)
+      != JSON_ERROR_NONE)
+    {
+      fprintf (stderr, "%s: failed to prettify\n", shape->name);
+      exit (-1);
+    }
+
+  free (minified.data);
+}
+
+void
+corpus_free (corpus *corpus)
+{
+  free (corpus->text.data);
+  *corpus = (struct corpus) { 0 };
+}
@@ -0,0 +1,77 @@
+#ifndef CORPUS_H
+#define CORPUS_H 1
+
+#include <stddef.h>
+
+typedef struct corpus_buf
+{
+  char *data;
+  size_t len, cap;
+} corpus_buf;
+
+typedef struct corpus_opts
+{
+  unsigned long long seed;
+
+  // the size of the minified text to generate, in bytes; generation stops at
+  // the first element that reaches it
+  size_t size;
+
+  // integer digits of each number in the digits shape, uniformly distributed
+  // between the two, and the number of fraction digits, if any
+  unsigned min_digits, max_digits, frac_digits;
+
+  // the nesting depth of each element in the deep shape
+  unsigned depth;
+
+  // spaces per indentation level of pretty output, or zero to keep the text
+  // minified
+  unsigned indent;
+} corpus_opts;
+
+#define CORPUS_DEFAULT_OPTS                                                   \
+  {                                                                           \
+    .seed = 0x9E3779B97F4A7C15ULL, .size = 4 * 1024 * 1024, .min_digits = 1,  \
+    .max_digits = 8, .frac_digits = 0, .depth = 200, .indent = 0,             \
+  }
+
+typedef struct corpus
+{
+  corpus_buf text;
+
+  // the number of values in text, counting containers and their elements
+  size_t values;
+
+  unsigned long long rng;
+} corpus;
+
+typedef struct corpus_shape
+{
+  const char *name;
+  void (*gen) (corpus *corpus, const corpus_opts *opts);
+
+  // the extensions a decoder needs to accept the corpus
+  unsigned ext_flags;
+} corpus_shape;
+
+extern const corpus_shape corpus_shapes[];
+extern const size_t corpus_n_shapes;
+
+/**
+ * @return - the shape with the given name or NULL if there is none
+ */
+
+const corpus_shape *corpus_find_shape (const char *name);
+
+/**
+ * Generates a corpus of the given shape into an empty corpus. The text is
+ * the same for the same shape and options on every machine. Exits the
+ * process if memory runs out.
+ */
+
+void corpus_generate (corpus *corpus, const corpus_shape *shape,
+                      const corpus_opts *opts);
+
+void corpus_free (corpus *corpus);
+
+#endif
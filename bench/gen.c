@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <json.h>
+
+#include "corpus.h"
+
+static void
+usage (void)
+{
+  fprintf (stderr,
+           "usage: gen [options] SHAPE\n"
+           "\n"
+           "Writes a deterministic JSON corpus of the given shape.\n"
+           "\n"
+           "  --size=N           minified size in bytes, with an optional k or"
+           " m suffix\n"
+           "  --seed=N           random seed\n"
+           "  --indent=N         pretty print with N spaces per level\n"
+           "  --depth=N          nesting depth of the deep shape\n"
+           "  --digits=MIN[:MAX] integer digits of the digits shape\n"
+           "  --frac=N           fraction digits of the digits shape\n"
+           "  --verify           decode the corpus and check its value count\n"
+           "  -o FILE            write to FILE instead of stdout\n"
+           "\n"
+           "shapes:");
+
+  for (size_t i = 0; i < corpus_n_shapes; ++i)
+    fprintf (stderr, " %s", corpus_shapes[i].name);
+
+  fprintf (stderr, "\n");
+  exit (-1);
+}
+
+static unsigned long long
+parse_num (const char *str, const char **end)
+{
+  char *tmp;
+  unsigned long long n = strtoull (str, &tmp, 0);
+
+  if (tmp == str)
+    usage ();
+
+  *end = tmp;
+
+  return n;
+}
+
+/**
+ * @return - the value of a --name=value argument or NULL if arg is not one
+ */
+
+static const char *
+get_opt (const char *arg, const char *name)
+{
+  size_t len = strlen (name);
+
+  if (strncmp (arg, name, len) || arg[len] != '=')
+    return NULL;
+
+  return arg + len + 1;
+}
+
+/**
+ * Decodes the corpus with stats and checks that it holds the number of
+ * values the generator counted.
+ */
+
+static void
+verify (const corpus *corpus, const corpus_shape *shape)
+{
+  json_decoder_opts opts  = STD_DECODER_OPTS;
+  json_decode_stats stats = { { 0 } };
+  json_decode_error error;
+  json_value *value;
+  size_t values = 0;
+
+  opts.stats = &stats;
+  opts.ext_flags |= shape->ext_flags;
+
+  if (!(value = json_decode (&opts, corpus->text.data, corpus->text.len,
+                             &error)))
+    {
+      fprintf (stderr, "%s: %zu:%zu: error: %s\n", shape->name, error.row,
+               error.col, json_error_to_str (error.error));
+      exit (-1);
+    }
+
+  json_value_destroy (value);
+
+  for (size_t i = 0; i <= JSON_VALUE_TYPE_NULL; ++i)
+    values += stats.values[i];
+
+  if (values != corpus->values)
+    {
+      fprintf (stderr, "%s: decoded %zu values, generated %zu\n",
+               shape->name, values, corpus->values);
+      exit (-1);
+    }
+}
+
+int
+main (int argc, char *argv[])
+{
+  corpus_opts opts          = CORPUS_DEFAULT_OPTS;
+  const corpus_shape *shape = NULL;
+  const char *out_name      = NULL;
+  int check                 = 0;
+  corpus corpus             = { 0 };
+  FILE *out                 = stdout;
+
+  for (int i = 1; i < argc; ++i)
+    {
+      const char *arg = argv[i], *val, *end;
+
+      if ((val = get_opt (arg, "--size")))
+        {
+          opts.size = parse_num (val, &end);
+
+          if (*end == 'k' || *end == 'K')
+            opts.size <<= 10;
+          else if (*end == 'm' || *end == 'M')
+            opts.size <<= 20;
+        }
+      else if ((val = get_opt (arg, "--seed")))
+        opts.seed = parse_num (val, &end);
+      else if ((val = get_opt (arg, "--indent")))
+        opts.indent = (unsigned) parse_num (val, &end);
+      else if ((val = get_opt (arg, "--depth")))
+        opts.depth = (unsigned) parse_num (val, &end);
+      else if ((val = get_opt (arg, "--digits")))
+        {
+          opts.min_digits = (unsigned) parse_num (val, &end);
+          opts.max_digits = *end == ':' ? (unsigned) parse_num (end + 1, &end)
+                                        : opts.min_digits;
+        }
+      else if ((val = get_opt (arg, "--frac")))
+        opts.frac_digits = (unsigned) parse_num (val, &end);
+      else if (!strcmp (arg, "--verify"))
+        check = 1;
+      else if (!strcmp (arg, "-o") && i + 1 < argc)
+        out_name = argv[++i];
+      else if (arg[0] != '-' && !shape)
+        {
+          if (!(shape = corpus_find_shape (arg)))
+            usage ();
+        }
+      else
+        usage ();
+    }
+
+  if (!shape)
+    usage ();
+
+  corpus_generate (&corpus, shape, &opts);
+
+  if (check)
+    verify (&corpus, shape);
+
+  if (out_name && !(out = fopen (out_name, "wb")))
+    {
+      fprintf (stderr, "failed to open '%s'\n", out_name);
+      return -1;
+    }
+
+  if (fwrite (corpus.text.data, 1, corpus.text.len, out) != corpus.text.len
+      || (out != stdout && fclose (out)))
+    {
+      fprintf (stderr, "failed to write the corpus\n");
+      return -1;
+    }
+
+  corpus_free (&corpus);
+
+  return 0;
+}
@@ -26,10 +26,594 @@ typedef struct json_string json_string;
 
 typedef struct json_value json_value;
 
+typedef struct json_snapshot json_snapshot;
+typedef struct json_decoder json_decoder;
+typedef struct json_pool json_pool;
+typedef struct json_snapshot_value json_snapshot_value;
+
 json_value *json_decode (const json_decoder_opts *decoder_opts,
                          const char *buf, size_t size,
                          json_decode_error *decode_error);
 
+/**
+ * Updates a decoded value after an edit to its JSON text, re-decoding only the
+ * innermost value whose text contains the edit and splicing it into the tree.
+ * Falls back to decoding the whole text when the edit changes the structure
+ * around it, and always for UTF-16 or UTF-32 text or with lazy_numbers or
+ * pack_arrays set.
+ *
+ * NOTE: Values remember their offset in the text they were decoded from, so
+ * value must have been decoded from old_buf, by json_decode or an earlier call
+ * to this function, with the same options and must not have been modified
+ * since.
+ *
+ * @param [in]  decoder_opts - the decoder options or NULL for the defaults
+ * @param [in]  value        - the value decoded from old_buf
+ * @param [in]  old_buf      - the JSON text before the edit
+ * @param [in]  old_size     - the size of the text before the edit
+ * @param [in]  new_buf      - the JSON text after the edit
+ * @param [in]  new_size     - the size of the text after the edit
+ * @param [in]  edit_start   - the offset of the first changed byte
+ * @param [in]  edit_len     - the number of bytes of old_buf that were
+ * replaced, starting at edit_start
+ * @param [out] decode_error - the error and its location if not NULL
+ *
+ * @return - JSON_ERROR_NONE on success or another value on error, in which
+ * case value is left unchanged
+ */
+
+json_error json_redecode (const json_decoder_opts *decoder_opts,
+                          json_value *value, const char *old_buf,
+                          jusize old_size, const char *new_buf,
+                          jusize new_size, jusize edit_start, jusize edit_len,
+                          json_decode_error *decode_error);
+
+/**
+ * Creates a decoder that keeps its scratch memory, the buffer that UTF-16
+ * and UTF-32 input is transcoded into, from one text to the next. Once it
+ * has grown to fit the largest text, decoding with it only allocates the
+ * decoded values.
+ *
+ * NOTE: A decoder must not be used by more than one thread at a time.
+ *
+ * @param [in] decoder_opts - the decoder options or NULL for the defaults
+ *
+ * @return - the decoder or NULL on error
+ */
+
+json_decoder *json_decoder_create (const json_decoder_opts *decoder_opts);
+
+/**
+ * Decodes a JSON text like json_decode, with the options and scratch memory
+ * of a decoder.
+ *
+ * @param [in]  decoder      - the decoder to use
+ * @param [in]  buf          - the JSON text
+ * @param [in]  size         - the size of the text
+ * @param [out] decode_error - the error and its location if not NULL
+ *
+ * @return - the decoded value or NULL on error
+ */
+
+json_value *json_decoder_decode (json_decoder *decoder, const char *buf,
+                                 size_t size, json_decode_error *decode_error);
+
+/**
+ * Returns the scratch memory of a decoder to its allocator, for example
+ * after an unusually large text. The decoder stays usable.
+ *
+ * @param [in] decoder - the decoder to reset
+ */
+
+void json_decoder_reset (json_decoder *decoder);
+
+/**
+ * Releases a decoder and its scratch memory. Values it decoded are not
+ * affected.
+ *
+ * @param [in] decoder - the decoder to destroy or NULL
+ */
+
+void json_decoder_destroy (json_decoder *decoder);
+
+/**
+ * Decodes a JSON text read from a file descriptor, such as a file on slow
+ * storage or a pipe, reading on a background thread while decoding what has
+ * arrived. The elements of a root array are decoded as soon as each is read
+ * in full, so a long array takes about as long as the slower of reading and
+ * decoding it. Any other root, and UTF-16 or UTF-32 text or text with
+ * comment extensions, is decoded once it is all read. The result is the
+ * same as json_decode would produce for the text read, except that
+ * lazy_numbers is ignored.
+ *
+ * NOTE: fd is read until end of file, or until decoding fails, and is not
+ * closed. If the thread cannot be started, the text is read first and then
+ * decoded.
+ *
+ * @param [in]  decoder_opts - the decoder options or NULL for the defaults
+ * @param [in]  fd           - the file descriptor to read from
+ * @param [out] decode_error - the error and its location if not NULL
+ *
+ * @return - the decoded value or NULL on error, with JSON_ERROR_IO if reading
+ * failed
+ */
+
+json_value *json_decode_fd_pipelined (const json_decoder_opts *decoder_opts,
+                                      int fd, json_decode_error *decode_error);
+
+/**
+ * Checks that a JSON text would decode, without building any values. The
+ * text is checked by the same grammar as json_decode, with the same
+ * extensions, and fails with the same error at the same row and column,
+ * including JSON_ERROR_TOO_DEEP past max_depth. UTF-8 text is checked in
+ * place without calling the allocator; UTF-16 and UTF-32 text, recognized
+ * with JSON_EXT_DETECT_ENCODING, is first transcoded into a buffer from the
+ * allocator.
+ *
+ * NOTE: Duplicate object keys are not detected, as that would need memory
+ * for the keys of every open object, so JSON_EXT_ALLOW_DUP_KEYS is implied: a
+ * text that json_decode rejects with JSON_ERROR_DUP_KEY is accepted here.
+ * The stats and profile options still count what is checked.
+ *
+ * @param [in]  decoder_opts - the decoder options or NULL for the defaults
+ * @param [in]  buf          - the JSON text
+ * @param [in]  size         - the size of the text
+ * @param [out] decode_error - the error and its location if not NULL
+ *
+ * @return - JSON_ERROR_NONE if the text is valid or the error otherwise
+ */
+
+json_error json_validate (const json_decoder_opts *decoder_opts,
+                          const char *buf, size_t size,
+                          json_decode_error *decode_error);
+
+/**
+ * Creates a pool of worker threads for json_decode_batch. Every worker sets up
+ * its decoder state once and reuses it for each batch.
+ *
+ * NOTE: Workers allocate concurrently, so a custom allocator in decoder_opts
+ * must be thread-safe. Decode stats and profiles are not collected.
+ *
+ * @param [in] decoder_opts - the decoder options or NULL for the defaults
+ * @param [in] n_threads    - the number of workers, including the thread
+ * calling json_decode_batch, or zero for one per online CPU
+ *
+ * @return - the pool or NULL on error
+ */
+
+json_pool *json_pool_create (const json_decoder_opts *decoder_opts,
+                             jusize n_threads);
+
+/**
+ * Stops the workers of a pool and releases it.
+ *
+ * @param [in] pool - the pool to destroy
+ */
+
+void json_pool_destroy (json_pool *pool);
+
+/**
+ * Decodes a batch of independent JSON texts in parallel. The calling thread
+ * works alongside the pool, and workers that run out of inputs take over
+ * part of the remaining inputs of another. Each result is the same as
+ * json_decode would produce for that input, regardless of which worker
+ * decoded it.
+ *
+ * WARNING: A pool decodes one batch at a time; do not call this function
+ * concurrently on the same pool.
+ *
+ * @param [in]  pool    - the pool to decode with
+ * @param [in]  inputs  - the texts to decode
+ * @param [in]  n       - the number of texts
+ * @param [out] outputs - receives the decoded value of each text, or NULL if
+ * it failed to decode
+ * @param [out] errors  - receives the error and its location for each text
+ * if not NULL
+ *
+ * @return - JSON_ERROR_NONE if every text was decoded, otherwise the error of
+ * the first text that failed
+ */
+
+json_error json_decode_batch (json_pool *pool, const json_input inputs[],
+                              jusize n, json_value *outputs[],
+                              json_decode_error errors[]);
+
+/**
+ * Sets up an allocator that forwards to inner and counts allocations, frees,
+ * reallocations, live and peak bytes and allocation sizes. Blocks are
+ * allocated with a small header, so memory from it must only be released
+ * through it.
+ *
+ * @param [in] counting - the counting allocator to set up
+ * @param [in] inner    - the allocator to forward to or NULL for the default
+ */
+
+void json_counting_allocator_init (json_counting_allocator *counting,
+                                   json_allocator *inner);
+
+/**
+ * Zeroes the counts of a counting allocator, for example before each decode.
+ * Memory still allocated stays counted as live, and the peak restarts from
+ * it.
+ *
+ * @param [in] counting - the counting allocator to reset
+ */
+
+void json_counting_allocator_reset (json_counting_allocator *counting);
+
+/**
+ * Sets up an allocator for mutation-heavy workloads. Blocks of up to 504
+ * bytes are carved from slabs of JSON_SLAB_SIZE bytes taken from inner, and
+ * freed blocks go onto a free list for their size class to be handed out
+ * again, so values that are replaced and appended over and over reuse memory
+ * instead of going back to inner each time. Larger blocks are forwarded to
+ * inner. Blocks are aligned to 8 bytes.
+ *
+ * NOTE: Slabs are only returned to inner by json_slab_allocator_release.
+ * The allocator is not thread-safe.
+ *
+ * @param [in] slab  - the slab allocator to set up
+ * @param [in] inner - the allocator to take slabs from or NULL for the
+ * default
+ */
+
+void json_slab_allocator_init (json_slab_allocator *slab,
+                               json_allocator *inner);
+
+/**
+ * Returns every slab and forwarded block of a slab allocator to its inner
+ * allocator, including memory still held by values, and leaves it ready for
+ * reuse.
+ *
+ * @param [in] slab - the slab allocator to release
+ */
+
+void json_slab_allocator_release (json_slab_allocator *slab);
+
+/**
+ * Minifies a JSON text into a writer without building an in-memory
+ * representation. Whitespace is dropped and extension number literals are
+ * normalized to standard JSON; all other tokens are copied as written.
+ * Nesting past max_depth fails with JSON_ERROR_TOO_DEEP, as in json_decode.
+ *
+ * NOTE: Output is staged in a fixed-size buffer and flushed to the writer as
+ * it fills, so memory use does not depend on the size of the input. Output
+ * already flushed when an error is found is not retracted.
+ *
+ * NOTE: Duplicate keys are not detected since that requires remembering the
+ * keys of every open object.
+ *
+ * @param [in]  decoder_opts - the decoder options or NULL for the defaults
+ * @param [in]  buf          - the JSON text
+ * @param [in]  size         - the size of the JSON text
+ * @param [in]  writer       - the writer that receives the output
+ * @param [out] decode_error - the error and its location if not NULL
+ *
+ * @return - JSON_ERROR_NONE on success, the error returned by the writer or
+ * another value on error
+ */
+
+json_error json_minify (const json_decoder_opts *decoder_opts,
+                        const char *buf, size_t size, json_writer *writer,
+                        json_decode_error *decode_error);
+
+/**
+ * Pretty-prints a JSON text into a writer without building an in-memory
+ * representation. Each array element and object member is placed on its own
+ * line and indented by indent spaces per level of nesting.
+ *
+ * NOTE: Shares the streaming behavior and limitations of json_minify.
+ *
+ * @param [in]  decoder_opts - the decoder options or NULL for the defaults
+ * @param [in]  indent       - the number of spaces per level of nesting
+ * @param [in]  buf          - the JSON text
+ * @param [in]  size         - the size of the JSON text
+ * @param [in]  writer       - the writer that receives the output
+ * @param [out] decode_error - the error and its location if not NULL
+ *
+ * @return - JSON_ERROR_NONE on success, the error returned by the writer or
+ * another value on error
+ */
+
+json_error json_prettify (const json_decoder_opts *decoder_opts, ju32 indent,
+                          const char *buf, size_t size, json_writer *writer,
+                          json_decode_error *decode_error);
+
+/**
+ * Encodes a value as MessagePack using a custom allocator. Integral numbers
+ * are encoded as the smallest fitting integer, other numbers as float32 when
+ * that is exact and float64 otherwise. Members keep their order.
+ *
+ * @param [in]  allocator - the allocator used to allocate out_buf
+ * @param [in]  value     - the value to encode
+ * @param [out] out_buf   - the encoded bytes; ownership is transferred to
+ * caller
+ * @param [out] out_size  - the number of encoded bytes
+ *
+ * @return - JSON_ERROR_NONE on success or another value on error
+ */
+
+json_error json_msgpack_encode_ext (json_allocator *allocator,
+                                    json_value *value, char **out_buf,
+                                    jusize *out_size);
+
+/**
+ * Encodes a value as MessagePack.
+ *
+ * @param [in]  value    - the value to encode
+ * @param [out] out_buf  - the encoded bytes; free with free
+ * @param [out] out_size - the number of encoded bytes
+ *
+ * @return - JSON_ERROR_NONE on success or another value on error
+ */
+
+json_error json_msgpack_encode (json_value *value, char **out_buf,
+                                jusize *out_size);
+
+/**
+ * Decodes a MessagePack buffer. Map keys must be strings; bin and ext types
+ * are rejected with JSON_ERROR_DECODING, and arrays and maps nested past
+ * max_depth with JSON_ERROR_TOO_DEEP. On error, the col of decode_error holds
+ * the byte offset at which decoding stopped and its row is zero.
+ *
+ * @param [in]  decoder_opts - the decoder options, or NULL for the defaults
+ * @param [in]  buf          - the buffer to decode
+ * @param [in]  size         - the size of the buffer
+ * @param [out] decode_error - the error, if the pointer is not NULL
+ *
+ * @return - the decoded value or NULL on error
+ */
+
+json_value *json_msgpack_decode (const json_decoder_opts *decoder_opts,
+                                 const char *buf, size_t size,
+                                 json_decode_error *decode_error);
+
+/**
+ * Encodes a value as CBOR using a custom allocator. Integral numbers are
+ * encoded as major type 0 or 1, other numbers as float32 when that is exact
+ * and float64 otherwise. Lengths are always definite.
+ *
+ * @param [in]  allocator - the allocator used to allocate out_buf
+ * @param [in]  value     - the value to encode
+ * @param [out] out_buf   - the encoded bytes; ownership is transferred to
+ * caller
+ * @param [out] out_size  - the number of encoded bytes
+ *
+ * @return - JSON_ERROR_NONE on success or another value on error
+ */
+
+json_error json_cbor_encode_ext (json_allocator *allocator, json_value *value,
+                                 char **out_buf, jusize *out_size);
+
+/**
+ * Encodes a value as CBOR.
+ *
+ * @param [in]  value    - the value to encode
+ * @param [out] out_buf  - the encoded bytes; free with free
+ * @param [out] out_size - the number of encoded bytes
+ *
+ * @return - JSON_ERROR_NONE on success or another value on error
+ */
+
+json_error json_cbor_encode (json_value *value, char **out_buf,
+                             jusize *out_size);
+
+/**
+ * Decodes a CBOR buffer. Indefinite lengths, half floats and tags are
+ * accepted; tags are ignored and undefined decodes as null. Map keys must be
+ * text strings and byte strings are rejected with JSON_ERROR_DECODING, and
+ * arrays and maps nested past max_depth with JSON_ERROR_TOO_DEEP. On error,
+ * the col of decode_error holds the byte offset at which decoding stopped and
+ * its row is zero.
+ *
+ * @param [in]  decoder_opts - the decoder options, or NULL for the defaults
+ * @param [in]  buf          - the buffer to decode
+ * @param [in]  size         - the size of the buffer
+ * @param [out] decode_error - the error, if the pointer is not NULL
+ *
+ * @return - the decoded value or NULL on error
+ */
+
+json_value *json_cbor_decode (const json_decoder_opts *decoder_opts,
+                              const char *buf, size_t size,
+                              json_decode_error *decode_error);
+
+/**
+ * Writes a relocatable binary image of a value to a file descriptor, using a
+ * custom allocator for the writer's buffers. The image holds offsets instead
+ * of pointers and can be mapped by json_snapshot_open without parsing. It
+ * uses the byte order of the writing machine. It must be written at the
+ * start of an otherwise empty file.
+ *
+ * @param [in] allocator - the custom allocator to use
+ * @param [in] value     - the value to write
+ * @param [in] fd        - the file descriptor to write to
+ *
+ * @returns - JSON_ERROR_NONE:
+ * @returns - JSON_ERROR_ENCODING: a string, array or object is too large
+ * @returns - JSON_ERROR_IO:       writing to fd failed
+ */
+
+json_error json_snapshot_write_ext (json_allocator *allocator,
+                                    json_value *value, int fd);
+
+/**
+ * Writes a relocatable binary image of a value to a file descriptor, like
+ * json_snapshot_write_ext with the default allocator.
+ *
+ * @param [in] value - the value to write
+ * @param [in] fd    - the file descriptor to write to
+ *
+ * @returns - JSON_ERROR_NONE:
+ * @returns - JSON_ERROR_ENCODING: a string, array or object is too large
+ * @returns - JSON_ERROR_IO:       writing to fd failed
+ */
+
+json_error json_snapshot_write (json_value *value, int fd);
+
+/**
+ * Maps a snapshot written by json_snapshot_write read-only, allocating its
+ * handle with a custom allocator, which json_snapshot_close frees it with.
+ * Its values are accessed in place; mapping it does not allocate per value.
+ * Only the header is validated, so snapshots must come from a trusted
+ * source.
+ *
+ * @param [in]  allocator    - the custom allocator to use
+ * @param [in]  path         - the path of the snapshot
+ * @param [out] out_snapshot - the opened snapshot
+ *
+ * @returns - JSON_ERROR_NONE:
+ * @returns - JSON_ERROR_IO:           the file could not be opened or mapped
+ * @returns - JSON_ERROR_BAD_SNAPSHOT: the file is not a compatible snapshot
+ */
+
+json_error json_snapshot_open_ext (json_allocator *allocator,
+                                   const char *path,
+                                   json_snapshot **out_snapshot);
+
+/**
+ * Maps a snapshot like json_snapshot_open_ext with the default allocator.
+ *
+ * @param [in]  path         - the path of the snapshot
+ * @param [out] out_snapshot - the opened snapshot
+ *
+ * @returns - JSON_ERROR_NONE:
+ * @returns - JSON_ERROR_IO:           the file could not be opened or mapped
+ * @returns - JSON_ERROR_BAD_SNAPSHOT: the file is not a compatible snapshot
+ */
+
+json_error json_snapshot_open (const char *path, json_snapshot **out_snapshot);
+
+/**
+ * Unmaps a snapshot. Invalidates every value retrieved from it.
+ *
+ * @param [in] snapshot - the snapshot to close
+ */
+
+void json_snapshot_close (json_snapshot *snapshot);
+
+/**
+ * Retrieves the root value of a snapshot.
+ *
+ * @param [in] snapshot - the snapshot
+ *
+ * @return - the root value
+ */
+
+const json_snapshot_value *json_snapshot_root (json_snapshot *snapshot);
+
+/**
+ * Retrieves the value type of a snapshot value.
+ *
+ * @param [in] value - the value to retrieve the type of
+ *
+ * @return - the type of the value
+ */
+
+json_value_type json_snapshot_get_type (const json_snapshot_value *value);
+
+/**
+ * Retrieves the number of a snapshot value.
+ *
+ * @param [in]  value - the value to retrieve the number from
+ * @param [out] n     - the pointer to store the number into
+ *
+ * @return - JSON_TRUE if the value is a number or JSON_FALSE otherwise
+ */
+
+json_bool json_snapshot_get_number (const json_snapshot_value *value,
+                                    json_number *n);
+
+/**
+ * Retrieves the bool of a snapshot value.
+ *
+ * @param [in]  value - the value to retrieve the bool from
+ * @param [out] b     - the pointer to store the bool into
+ *
+ * @return - JSON_TRUE if the value is a bool or JSON_FALSE otherwise
+ */
+
+json_bool json_snapshot_get_bool (const json_snapshot_value *value,
+                                  json_bool *b);
+
+/**
+ * Determines if a snapshot value is null.
+ *
+ * @param [in] value - the value to determine
+ *
+ * @return - JSON_TRUE if the value is null or JSON_FALSE otherwise
+ */
+
+json_bool json_snapshot_is_null (const json_snapshot_value *value);
+
+/**
+ * Retrieves the NUL-terminated UTF-8 contents of a snapshot string.
+ *
+ * @param [in]  value - the value to retrieve the string from
+ * @param [out] str   - the pointer to store the contents into
+ * @param [out] len   - the length of the string in bytes, if the pointer is
+ * not NULL
+ *
+ * @return - JSON_TRUE if the value is a string or JSON_FALSE otherwise
+ */
+
+json_bool json_snapshot_get_string (const json_snapshot_value *value,
+                                    const char **str, jusize *len);
+
+/**
+ * Retrieves the number of elements of a snapshot array or members of a
+ * snapshot object.
+ *
+ * @param [in] value - the array or object
+ *
+ * @return - the number of elements or members, or 0 for other types
+ */
+
+jusize json_snapshot_size (const json_snapshot_value *value);
+
+/**
+ * Retrieves an element from a snapshot array.
+ *
+ * @param [in] array - the array to get an element from
+ * @param [in] index - the index of the element
+ *
+ * @return - the element or NULL if the index is out of bounds or the value is
+ * not an array
+ */
+
+const json_snapshot_value *
+json_snapshot_array_get (const json_snapshot_value *array, jusize index);
+
+/**
+ * Gets the value from a snapshot object associated with the key.
+ *
+ * @param [in] object - the object to search
+ * @param [in] key    - the key to search for
+ *
+ * @return - value associated with key or NULL if no value is associated
+ * with the key
+ */
+
+const json_snapshot_value *
+json_snapshot_object_get (const json_snapshot_value *object, const char *key);
+
+/**
+ * Retrieves a member of a snapshot object by position, in the order the
+ * members were decoded.
+ *
+ * @param [in]  object  - the object to get a member from
+ * @param [in]  index   - the position of the member
+ * @param [out] key     - the NUL-terminated key, if the pointer is not NULL
+ * @param [out] key_len - the length of the key, if the pointer is not NULL
+ *
+ * @return - the value of the member or NULL if the index is out of bounds or
+ * the value is not an object
+ */
+
+const json_snapshot_value *
+json_snapshot_object_at (const json_snapshot_value *object, jusize index,
+                         const char **key, jusize *key_len);
+
 /**
  * Gets the value from a json_object associated with the key.
  *
@@ -42,6 +626,33 @@ json_value *json_decode (const json_decoder_opts *decoder_opts,
 
 json_value *json_object_get (json_object *object, const char *key);
 
+/**
+ * Makes a key handle for json_object_get_key.
+ *
+ * @param [in] key - the NUL-terminated key, which must outlive the handle
+ *
+ * @return - the key with its length and hash
+ */
+
+json_key json_key_make (const char *key);
+
+/**
+ * Gets the value from a json_object associated with a key handle. The entry
+ * position of the last match is tried before the hash lookup, so looking up
+ * the same key in objects of the same shape costs a single comparison.
+ *
+ * NOTE: A handle may be shared between threads. Concurrent lookups only
+ * race to update the remembered position, which is a hint.
+ *
+ * @param [in] object - the object to search
+ * @param [in] key    - the key to search for, made by json_key_make
+ *
+ * @return - value associated with key or NULL if no value is associated
+ * with the key
+ */
+
+json_value *json_object_get_key (json_object *object, json_key *key);
+
 /**
  * Removes a key-entry pair from a json_object using a custom allocator.
  *
@@ -111,14 +722,124 @@ json_error json_object_put (json_object *object, const char *key,
 /**
  * Retrieves an element from a json_array.
  *
+ * NOTE: A packed array, decoded with pack_arrays, is converted to an array of
+ * values on the first call, with the allocator it was decoded with. The first
+ * call must not race with other reads of the same array.
+ *
  * @param [in] array - the array to get an element from
  * @param [in] index - the index of the element
  *
  * @return - the index of the element or NULL if the index is out of bounds
+ * or a packed array could not be converted
  */
 
 json_value *json_array_get (json_array *array, jusize index);
 
+/**
+ * Copies the leading numbers of an array into out without converting a
+ * packed array.
+ *
+ * @param [in]  array - the array to read
+ * @param [out] out   - the buffer to copy the numbers into
+ * @param [in]  n     - the maximum number of numbers to copy
+ *
+ * @return - the number of numbers copied, which stops short of n at the end
+ * of the array or at the first element that is not a number
+ */
+
+jusize json_array_get_numbers (json_array *array, json_number *out,
+                               jusize n);
+
+/**
+ * Copies the leading bools of an array into out without converting a packed
+ * array.
+ *
+ * @param [in]  array - the array to read
+ * @param [out] out   - the buffer to copy the bools into
+ * @param [in]  n     - the maximum number of bools to copy
+ *
+ * @return - the number of bools copied, which stops short of n at the end of
+ * the array or at the first element that is not a bool
+ */
+
+jusize json_array_get_bools (json_array *array, json_bool *out, jusize n);
+
+/**
+ * Retrieves the elements of a packed array of numbers in place. The view is
+ * valid until the array is next modified or read with json_array_get.
+ *
+ * @param [in] array - the array to view
+ *
+ * @return - the numbers of the array or NULL if it is not a packed array of
+ * numbers
+ */
+
+const json_number *json_array_view_numbers (json_array *array);
+
+/**
+ * Extracts fields of the objects in an array into typed columns using a
+ * custom allocator, in one pass over the array. Elements that are not objects
+ * leave every cell of their row invalid.
+ *
+ * @param [in]  allocator - the custom allocator to use
+ * @param [in]  array     - the array of objects
+ * @param [in]  fields    - the NUL-terminated key of each column
+ * @param [in]  types     - the type of each column
+ * @param [in]  n         - the number of columns
+ * @param [out] columns   - the n columns to fill, which must be disposed with
+ * json_columns_dispose_ext on success
+ *
+ * @return - JSON_ERROR_NONE on success or another value on error, in which
+ * case no column is allocated
+ */
+
+json_error json_array_to_columns_ext (json_allocator *allocator,
+                                      json_array *array,
+                                      const char *const fields[],
+                                      const json_value_type types[], jusize n,
+                                      json_column columns[]);
+
+/**
+ * Extracts fields of the objects in an array into typed columns, in one pass
+ * over the array. Elements that are not objects leave every cell of their
+ * row invalid.
+ *
+ * @param [in]  array   - the array of objects
+ * @param [in]  fields  - the NUL-terminated key of each column
+ * @param [in]  types   - the type of each column
+ * @param [in]  n       - the number of columns
+ * @param [out] columns - the n columns to fill, which must be disposed with
+ * json_columns_dispose on success
+ *
+ * @return - JSON_ERROR_NONE on success or another value on error, in which
+ * case no column is allocated
+ */
+
+json_error json_array_to_columns (json_array *array,
+                                  const char *const fields[],
+                                  const json_value_type types[], jusize n,
+                                  json_column columns[]);
+
+/**
+ * Frees columns filled by json_array_to_columns_ext.
+ *
+ * @param [in] allocator - the custom allocator to use
+ * @param [in] columns   - the columns to free
+ * @param [in] n         - the number of columns
+ */
+
+void json_columns_dispose_ext (json_allocator *allocator,
+                               json_column columns[], jusize n);
+
+/**
+ * Frees columns filled by json_array_to_columns.
+ *
+ * @param [in] columns - the columns to free
+ * @param [in] n       - the number of columns
+ */
+
+void json_columns_dispose (json_column columns[], jusize n);
+
 /**
  * Replaces an element in an array with a new element.
  *
@@ -315,12 +1036,15 @@ void json_array_destroy_ext (json_allocator *allocator, json_array *array);
 void json_array_destroy (json_array *array);
 
 /**
- * Decode a UTF-32 character into an out variable.
+ * Decode a UTF-32 character into an out variable. Overlong forms, surrogates
+ * and code points above U+10FFFF are invalid.
  *
- * @param [in]  buf     - the buf to encode into
+ * @param [in]  buf     - the buf to decode from
  * @param [in]  size    - the size of the buf
- * @param [out] out_cp  - the decoded UTF-32 code point
- * @param [out] out_len - the length of the encoded UTF-8 character
+ * @param [out] out_cp  - the decoded UTF-32 code point if not NULL
+ * @param [out] out_len - the length of the encoded UTF-8 character if not
+ * NULL; on error, the length of the invalid or truncated sequence, which is
+ * what a single U+FFFD replaces
  *
  * @returns - JSON_ERROR_NONE:
  * @returns - JSON_ERROR_DECODING: invalid UTF-8 character
@@ -346,45 +1070,239 @@ json_error json_buf_decode_char32 (const char *buf, jusize size,
 json_error json_buf_encode_char32 (char *buf, jusize size, jchar32 cp,
                                    ju8 *out_len);
 
-json_string **json_string_create_ext (json_allocator *allocator);
+/**
+ * Creates an empty json_string using a custom allocator.
+ *
+ * @param [in] allocator - the custom allocator to use
+ *
+ * @return - the new string or NULL if out of memory
+ */
+
+json_string *json_string_create_ext (json_allocator *allocator);
 
-json_string **json_string_create (void);
+/**
+ * Creates an empty json_string.
+ *
+ * @return - the new string or NULL if out of memory
+ */
+
+json_string *json_string_create (void);
+
+/**
+ * Creates a json_string holding a copy of a NUL-terminated string using a
+ * custom allocator.
+ *
+ * @param [in]  allocator - the custom allocator to use
+ * @param [in]  str       - the string to copy
+ * @param [out] out_str   - the new string
+ *
+ * @return - JSON_ERROR_NONE on success or another value on error
+ */
 
 json_error json_string_from_c_str_ext (json_allocator *allocator,
                                        const char *str, json_string **out_str);
 
+/**
+ * Creates a json_string holding a copy of a NUL-terminated string.
+ *
+ * @param [in]  str     - the string to copy
+ * @param [out] out_str - the new string
+ *
+ * @return - JSON_ERROR_NONE on success or another value on error
+ */
+
 json_error json_string_from_c_str (const char *str, json_string **out_str);
 
+/**
+ * Retrieves the length of a json_string in bytes, not counting the NUL
+ * terminator.
+ *
+ * @param [in] str - the string
+ *
+ * @return - the length of the string
+ */
+
 jusize json_string_length (json_string *str);
 
+/**
+ * Retrieves the NUL-terminated UTF-8 contents of a json_string.
+ *
+ * NOTE: A string may contain escaped NUL characters, in which case
+ * json_string_length should be used instead of strlen.
+ *
+ * @param [in] str - the string
+ *
+ * @return - the contents of the string; never NULL
+ */
+
 char *json_string_c_str (json_string *str);
 
+/**
+ * Creates a copy of a json_string using a custom allocator.
+ *
+ * @param [in]  allocator - the custom allocator to use
+ * @param [in]  str       - the string to copy
+ * @param [out] out_str   - the new string
+ *
+ * @return - JSON_ERROR_NONE on success or another value on error
+ */
+
 json_error json_string_clone_ext (json_allocator *allocator, json_string *str,
                                   json_string **out_str);
 
+/**
+ * Creates a copy of a json_string.
+ *
+ * @param [in]  str     - the string to copy
+ * @param [out] out_str - the new string
+ *
+ * @return - JSON_ERROR_NONE on success or another value on error
+ */
+
 json_error json_string_clone (json_string *str, json_string **out_str);
 
+/**
+ * Appends a code point, encoded as UTF-8, to a json_string using a custom
+ * allocator.
+ *
+ * @param [in] allocator - the custom allocator to use
+ * @param [in] str       - the string to append to
+ * @param [in] cp        - the code point to append
+ *
+ * @returns - JSON_ERROR_NONE:
+ * @returns - JSON_ERROR_ENCODING: cp is a surrogate or out of range
+ * @returns - JSON_ERROR_NOMEM:    out of memory
+ */
+
 json_error json_string_append_ext (json_allocator *allocator, json_string *str,
                                    jchar32 cp);
 
+/**
+ * Appends a code point, encoded as UTF-8, to a json_string.
+ *
+ * @param [in] str - the string to append to
+ * @param [in] cp  - the code point to append
+ *
+ * @returns - JSON_ERROR_NONE:
+ * @returns - JSON_ERROR_ENCODING: cp is a surrogate or out of range
+ * @returns - JSON_ERROR_NOMEM:    out of memory
+ */
+
 json_error json_string_append (json_string *str, jchar32 cp);
 
+/**
+ * Appends size bytes from buf to a json_string using a custom allocator.
+ *
+ * @param [in] allocator - the custom allocator to use
+ * @param [in] str       - the string to append to
+ * @param [in] buf       - the bytes to append
+ * @param [in] size      - the number of bytes to append
+ *
+ * @return - JSON_ERROR_NONE on success or another value on error
+ */
+
 json_error json_string_append_from_buf_ext (json_allocator *allocator,
                                             json_string *str, const char *buf,
                                             jusize size);
 
+/**
+ * Appends size bytes from buf to a json_string.
+ *
+ * @param [in] str  - the string to append to
+ * @param [in] buf  - the bytes to append
+ * @param [in] size - the number of bytes to append
+ *
+ * @return - JSON_ERROR_NONE on success or another value on error
+ */
+
 json_error json_string_append_from_buf (json_string *str, const char *buf,
                                         jusize size);
 
+/**
+ * Empties a json_string using a custom allocator.
+ *
+ * @param [in] allocator  - the custom allocator to use
+ * @param [in] string     - the string to clear
+ * @param [in] deallocate - if JSON_TRUE also releases the string's storage
+ */
+
 void json_string_clear_ext (json_allocator *allocator, json_string *string,
                             json_bool deallocate);
 
+/**
+ * Empties a json_string.
+ *
+ * @param [in] string     - the string to clear
+ * @param [in] deallocate - if JSON_TRUE also releases the string's storage
+ */
+
 void json_string_clear (json_string *string, json_bool deallocate);
 
+/**
+ * Releases a json_string and its handle using a custom allocator.
+ *
+ * @param [in] allocator - the custom allocator to use
+ * @param [in] str       - the string to free
+ */
+
 void json_string_free_ext (json_allocator *allocator, json_string *str);
 
+/**
+ * Releases a json_string and its handle.
+ *
+ * @param [in] str - the string to free
+ */
+
 void json_string_free (json_string *str);
 
+/**
+ * Creates a null json_value using a custom allocator.
+ *
+ * @param [in] allocator - the custom allocator to use
+ *
+ * @return - the new value or NULL if out of memory
+ */
+
+json_value *json_value_create_ext (json_allocator *allocator);
+
+/**
+ * Creates a null json_value.
+ *
+ * @return - the new value or NULL if out of memory
+ */
+
+json_value *json_value_create (void);
+
+/**
+ * Creates a deep copy of a value in a single allocation using a custom
+ * allocator. The copy is laid out in depth-first order and is released with
+ * json_value_destroy_ext like any other value. It can be mutated as usual;
+ * storage that has to grow is copied out of the block first.
+ *
+ * WARNING: Values moved out of the copy, for example by
+ * json_object_remove_ext, must not outlive it.
+ *
+ * @param [in]  allocator - the custom allocator to use
+ * @param [in]  value     - the value to copy
+ * @param [out] out_value - the copy
+ *
+ * @return - JSON_ERROR_NONE on success or another value on error
+ */
+
+json_error json_value_clone_ext (json_allocator *allocator, json_value *value,
+                                 json_value **out_value);
+
+/**
+ * Creates a deep copy of a value in a single allocation.
+ *
+ * @param [in]  value     - the value to copy
+ * @param [out] out_value - the copy
+ *
+ * @return - JSON_ERROR_NONE on success or another value on error
+ */
+
+json_error json_value_clone (json_value *value, json_value **out_value);
+
 /**
  * Retrieves the value type of a specified json_value.
  *
@@ -420,6 +1338,10 @@ json_bool json_value_get_array (json_value *value, json_array **a);
 /**
  * Retrieves the number of a specified json_value.
  *
+ * NOTE: A number decoded with lazy_numbers is converted from its text on the
+ * first call and the result is cached in the value, so the first call must
+ * not race with other reads of the same value.
+ *
  * @param [in]  value - the value to retrieve the number from
  * @param [out] n     - the pointer to store the number into
  *
@@ -616,6 +1538,73 @@ void json_value_destroy_ext (json_allocator *allocator, json_value *value);
 
 void json_value_destroy (json_value *value);
 
+/**
+ * Applies a JSON Patch (RFC 6902) to a document in place using a custom
+ * allocator. Each pointer is resolved once. In atomic mode a failed operation
+ * rolls back every operation before it, leaving the document as it was;
+ * otherwise the operations before it remain applied.
+ *
+ * @param [in] allocator - the allocator used to allocate the document
+ * @param [in] doc       - the document to patch
+ * @param [in] patch     - the array of operations; values are copied from it
+ * @param [in] atomic    - if JSON_TRUE undoes the patch on failure
+ *
+ * @return - JSON_ERROR_NONE on success, JSON_ERROR_BAD_PATCH for a malformed
+ * operation, JSON_ERROR_BAD_POINTER for a path that does not resolve,
+ * JSON_ERROR_TEST_FAILED for a failed test operation or another value on error
+ */
+
+json_error json_patch_apply_ext (json_allocator *allocator, json_value *doc,
+                                 json_value *patch, json_bool atomic);
+
+/**
+ * Applies a JSON Patch (RFC 6902) to a document in place.
+ *
+ * WARNING: If the decoder used a custom allocator, use json_patch_apply_ext
+ * with the correct allocator.
+ *
+ * @param [in] doc    - the document to patch
+ * @param [in] patch  - the array of operations; values are copied from it
+ * @param [in] atomic - if JSON_TRUE undoes the patch on failure
+ *
+ * @return - JSON_ERROR_NONE on success or another value on error
+ */
+
+json_error json_patch_apply (json_value *doc, json_value *patch,
+                             json_bool atomic);
+
+/**
+ * Applies a JSON Merge Patch (RFC 7396) to a document in place using a
+ * custom allocator. Null members of patch remove members of the document.
+ *
+ * @param [in] allocator - the allocator used to allocate the document
+ * @param [in] doc       - the document to patch
+ * @param [in] patch     - the merge patch; values are copied from it
+ * @param [in] atomic    - if JSON_TRUE undoes the patch on failure
+ *
+ * @return - JSON_ERROR_NONE on success or another value on error
+ */
+
+json_error json_merge_patch_apply_ext (json_allocator *allocator,
+                                       json_value *doc, json_value *patch,
+                                       json_bool atomic);
+
+/**
+ * Applies a JSON Merge Patch (RFC 7396) to a document in place.
+ *
+ * WARNING: If the decoder used a custom allocator, use
+ * json_merge_patch_apply_ext with the correct allocator.
+ *
+ * @param [in] doc    - the document to patch
+ * @param [in] patch  - the merge patch; values are copied from it
+ * @param [in] atomic - if JSON_TRUE undoes the patch on failure
+ *
+ * @return - JSON_ERROR_NONE on success or another value on error
+ */
+
+json_error json_merge_patch_apply (json_value *doc, json_value *patch,
+                                   json_bool atomic);
+
 /**
  * Retrieves a human readable error message for a respective error code.
  *
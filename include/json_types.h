@@ -76,7 +76,9 @@
 #define JSON_EXT_UNICODE_REPLACEMENT (1 << 5)
 
 /**
- * Ignore any UTF byte order marker at the start of the input stream.
+ * Ignore any UTF byte order marker at the start of the input stream. A UTF-16
+ * or UTF-32 marker also selects that encoding for the rest of the input,
+ * which is transcoded to UTF-8 before it is decoded.
  */
 
 #define JSON_EXT_IGNORE_BOM (1 << 6)
@@ -92,6 +94,16 @@
 
 #define JSON_EXT_ALLOW_DUP_KEYS (1 << 7)
 
+/**
+ * Detect UTF-16 and UTF-32 input without a byte order marker from the pattern
+ * of zero bytes at its start, as in RFC 4627, section 3.
+ *
+ * Example: 7B 00 7D 00 = {} in UTF-16LE
+ *
+ */
+
+#define JSON_EXT_DETECT_ENCODING (1 << 8)
+
 /**
  * Allow the parser to parse **ANY** nested depth of JSON objects and arrays.
  */
@@ -100,7 +112,7 @@
 
 #define STD_DECODER_OPTS                                                      \
   {                                                                           \
-    .ext_flags = JSON_EXT_IGNORE_BOM,                                         \
+    .ext_flags = JSON_EXT_IGNORE_BOM | JSON_EXT_DETECT_ENCODING,              \
     .max_depth = JSON_ANY_DEPTH,                                              \
     .tab_size  = 4,                                                           \
   }
@@ -141,6 +153,23 @@ typedef enum json_error
   JSON_ERROR_BAD_OCTAL     = 14,
   JSON_ERROR_BAD_HEX       = 15,
   JSON_ERROR_BAD_ARRAY     = 16,
+  JSON_ERROR_BAD_OBJECT    = 17,
+  JSON_ERROR_BAD_KEY       = 18,
+  JSON_ERROR_BAD_MEMBER    = 19,
+  JSON_ERROR_UNCLOSED_STR  = 20,
+  JSON_ERROR_BAD_STRING    = 21,
+  JSON_ERROR_BAD_ESCAPE    = 22,
+  JSON_ERROR_BAD_LITERAL   = 23,
+  JSON_ERROR_BAD_VALUE     = 24,
+  JSON_ERROR_DUP_KEY       = 25,
+  JSON_ERROR_IO            = 26,
+  JSON_ERROR_BAD_SNAPSHOT  = 27,
+  JSON_ERROR_BAD_PATCH     = 28,
+  JSON_ERROR_BAD_POINTER   = 29,
+  JSON_ERROR_TEST_FAILED   = 30,
+  JSON_ERROR_BAD_UTF8      = 31,
+  JSON_ERROR_BAD_ENCODING  = 32,
+  JSON_ERROR_TOO_DEEP      = 33,
 } json_error;
 
 typedef enum json_value_type
@@ -161,18 +190,178 @@ typedef struct json_allocator
   void (*json_free) (void *p, void *ctx);
 } json_allocator;
 
+// allocation sizes are counted in power of two classes, the last of which
+// also holds every larger size
+#define JSON_ALLOC_SIZE_CLASSES 16
+
+typedef struct json_alloc_stats
+{
+  jusize allocs, reallocs, frees;
+  jusize bytes_live, bytes_peak;
+
+  // size_classes[k] counts sizes in (2^(k - 1), 2^k]
+  jusize size_classes[JSON_ALLOC_SIZE_CLASSES];
+} json_alloc_stats;
+
+/**
+ * Wraps another allocator, counting what passes through it. Pass a pointer to
+ * the allocator member wherever a json_allocator is expected.
+ */
+
+typedef struct json_counting_allocator
+{
+  json_allocator allocator;
+  json_allocator *inner;
+  json_alloc_stats stats;
+} json_counting_allocator;
+
+// small blocks are served from slabs in this many size classes, the largest
+// of which holds 504 bytes
+#define JSON_SLAB_CLASSES 10
+
+/**
+ * Serves small blocks from slabs taken from another allocator, with a free
+ * list per size class, and forwards larger ones. Pass a pointer to the
+ * allocator member wherever a json_allocator is expected.
+ */
+
+typedef struct json_slab_allocator
+{
+  json_allocator allocator;
+  json_allocator *inner;
+
+  // freed blocks of each class, linked through their first word
+  void *free_lists[JSON_SLAB_CLASSES];
+
+  // the uncarved rest of the newest slab of each class
+  char *next[JSON_SLAB_CLASSES], *end[JSON_SLAB_CLASSES];
+
+  // every slab, and every block forwarded to inner, for release
+  void *slabs, *large;
+
+  // bytes held in slabs, whether carved or not
+  jusize slab_bytes;
+} json_slab_allocator;
+
+typedef struct json_decode_stats
+{
+  // the number of values decoded, indexed by json_value_type
+  jusize values[JSON_VALUE_TYPE_NULL + 1];
+} json_decode_stats;
+
+typedef enum json_decode_phase
+{
+  JSON_DECODE_PHASE_WHITESPACE,
+  JSON_DECODE_PHASE_NUMBER,
+  JSON_DECODE_PHASE_STRING,
+  JSON_DECODE_PHASE_LITERAL,
+  JSON_DECODE_PHASE_ARRAY,
+  JSON_DECODE_PHASE_OBJECT,
+  // time outside any value, such as checking for trailing data
+  JSON_DECODE_PHASE_OTHER,
+  JSON_DECODE_PHASES,
+} json_decode_phase;
+
+/**
+ * Time and input consumed by each phase of a decode, exclusive of nested
+ * phases: the array and object phases count their brackets and separators
+ * but not their elements, and object keys count as strings. Ticks are TSC
+ * cycles on x86-64 and nanoseconds elsewhere. Only filled in by a library
+ * built with -Dprofiling=true.
+ */
+
+typedef struct json_decode_profile
+{
+  ju64 ticks[JSON_DECODE_PHASES];
+  ju64 bytes[JSON_DECODE_PHASES];
+  ju64 calls[JSON_DECODE_PHASES];
+} json_decode_profile;
+
+typedef struct json_writer
+{
+  void *ctx;
+  json_error (*json_write) (const char *buf, size_t size, void *ctx);
+} json_writer;
+
 typedef struct json_decode_error
 {
   json_error error;
   jusize row, col;
 } json_decode_error;
 
+/**
+ * A key to look up in many objects, with its length and hash computed once.
+ * The string is not copied and must outlive the key.
+ */
+
+typedef struct json_key
+{
+  const char *key;
+  jusize len;
+  ju32 hash;
+
+  // the entry position the key was last found at, which is tried first on
+  // the next lookup; objects of the same shape keep it in the same place
+  ju32 slot;
+} json_key;
+
+/**
+ * One field of the objects in an array, extracted by json_array_to_columns.
+ * Cell i holds the field of element i in the array matching type: numbers,
+ * bools, strings with their lengths, or values for objects and arrays. Bit
+ * i % 8 of valid[i / 8] is set when the field was present with that type;
+ * every other cell is zero or NULL.
+ */
+
+typedef struct json_column
+{
+  json_value_type type;
+  jusize size, n_valid;
+  ju8 *valid;
+
+  json_number *numbers;
+  json_bool *bools;
+
+  // strings point into the array and are valid as long as it is unchanged
+  const char **strings;
+  jusize *lens;
+
+  struct json_value **values;
+} json_column;
+
+typedef struct json_input
+{
+  const char *buf;
+  jusize size;
+} json_input;
+
 typedef struct json_decoder_opts
 {
   ju32 ext_flags;
+
+  // arrays and objects nested more than max_depth deep are rejected with
+  // JSON_ERROR_TOO_DEEP at their opening bracket, by every function that
+  // reads JSON text, MessagePack or CBOR; zero means no limit, like
+  // JSON_ANY_DEPTH
   ju32 max_depth;
+
   ju32 tab_size;
   json_allocator *allocator;
+
+  // counts of the decoded values are added to stats if it is not NULL
+  json_decode_stats *stats;
+
+  // per-phase counters are added to profile if it is not NULL
+  json_decode_profile *profile;
+
+  // numbers keep a pointer to their text and are converted on first read;
+  // the text must outlive the decoded values, which print it back verbatim
+  // until they are set
+  json_bool lazy_numbers;
+
+  // arrays whose first element is a number or a bool are stored packed, as
+  // json_numbers or a bitset, until a value of another type is stored in them
+  json_bool pack_arrays;
 } json_decoder_opts;
 
 #endif
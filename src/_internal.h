@@ -1,6 +1,8 @@
 #ifndef _INTERNAL_H
 #define _INTERNAL_H 1
 
+#include <string.h>
+
 #include "json.h"
 
 #define BUF_ADVANCE_COL(BUF)                                                  \
@@ -12,34 +14,100 @@
     }                                                                         \
   while (0)
 
-typedef struct json_entry
-{
-  char *key;
-  struct json_value *values;
-  struct json_value *next;
-} json_entry;
+#if defined(__GNUC__)
+#define JSON_ALWAYS_INLINE inline __attribute__ ((always_inline))
+#else
+#define JSON_ALWAYS_INLINE inline
+#endif
+
+// extensions that change the syntax accepted by the value decoders; the rest
+// are only consulted on paths that would otherwise fail
+#define JSON_EXT_SYNTAX                                                       \
+  (JSON_EXT_COMMENTS | JSON_EXT_TRAILING_DECIMAL | JSON_EXT_OCTAL_LITERALS    \
+   | JSON_EXT_HEX_LITERALS)
+
+#define EMIT_DECODE_ERROR(ERR, ROW, COL)                                      \
+  do                                                                          \
+    {                                                                         \
+      if (decode_error)                                                       \
+        {                                                                     \
+          decode_error->error = (ERR);                                        \
+          decode_error->row   = (ROW);                                        \
+          decode_error->col   = (COL);                                        \
+        }                                                                     \
+    }                                                                         \
+  while (0)
+
+/**
+ * Entries are kept densely in insertion order. Objects with a capacity of at
+ * least JSON_OBJECT_INDEX_MIN_CAP also keep an open addressing hash index of
+ * entry positions directly after the entries, in the same allocation.
+ */
 
 struct json_object
 {
   jusize size, cap;
-  json_entry *entries;
+  struct json_entry *entries;
 };
 
+/**
+ * Arrays decoded with pack_arrays whose first element is a number or a bool
+ * keep their elements packed, as json_numbers or as a bitset, until a value of
+ * another type is stored in them. The packed elements follow a
+ * json_packed_head in their allocation and elements points past it.
+ */
+
+#define JSON_ARRAY_VALUES  0
+#define JSON_ARRAY_NUMBERS 1
+#define JSON_ARRAY_BOOLS   2
+
 struct json_array
 {
-  jusize size, cap;
+  jusize size;
+  ju32 cap;
+  ju8 kind;
   struct json_value *elements;
 };
 
+typedef union json_packed_head
+{
+  // the allocator json_array_get unpacks with
+  json_allocator *allocator;
+  json_number align;
+} json_packed_head;
+
 struct json_string
 {
   jusize len, cap;
   char *str;
 };
 
+/**
+ * Numbers decoded with lazy_numbers set keep their text in the input and are
+ * converted on first use. The cached number overlays the number member of
+ * the value union, so it is read through json_value_to_number.
+ */
+
+#define JSON_VALUE_TYPE_RAW_NUMBER (JSON_VALUE_TYPE_NULL + 1)
+
+struct json_raw_number
+{
+  json_number number;
+  const char *text;
+  ju32 len;
+  json_bool ready;
+};
+
+/**
+ * Values decoded from text remember the offset of their first character,
+ * relative to the start of their parent container or absolute for the root.
+ * The field fills what would otherwise be padding.
+ */
+
 struct json_value
 {
   ju8 type;
+  ju32 start;
 
   union
   {
@@ -47,15 +115,106 @@ struct json_value
     json_array array;
     json_string string;
     json_number number;
+    struct json_raw_number raw;
     json_bool bool;
   } value;
 };
 
-typedef struct json_decoder
+// smaller objects are searched linearly by hash
+#ifndef JSON_OBJECT_INDEX_MIN_CAP
+#define JSON_OBJECT_INDEX_MIN_CAP 16
+#endif
+
+/**
+ * @return - the number of hash index slots for an object with cap entries,
+ * or zero if it is too small to be indexed
+ */
+
+static inline jusize
+json_object_index_cap (jusize cap)
+{
+  jusize index_cap = 1;
+
+  if (cap < JSON_OBJECT_INDEX_MIN_CAP)
+    return 0;
+
+  while (index_cap < cap * 2)
+    index_cap <<= 1;
+
+  return index_cap;
+}
+
+typedef struct json_entry
+{
+  char *key;
+  jusize key_len;
+  ju32 hash;
+  json_value value;
+} json_entry;
+
+struct json_decoder
 {
   json_allocator *allocator;
   ju32 ext_flags, tab_size;
-} json_decoder;
+
+  // the start of the text, from which value offsets are measured
+  const char *base;
+
+  json_decode_stats *stats;
+
+  // numbers are left as text until they are read
+  json_bool lazy_numbers;
+
+  // arrays of numbers or bools are decoded packed
+  json_bool pack_arrays;
+
+  // the text is only checked; see json_validate_value
+  json_bool validate;
+
+  // the number of containers open around the value being decoded
+  ju32 max_depth, depth;
+
+  // the UTF-8 transcoding of UTF-16 or UTF-32 input, kept for the next text
+  char *text;
+  jusize text_cap;
+
+#if JSON_PROFILING
+  json_decode_profile *profile;
+
+  // the running phase and where it was last charged; pos is NULL outside of
+  // a profiled decode
+  ju8 phase;
+  ju64 tick;
+  const char *pos;
+#endif
+};
+
+/**
+ * Phase counters are only compiled in with -Dprofiling=true. A phase is
+ * entered and left in the same block, since the phase it interrupts is kept
+ * in a local. Every switch charges the ticks and bytes since the last one to
+ * the running phase.
+ */
+
+#if JSON_PROFILING
+void json_profile_begin (json_decoder *decoder, const char *pos);
+void json_profile_end (json_decoder *decoder, const char *pos);
+void json_profile_switch (json_decoder *decoder, ju8 phase, const char *pos,
+                          json_bool enter);
+
+#define JSON_PROFILE_BEGIN(DECODER, POS) json_profile_begin ((DECODER), (POS))
+#define JSON_PROFILE_END(DECODER, POS)   json_profile_end ((DECODER), (POS))
+#define JSON_PROFILE_ENTER(DECODER, PHASE, POS)                               \
+  ju8 json_profile_prev = (DECODER)->phase;                                   \
+  json_profile_switch ((DECODER), (PHASE), (POS), JSON_TRUE)
+#define JSON_PROFILE_LEAVE(DECODER, POS)                                      \
+  json_profile_switch ((DECODER), json_profile_prev, (POS), JSON_FALSE)
+#else
+#define JSON_PROFILE_BEGIN(DECODER, POS)        ((void) 0)
+#define JSON_PROFILE_END(DECODER, POS)          ((void) 0)
+#define JSON_PROFILE_ENTER(DECODER, PHASE, POS) ((void) 0)
+#define JSON_PROFILE_LEAVE(DECODER, POS)        ((void) 0)
+#endif
 
 typedef struct buffer
 {
@@ -63,19 +222,653 @@ typedef struct buffer
   jusize size, row, col;
 } buffer;
 
+/**
+ * FNV-1a hash of an object key.
+ */
+
+static inline ju32
+json_hash_key (const char *key, jusize len)
+{
+  ju32 hash = 0x811C9DC5;
+
+  for (jusize i = 0; i < len; ++i)
+    {
+      hash ^= (ju8) key[i];
+      hash *= 0x01000193;
+    }
+
+  return hash;
+}
+
 static inline int
 is_digit (char ch)
 {
   return ch >= 0x30 && ch <= 0x39;
 }
 
+static inline int
+get_hex_digit (char ch)
+{
+  if (ch >= 0x30 && ch <= 0x39)
+    return ch - 0x30;
+
+  if (ch >= 0x41 && ch <= 0x46)
+    return (ch - 0x41) + 10;
+
+  if (ch >= 0x61 && ch <= 0x66)
+    return (ch - 0x61) + 10;
+
+  return -1;
+}
+
+static inline void
+json_store_be16 (ju8 *p, ju16 v)
+{
+  p[0] = (ju8) (v >> 8);
+  p[1] = (ju8) v;
+}
+
+static inline void
+json_store_be32 (ju8 *p, ju32 v)
+{
+  json_store_be16 (p, (ju16) (v >> 16));
+  json_store_be16 (p + 2, (ju16) v);
+}
+
+static inline void
+json_store_be64 (ju8 *p, ju64 v)
+{
+  json_store_be32 (p, (ju32) (v >> 32));
+  json_store_be32 (p + 4, (ju32) v);
+}
+
+static inline ju16
+json_load_be16 (const ju8 *p)
+{
+  return (ju16) ((p[0] << 8) | p[1]);
+}
+
+static inline ju32
+json_load_be32 (const ju8 *p)
+{
+  return ((ju32) json_load_be16 (p) << 16) | json_load_be16 (p + 2);
+}
+
+static inline ju64
+json_load_be64 (const ju8 *p)
+{
+  return ((ju64) json_load_be32 (p) << 32) | json_load_be32 (p + 4);
+}
+
+/**
+ * Storage placed in a clone block by json_value_clone_ext is marked by a zero
+ * capacity. It is released with the block, never on its own, and is copied
+ * out of the block before it can grow.
+ */
+
+static inline json_bool
+json_is_block_owned (const void *storage, jusize cap)
+{
+  return storage && !cap;
+}
+
+/**
+ * Grows storage like json_realloc. Block-owned storage is copied out of its
+ * block instead, of which used bytes are in use.
+ */
+
+static inline void *
+json_storage_realloc (json_allocator *allocator, void *storage, jusize cap,
+                      jusize used, jusize size)
+{
+  void *tmp;
+
+  if (!json_is_block_owned (storage, cap))
+    return allocator->json_realloc (storage, size, allocator->ctx);
+
+  if ((tmp = allocator->json_malloc (size, allocator->ctx)))
+    memcpy (tmp, storage, used);
+
+  return tmp;
+}
+
+static inline void
+json_storage_free (json_allocator *allocator, void *storage, jusize cap)
+{
+  if (!json_is_block_owned (storage, cap))
+    allocator->json_free (storage, allocator->ctx);
+}
+
+/**
+ * Appends n bytes to the output of a binary encoder. Encoders run twice: once
+ * with out set to NULL to measure the output, then again to fill it.
+ */
+
+static inline void
+json_bin_put (ju8 *out, jusize *len, const void *src, jusize n)
+{
+  if (out)
+    memcpy (out + *len, src, n);
+
+  *len += n;
+}
+
+/**
+ * Consumes n bytes of binary input, tracking the byte offset in col.
+ *
+ * @return - the consumed bytes or NULL if fewer than n bytes remain
+ */
+
+static inline const ju8 *
+json_bin_take (buffer *buf, jusize n)
+{
+  const ju8 *p = (const ju8 *) buf->data;
+
+  if (buf->size < n)
+    return NULL;
+
+  buf->data += n;
+  buf->size -= n;
+  buf->col += n;
+
+  return p;
+}
+
+/**
+ * Splits an integral number into sign and magnitude for the binary encoders.
+ * Fails for fractions, non-finite numbers, negative zero and magnitudes that
+ * do not fit in 64 bits.
+ */
+
+static inline json_bool
+json_number_to_int (json_number number, ju64 *out_mag, json_bool *out_neg)
+{
+  union
+  {
+    json_number n;
+    ju64 u;
+  } bits = { number };
+
+  json_bool neg     = (json_bool) (bits.u >> 63);
+  json_number abs_n = neg ? -number : number;
+
+  // 2^64; the comparison also rejects NaN
+  if (!(abs_n < 18446744073709551616.0))
+    return JSON_FALSE;
+
+  if ((json_number) (ju64) abs_n != abs_n)
+    return JSON_FALSE;
+
+  if (abs_n == 0 && neg)
+    return JSON_FALSE;
+
+  *out_mag = (ju64) abs_n;
+  *out_neg = neg;
+
+  return JSON_TRUE;
+}
+
+// large enough for any json_number formatted by json_dtoa
+#define JSON_DTOA_BUF_SIZE 32
+
+/**
+ * Formats a number as the shortest decimal string that decodes back to the
+ * same json_number. Non-finite numbers are written as null. The output is
+ * not NUL-terminated.
+ *
+ * @return - the number of characters written
+ */
+
+jusize json_dtoa (json_number number, char *buf);
+
+extern json_allocator std_allocator;
+
+typedef void (*json_emit_fn) (const char *buf, jusize size, void *ctx);
+
+/**
+ * Finds the first byte in data that must be escaped inside a JSON string:
+ * '"', '\' or a control character below 0x20. Dispatches to the widest
+ * vector kernel the CPU supports.
+ *
+ * @return - the index of the byte or size if there is none
+ */
+
+jusize json_find_escape (const char *data, jusize size);
+
+/**
+ * Validates UTF-8 text a vector at a time, with a fast exit for ASCII.
+ *
+ * @return - the offset of the first invalid or truncated sequence, or size
+ * if the text is valid
+ */
+
+jusize json_utf8_valid_prefix (const char *data, jusize size);
+
+/**
+ * Combines json_find_escape with json_utf8_valid_prefix over the bytes before
+ * the escape, in a single pass where the CPU allows it.
+ *
+ * @param [out] out_valid - the length of the valid UTF-8 prefix of the run
+ * @return - the index of the first byte to escape or size if there is none
+ */
+
+jusize json_find_escape_utf8 (const char *data, jusize size,
+                              jusize *out_valid);
+
+/**
+ * Finds the first line feed, carriage return or tab in data, or if block is
+ * set also the first '*'.
+ *
+ * @return - the index of the byte or size if there is none
+ */
+
+jusize json_find_comment_stop (const char *data, jusize size,
+                               json_bool block);
+
+/**
+ * Copies the leading ASCII code units of UTF-16 or UTF-32 text to dst as
+ * single bytes, stopping at the first unit that is not ASCII.
+ *
+ * @param [in] units - the number of code units in src and bytes in dst
+ * @param [in] width - the size of a code unit, 2 or 4
+ * @return - the number of units copied
+ */
+
+jusize json_narrow_ascii (char *dst, const char *src, jusize units,
+                          ju8 width, json_bool big_endian);
+
+/**
+ * Writes the JSON escaped form of len bytes of str, without the surrounding
+ * quotes, as runs of unescaped bytes and individual escape sequences.
+ */
+
+void json_escape_string (const char *str, jusize len, json_emit_fn emit,
+                         void *ctx);
+
+/**
+ * Finds the entry with the given key.
+ *
+ * @return - the index of the entry or object->size if there is none
+ */
+
+jusize json_object_find (json_object *object, const char *key, jusize key_len,
+                         ju32 hash);
+
+json_error json_object_reserve_ext (json_allocator *allocator,
+                                    json_object *object, jusize size);
+
+/**
+ * Appends an entry without checking for an existing key. Takes ownership of
+ * key, which must have been allocated with allocator, only on success.
+ */
+
+json_error json_object_append_ext (json_allocator *allocator,
+                                   json_object *object, char *key,
+                                   jusize key_len, ju32 hash,
+                                   json_value *value);
+
+/**
+ * Removes the entry at position i, moving its value and key to the caller.
+ */
+
+json_error json_object_remove_at_ext (json_allocator *allocator,
+                                      json_object *object, jusize i,
+                                      json_value *out_value, char **out_key);
+
+/**
+ * Inserts an entry at position i without checking for an existing key. Takes
+ * ownership of key only on success.
+ */
+
+json_error json_object_insert_ext (json_allocator *allocator,
+                                   json_object *object, jusize i, char *key,
+                                   jusize key_len, ju32 hash,
+                                   json_value *value);
+
+void json_object_dispose_ext (json_allocator *allocator, json_object *object);
+
+/**
+ * Rebuilds the hash index of an object, if it has one.
+ */
+
+void json_object_reindex (json_object *object);
+
+void json_decoder_init (json_decoder *decoder,
+                        const json_decoder_opts *decoder_opts);
+
+/**
+ * Frees the scratch memory a decoder keeps between texts. The decoder stays
+ * usable.
+ */
+
+void json_decoder_release (json_decoder *decoder);
+
+/**
+ * Skips whitespace and, if the decoder allows them, comments. The strict
+ * variant skips whitespace only.
+ */
+
 void json_consume_whitespace (json_decoder *decoder, buffer *buf);
+void json_consume_whitespace_strict (json_decoder *decoder, buffer *buf);
+
+/**
+ * Skips whitespace like the functions above, but only calls them when the
+ * next byte could start whitespace or a comment, which in minified text it
+ * mostly does not.
+ */
+
+static JSON_ALWAYS_INLINE void
+json_consume_whitespace_inline (json_decoder *decoder, buffer *buf,
+                                json_bool strict)
+{
+  if (!buf->size)
+    return;
+
+  if ((ju8) buf->data[0] > 0x20 && (strict || buf->data[0] != 0x2F))
+    return;
+
+  if (strict)
+    json_consume_whitespace_strict (decoder, buf);
+  else
+    json_consume_whitespace (decoder, buf);
+}
+
+#define JSON_CONSUME_WHITESPACE(STRICT, DECODER, BUF)                         \
+  json_consume_whitespace_inline ((DECODER), (BUF), (STRICT))
+
+/**
+ * Decodes a complete JSON text into value, like json_decode but with an
+ * existing decoder.
+ */
+
+json_error json_decode_text (json_decoder *decoder, const char *buf,
+                             jusize size, json_value *value,
+                             json_decode_error *decode_error);
+
+json_error json_array_insert_ext (json_allocator *allocator,
+                                  json_array *array, jusize index,
+                                  json_value *value);
+
+/**
+ * Converts a packed array to an array of values. Does nothing for arrays that
+ * are not packed.
+ */
+
+json_error json_array_unpack (json_allocator *allocator, json_array *array);
+
+static inline json_number *
+json_packed_numbers (const json_array *array)
+{
+  return (json_number *) (void *) array->elements;
+}
+
+static inline ju8 *
+json_packed_bits (const json_array *array)
+{
+  return (ju8 *) (void *) array->elements;
+}
+
+/**
+ * @return - the size of the allocation holding cap packed elements
+ */
+
+static inline jusize
+json_packed_size (ju8 kind, jusize cap)
+{
+  if (kind == JSON_ARRAY_BOOLS)
+    return sizeof (json_packed_head) + (cap + 7) / 8;
+
+  return sizeof (json_packed_head) + cap * sizeof (json_number);
+}
+
+static inline json_packed_head *
+json_packed_head_of (const json_array *array)
+{
+  return array->elements ? (json_packed_head *) (void *) array->elements - 1
+                         : NULL;
+}
+
+/**
+ * @return - the packed size of array rounded up to keep what follows it in a
+ * clone block aligned
+ */
+
+static inline jusize
+json_packed_node_size (const json_array *array)
+{
+  jusize size = json_packed_size (array->kind, array->size);
+
+  return (size + sizeof (json_packed_head) - 1)
+         & ~(sizeof (json_packed_head) - 1);
+}
+
+/**
+ * Reads an element without unpacking the array. Packed elements are written
+ * to tmp, which is returned in their place.
+ */
+
+static inline json_value *
+json_array_at (const json_array *array, jusize index, json_value *tmp)
+{
+  switch (array->kind)
+    {
+    case JSON_ARRAY_NUMBERS:
+      tmp->type         = JSON_VALUE_TYPE_NUMBER;
+      tmp->start        = 0;
+      tmp->value.number = json_packed_numbers (array)[index];
+      return tmp;
+    case JSON_ARRAY_BOOLS:
+      tmp->type       = JSON_VALUE_TYPE_BOOL;
+      tmp->start      = 0;
+      tmp->value.bool = (json_packed_bits (array)[index >> 3] >> (index & 7))
+                        & 1;
+      return tmp;
+    }
+
+  return array->elements + index;
+}
+
+/**
+ * Removes the element at index, moving it to the caller. Never shrinks the
+ * array.
+ */
+
+void json_array_remove_at (json_array *array, jusize index,
+                           json_value *out_value);
+
+/**
+ * Deep copies src into dst with one allocation per container and string.
+ */
+
+json_error json_value_copy_ext (json_allocator *allocator, json_value *dst,
+                                json_value *src);
+
+/**
+ * Compares two values structurally. Object members compare regardless of
+ * order.
+ */
+
+json_bool json_value_equals (json_value *a, json_value *b);
+
+/**
+ * The value decoders are each instantiated twice from one body. The plain
+ * variants honor every extension in decoder->ext_flags. The strict variants
+ * accept RFC 8259 only and have the branches for JSON_EXT_SYNTAX compiled
+ * out; they are picked once per text when none of those flags are set.
+ */
 
 json_error json_decode_array (json_decoder *decoder, json_value *value,
                               buffer *buf);
+json_error json_decode_array_strict (json_decoder *decoder, json_value *value,
+                                     buffer *buf);
+json_error json_decode_literal (json_decoder *decoder, json_value *value,
+                                buffer *buf, char ch);
 json_error json_decode_number (json_decoder *decoder, json_value *value,
                                buffer *buf, char ch);
+json_error json_decode_number_strict (json_decoder *decoder,
+                                      json_value *value, buffer *buf,
+                                      char ch);
+json_error json_decode_object (json_decoder *decoder, json_value *value,
+                               buffer *buf);
+json_error json_decode_object_strict (json_decoder *decoder,
+                                      json_value *value, buffer *buf);
 json_error json_decode_value (json_decoder *decoder, json_value *value,
                               buffer *buf);
+json_error json_decode_value_strict (json_decoder *decoder, json_value *value,
+                                     buffer *buf);
+
+/**
+ * The container and value decoders are also instantiated to validate. These
+ * follow the same grammar and report the same errors at the same positions,
+ * but store nothing and never call the allocator: strings are scanned in
+ * place, numbers must be decoded lazily, and containers keep only their type.
+ * Object keys are not checked for duplicates.
+ */
+
+json_error json_validate_array (json_decoder *decoder, json_value *value,
+                                buffer *buf);
+json_error json_validate_array_strict (json_decoder *decoder,
+                                       json_value *value, buffer *buf);
+json_error json_validate_object (json_decoder *decoder, json_value *value,
+                                 buffer *buf);
+json_error json_validate_object_strict (json_decoder *decoder,
+                                        json_value *value, buffer *buf);
+json_error json_validate_value (json_decoder *decoder, json_value *value,
+                                buffer *buf);
+json_error json_validate_value_strict (json_decoder *decoder,
+                                       json_value *value, buffer *buf);
+
+/**
+ * Decodes a nested value with the variant its container was instantiated as.
+ */
+
+static JSON_ALWAYS_INLINE json_error
+json_decode_value_variant (json_decoder *decoder, json_value *value,
+                           buffer *buf, json_bool strict, json_bool validate)
+{
+  if (validate)
+    return strict ? json_validate_value_strict (decoder, value, buf)
+                  : json_validate_value (decoder, value, buf);
+
+  return strict ? json_decode_value_strict (decoder, value, buf)
+                : json_decode_value (decoder, value, buf);
+}
+
+/**
+ * Decodes a value with the variant suited to the decoder's extensions.
+ */
+
+static inline json_error
+json_decode_value_any (json_decoder *decoder, json_value *value, buffer *buf)
+{
+  if (decoder->ext_flags & JSON_EXT_SYNTAX)
+    return json_decode_value (decoder, value, buf);
+
+  return json_decode_value_strict (decoder, value, buf);
+}
+
+static inline json_error
+json_validate_value_any (json_decoder *decoder, json_value *value,
+                         buffer *buf)
+{
+  if (decoder->ext_flags & JSON_EXT_SYNTAX)
+    return json_validate_value (decoder, value, buf);
+
+  return json_validate_value_strict (decoder, value, buf);
+}
+
+/**
+ * Converts the text of a number the decoder accepted, with or without
+ * JSON_EXT_TRAILING_DECIMAL.
+ *
+ * @return - the number, or zero if the text is empty or not a number
+ */
+
+json_number json_number_parse (const char *text, jusize len);
+
+/**
+ * @return - the type of value as seen through the public API
+ */
+
+static inline json_value_type
+json_value_type_of (const json_value *value)
+{
+  return value->type == JSON_VALUE_TYPE_RAW_NUMBER ? JSON_VALUE_TYPE_NUMBER
+                                                   : value->type;
+}
+
+/**
+ * @return - the number of a number value, converting and caching the text of
+ * a raw number on first use
+ */
+
+static inline json_number
+json_value_to_number (json_value *value)
+{
+  struct json_raw_number *raw = &value->value.raw;
+
+  if (value->type != JSON_VALUE_TYPE_RAW_NUMBER)
+    return value->value.number;
+
+  if (!raw->ready)
+    {
+      raw->number = json_number_parse (raw->text, raw->len);
+      raw->ready  = JSON_TRUE;
+    }
+
+  return raw->number;
+}
+
+json_error json_decode_string (json_decoder *decoder, json_value *value,
+                               buffer *buf);
+
+json_error json_scan_string (json_decoder *decoder, buffer *buf);
+
+/**
+ * Initializes str with a NUL-terminated copy of size bytes of buf, allocated
+ * to exactly fit.
+ */
+
+json_error json_string_init_ext (json_allocator *allocator, json_string *str,
+                                 const char *buf, jusize size);
+
+typedef enum json_encoding
+{
+  JSON_ENCODING_UTF8,
+  JSON_ENCODING_UTF16LE,
+  JSON_ENCODING_UTF16BE,
+  JSON_ENCODING_UTF32LE,
+  JSON_ENCODING_UTF32BE,
+} json_encoding;
+
+/**
+ * Detects the encoding of a JSON text from its byte order marker, if
+ * JSON_EXT_IGNORE_BOM is set, or from the zero bytes among its first four, if
+ * JSON_EXT_DETECT_ENCODING is set. Text is UTF-8 otherwise.
+ *
+ * @param [out] out_bom - the length of the byte order marker, if any
+ */
+
+json_encoding json_detect_encoding (const char *data, jusize size,
+                                    ju32 ext_flags, jusize *out_bom);
+
+/**
+ * Transcodes UTF-16 or UTF-32 text to UTF-8 in a single allocation that grows
+ * with the output. Unpaired surrogates and values that are not code points
+ * become U+FFFD with JSON_EXT_UNICODE_REPLACEMENT.
+ *
+ * @param [in,out] text  - a buffer to write the UTF-8 text to, grown with
+ * the allocator as needed and kept on error
+ * @param [in,out] cap   - the capacity of the buffer
+ * @param [out] out_size - the size of the UTF-8 text
+ * @param [out] out_pos  - on error, the offset in data of the invalid unit
+ * @return - JSON_ERROR_BAD_ENCODING if the text is not well-formed
+ */
+
+json_error json_transcode_utf8 (json_allocator *allocator,
+                                json_encoding encoding, ju32 ext_flags,
+                                const char *data, jusize size,
+                                char **text, jusize *cap,
+                                jusize *out_size, jusize *out_pos);
 
 #endif
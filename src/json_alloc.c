@@ -0,0 +1,383 @@
+/*
+ * Copyright (c) 2025 Zachary Lamb
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "_internal.h"
+
+/**
+ * Every block carries its size in a header, since json_free is not told the
+ * size of what it releases. The union keeps the block after it aligned as
+ * strictly as the inner allocator's.
+ */
+
+typedef union json_alloc_header
+{
+  jusize size;
+  long double align_ld;
+  void *align_p;
+  ju64 align_u;
+} json_alloc_header;
+
+static void
+json_counting_record (json_alloc_stats *stats, jusize size)
+{
+  jusize k = 0;
+
+  while (k < JSON_ALLOC_SIZE_CLASSES - 1 && ((jusize) 1 << k) < size)
+    ++k;
+
+  ++stats->size_classes[k];
+
+  stats->bytes_live += size;
+
+  if (stats->bytes_live > stats->bytes_peak)
+    stats->bytes_peak = stats->bytes_live;
+}
+
+static void *
+json_counting_malloc (jusize size, void *ctx)
+{
+  json_counting_allocator *counting = ctx;
+  json_allocator *inner             = counting->inner;
+  json_alloc_header *header
+      = inner->json_malloc (sizeof (json_alloc_header) + size, inner->ctx);
+
+  if (!header)
+    return NULL;
+
+  header->size = size;
+
+  ++counting->stats.allocs;
+  json_counting_record (&counting->stats, size);
+
+  return header + 1;
+}
+
+static void *
+json_counting_realloc (void *p, jusize new_size, void *ctx)
+{
+  json_counting_allocator *counting = ctx;
+  json_allocator *inner             = counting->inner;
+  json_alloc_header *header;
+  jusize old_size;
+
+  if (!p)
+    return json_counting_malloc (new_size, ctx);
+
+  header   = (json_alloc_header *) p - 1;
+  old_size = header->size;
+
+  if (!(header = inner->json_realloc (
+            header, sizeof (json_alloc_header) + new_size, inner->ctx)))
+    return NULL;
+
+  header->size = new_size;
+
+  ++counting->stats.reallocs;
+  counting->stats.bytes_live -= old_size;
+  json_counting_record (&counting->stats, new_size);
+
+  return header + 1;
+}
+
+static void
+json_counting_free (void *p, void *ctx)
+{
+  json_counting_allocator *counting = ctx;
+  json_allocator *inner             = counting->inner;
+  json_alloc_header *header;
+
+  if (!p)
+    return;
+
+  header = (json_alloc_header *) p - 1;
+
+  ++counting->stats.frees;
+  counting->stats.bytes_live -= header->size;
+
+  inner->json_free (header, inner->ctx);
+}
+
+void
+json_counting_allocator_init (json_counting_allocator *counting,
+                              json_allocator *inner)
+{
+  counting->allocator = (json_allocator) {
+    .ctx          = counting,
+    .json_malloc  = json_counting_malloc,
+    .json_realloc = json_counting_realloc,
+    .json_free    = json_counting_free,
+  };
+
+  counting->inner = inner ? inner : &std_allocator;
+  counting->stats = (json_alloc_stats) { 0 };
+}
+
+void
+json_counting_allocator_reset (json_counting_allocator *counting)
+{
+  jusize bytes_live = counting->stats.bytes_live;
+
+  counting->stats            = (json_alloc_stats) { 0 };
+  counting->stats.bytes_live = bytes_live;
+  counting->stats.bytes_peak = bytes_live;
+}
+
+#ifndef JSON_SLAB_SIZE
+#define JSON_SLAB_SIZE (64 * 1024)
+#endif
+
+/**
+ * Slab blocks are preceded by a tag naming their class. Forwarded blocks
+ * carry a json_slab_large in front of the tag, which links them for release.
+ * Blocks are aligned to 8 bytes.
+ */
+
+typedef struct json_slab_tag
+{
+  ju32 cls;
+  ju32 pad;
+} json_slab_tag;
+
+typedef struct json_slab_large
+{
+  struct json_slab_large *prev, *next;
+  jusize size;
+  json_slab_tag tag;
+} json_slab_large;
+
+// the tag of forwarded blocks
+#define JSON_SLAB_LARGE JSON_SLAB_CLASSES
+
+// each slab begins with the link to the previous one, padded to a multiple of
+// every class size's alignment
+#define JSON_SLAB_LINK 16
+
+static const ju16 json_slab_sizes[JSON_SLAB_CLASSES] = {
+  16, 32, 48, 64, 96, 128, 192, 256, 384, 512,
+};
+
+// the class of a block of tag and n bytes, indexed by its size in units of
+// 16 bytes, rounded up
+static const ju8 json_slab_class_of[33] = {
+  0, 0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7,
+  8, 8, 8, 8, 8, 8, 8, 8, 9, 9, 9, 9, 9, 9, 9, 9,
+};
+
+static void *
+json_slab_malloc_large (json_slab_allocator *slab, jusize size)
+{
+  json_allocator *inner = slab->inner;
+  json_slab_large *large;
+
+  if (size > (jusize) -1 - sizeof (json_slab_large)
+      || !(large = inner->json_malloc (sizeof (json_slab_large) + size,
+                                       inner->ctx)))
+    return NULL;
+
+  large->prev     = NULL;
+  large->next     = slab->large;
+  large->size     = size;
+  large->tag.cls  = JSON_SLAB_LARGE;
+  large->tag.pad  = 0;
+
+  if (large->next)
+    large->next->prev = large;
+
+  slab->large = large;
+
+  return large + 1;
+}
+
+static void *
+json_slab_malloc (jusize size, void *ctx)
+{
+  json_slab_allocator *slab = ctx;
+  json_slab_tag *tag;
+  jusize n, cls;
+  void *block;
+
+  n = (size + sizeof (json_slab_tag) + 15) / 16;
+
+  if (size > json_slab_sizes[JSON_SLAB_CLASSES - 1] - sizeof (json_slab_tag))
+    return json_slab_malloc_large (slab, size);
+
+  cls = json_slab_class_of[n];
+
+  if ((block = slab->free_lists[cls]))
+    {
+      slab->free_lists[cls] = *(void **) block;
+      return block;
+    }
+
+  if (slab->end[cls] - slab->next[cls] < json_slab_sizes[cls])
+    {
+      char *fresh = slab->inner->json_malloc (JSON_SLAB_SIZE,
+                                              slab->inner->ctx);
+
+      if (!fresh)
+        return NULL;
+
+      *(void **) fresh = slab->slabs;
+      slab->slabs      = fresh;
+      slab->next[cls]  = fresh + JSON_SLAB_LINK;
+      slab->end[cls]   = fresh + JSON_SLAB_SIZE;
+      slab->slab_bytes += JSON_SLAB_SIZE;
+    }
+
+  tag = (json_slab_tag *) slab->next[cls];
+  slab->next[cls] += json_slab_sizes[cls];
+
+  tag->cls = (ju32) cls;
+  tag->pad = 0;
+
+  return tag + 1;
+}
+
+static void
+json_slab_free (void *p, void *ctx)
+{
+  json_slab_allocator *slab = ctx;
+  json_slab_tag *tag;
+  json_slab_large *large;
+
+  if (!p)
+    return;
+
+  tag = (json_slab_tag *) p - 1;
+
+  if (tag->cls != JSON_SLAB_LARGE)
+    {
+      *(void **) p                = slab->free_lists[tag->cls];
+      slab->free_lists[tag->cls] = p;
+      return;
+    }
+
+  large = (json_slab_large *) p - 1;
+
+  if (large->prev)
+    large->prev->next = large->next;
+  else
+    slab->large = large->next;
+
+  if (large->next)
+    large->next->prev = large->prev;
+
+  slab->inner->json_free (large, slab->inner->ctx);
+}
+
+static void *
+json_slab_realloc (void *p, jusize new_size, void *ctx)
+{
+  json_slab_allocator *slab = ctx;
+  json_allocator *inner     = slab->inner;
+  json_slab_large *large, *moved;
+  json_slab_tag *tag;
+  jusize old_size;
+  void *tmp;
+
+  if (!p)
+    return json_slab_malloc (new_size, ctx);
+
+  tag = (json_slab_tag *) p - 1;
+
+  if (tag->cls != JSON_SLAB_LARGE)
+    {
+      old_size = json_slab_sizes[tag->cls] - sizeof (json_slab_tag);
+
+      // shrinking keeps the block, as does growing within its class
+      if (new_size <= old_size)
+        return p;
+    }
+  else
+    {
+      large    = (json_slab_large *) p - 1;
+      old_size = large->size;
+
+      if (new_size > json_slab_sizes[JSON_SLAB_CLASSES - 1]
+                         - sizeof (json_slab_tag))
+        {
+          if (new_size > (jusize) -1 - sizeof (json_slab_large)
+              || !(moved = inner->json_realloc (
+                       large, sizeof (json_slab_large) + new_size,
+                       inner->ctx)))
+            return NULL;
+
+          moved->size = new_size;
+
+          if (moved->prev)
+            moved->prev->next = moved;
+          else
+            slab->large = moved;
+
+          if (moved->next)
+            moved->next->prev = moved;
+
+          return moved + 1;
+        }
+    }
+
+  if (!(tmp = json_slab_malloc (new_size, ctx)))
+    return NULL;
+
+  memcpy (tmp, p, old_size < new_size ? old_size : new_size);
+  json_slab_free (p, ctx);
+
+  return tmp;
+}
+
+void
+json_slab_allocator_init (json_slab_allocator *slab, json_allocator *inner)
+{
+  *slab = (json_slab_allocator) {
+    .allocator = {
+      .ctx          = slab,
+      .json_malloc  = json_slab_malloc,
+      .json_realloc = json_slab_realloc,
+      .json_free    = json_slab_free,
+    },
+    .inner = inner ? inner : &std_allocator,
+  };
+}
+
+void
+json_slab_allocator_release (json_slab_allocator *slab)
+{
+  json_allocator *inner = slab->inner;
+
+  while (slab->slabs)
+    {
+      void *next = *(void **) slab->slabs;
+
+      inner->json_free (slab->slabs, inner->ctx);
+      slab->slabs = next;
+    }
+
+  while (slab->large)
+    {
+      json_slab_large *next = ((json_slab_large *) slab->large)->next;
+
+      inner->json_free (slab->large, inner->ctx);
+      slab->large = next;
+    }
+
+  json_slab_allocator_init (slab, inner);
+}
@@ -33,39 +33,341 @@
 #define JSON_ARRAY_GROWTH_FACTOR 2
 #endif
 
+/**
+ * @return - JSON_TRUE if value can be stored in a packed array of kind
+ */
+
+static inline json_bool
+json_packed_fits (ju8 kind, json_value *value)
+{
+  if (kind == JSON_ARRAY_NUMBERS)
+    return json_value_type_of (value) == JSON_VALUE_TYPE_NUMBER;
+
+  return value->type == JSON_VALUE_TYPE_BOOL;
+}
+
+static inline void
+json_packed_set (json_array *array, jusize index, json_value *value)
+{
+  ju8 *bits, bit;
+
+  if (array->kind == JSON_ARRAY_NUMBERS)
+    {
+      json_packed_numbers (array)[index] = json_value_to_number (value);
+      return;
+    }
+
+  bits = json_packed_bits (array) + (index >> 3);
+  bit  = (ju8) (1 << (index & 7));
+
+  if (value->value.bool)
+    *bits |= bit;
+  else
+    *bits &= (ju8) ~bit;
+}
+
+static json_error
+json_packed_reserve (json_allocator *allocator, json_array *array, jusize cap)
+{
+  json_packed_head *head;
+
+  if (cap > (ju32) -1)
+    return JSON_ERROR_NOMEM;
+
+  head = json_storage_realloc (allocator, json_packed_head_of (array),
+                               array->cap,
+                               json_packed_size (array->kind, array->size),
+                               json_packed_size (array->kind, cap));
+
+  if (!head)
+    return JSON_ERROR_NOMEM;
+
+  head->allocator = allocator;
+  array->elements = (json_value *) (void *) (head + 1);
+  array->cap      = (ju32) cap;
+
+  return JSON_ERROR_NONE;
+}
+
+json_error
+json_array_unpack (json_allocator *allocator, json_array *array)
+{
+  json_value *elements = NULL;
+
+  if (array->kind == JSON_ARRAY_VALUES)
+    return JSON_ERROR_NONE;
+
+  if (array->size
+      && !(elements = allocator->json_malloc (
+               array->size * sizeof (json_value), allocator->ctx)))
+    return JSON_ERROR_NOMEM;
+
+  for (jusize i = 0; i < array->size; ++i)
+    json_array_at (array, i, elements + i);
+
+  json_storage_free (allocator, json_packed_head_of (array), array->cap);
+
+  array->elements = elements;
+  array->cap      = (ju32) array->size;
+  array->kind     = JSON_ARRAY_VALUES;
+
+  return JSON_ERROR_NONE;
+}
+
+json_value *
+json_array_get (json_array *array, jusize index)
+{
+  if (index >= array->size)
+    return NULL;
+
+  if (array->kind != JSON_ARRAY_VALUES
+      && json_array_unpack (json_packed_head_of (array)->allocator, array)
+             != JSON_ERROR_NONE)
+    return NULL;
+
+  return array->elements + index;
+}
+
+jusize
+json_array_get_numbers (json_array *array, json_number *out, jusize n)
+{
+  jusize i = 0;
+
+  if (n > array->size)
+    n = array->size;
+
+  if (array->kind == JSON_ARRAY_NUMBERS)
+    {
+      memcpy (out, json_packed_numbers (array), n * sizeof (json_number));
+      return n;
+    }
+
+  if (array->kind != JSON_ARRAY_VALUES)
+    return 0;
+
+  for (; i < n; ++i)
+    {
+      json_value *element = array->elements + i;
+
+      if (json_value_type_of (element) != JSON_VALUE_TYPE_NUMBER)
+        break;
+
+      out[i] = json_value_to_number (element);
+    }
+
+  return i;
+}
+
+jusize
+json_array_get_bools (json_array *array, json_bool *out, jusize n)
+{
+  json_value tmp, *element;
+  jusize i = 0;
+
+  if (n > array->size)
+    n = array->size;
+
+  if (array->kind == JSON_ARRAY_NUMBERS)
+    return 0;
+
+  for (; i < n; ++i)
+    {
+      element = json_array_at (array, i, &tmp);
+
+      if (element->type != JSON_VALUE_TYPE_BOOL)
+        break;
+
+      out[i] = element->value.bool;
+    }
+
+  return i;
+}
+
+const json_number *
+json_array_view_numbers (json_array *array)
+{
+  if (array->kind != JSON_ARRAY_NUMBERS)
+    return NULL;
+
+  return json_packed_numbers (array);
+}
+
+json_error
+json_array_reserve_ext (json_allocator *allocator, json_array *array,
+                        jusize size)
+{
+  json_value *elements;
+
+  if (array->cap >= size)
+    return JSON_ERROR_NONE;
+
+  if (array->kind != JSON_ARRAY_VALUES)
+    return json_packed_reserve (allocator, array, size);
+
+  if (size > (ju32) -1)
+    return JSON_ERROR_NOMEM;
+
+  elements = json_storage_realloc (allocator, array->elements, array->cap,
+                                   array->size * sizeof (json_value),
+                                   size * sizeof (json_value));
+
+  if (!elements)
+    return JSON_ERROR_NOMEM;
+
+  array->elements = elements;
+  array->cap      = (ju32) size;
+
+  return JSON_ERROR_NONE;
+}
+
+json_error
+json_array_reserve (json_array *array, jusize size)
+{
+  return json_array_reserve_ext (&std_allocator, array, size);
+}
+
 json_error
 json_array_append_ext (json_allocator *allocator, json_array *array,
                        json_value *value)
 {
+  json_error error;
+
+  if (array->kind != JSON_ARRAY_VALUES
+      && !json_packed_fits (array->kind, value)
+      && (error = json_array_unpack (allocator, array)) != JSON_ERROR_NONE)
+    return error;
+
   if (array->cap <= array->size)
     {
-      if (!array->cap)
-        array->cap = JSON_ARRAY_INIT_CAP;
-      else
-        while (array->cap <= array->size)
-          array->cap *= JSON_ARRAY_GROWTH_FACTOR;
+      jusize cap = array->cap;
 
-      json_value *elements = allocator->json_realloc (
-          array->elements, array->cap * sizeof (json_value), allocator->ctx);
+      if (!cap)
+        cap = JSON_ARRAY_INIT_CAP;
+
+      while (cap <= array->size)
+        cap *= JSON_ARRAY_GROWTH_FACTOR;
+
+      if ((error = json_array_reserve_ext (allocator, array, cap))
+          != JSON_ERROR_NONE)
+        return error;
+    }
+
+  if (array->kind != JSON_ARRAY_VALUES)
+    json_packed_set (array, array->size++, value);
+  else
+    memcpy (array->elements + array->size++, value, sizeof (json_value));
+
+  return JSON_ERROR_NONE;
+}
+
+json_error
+json_array_append (json_array *array, json_value *value)
+{
+  return json_array_append_ext (&std_allocator, array, value);
+}
+
+json_bool
+json_array_replace_ext (json_allocator *allocator, json_array *array,
+                        jusize index, json_value *new_element,
+                        json_value *old_element)
+{
+  json_value tmp;
+
+  if (index >= array->size)
+    return JSON_FALSE;
+
+  if (array->kind != JSON_ARRAY_VALUES)
+    {
+      if (json_packed_fits (array->kind, new_element))
+        {
+          if (old_element)
+            *old_element = *json_array_at (array, index, &tmp);
 
-      if (!elements)
-        return JSON_ERROR_NOMEM;
+          json_packed_set (array, index, new_element);
+          return JSON_TRUE;
+        }
 
-      array->elements = elements;
+      if (json_array_unpack (allocator, array) != JSON_ERROR_NONE)
+        return JSON_FALSE;
     }
 
-  memcpy (array->elements + array->size++, value, sizeof (json_value));
+  if (old_element)
+    *old_element = array->elements[index];
+  else
+    json_value_dispose_ext (allocator, array->elements + index);
+
+  array->elements[index] = *new_element;
+
+  return JSON_TRUE;
+}
+
+json_bool
+json_array_replace (json_array *array, jusize index, json_value *new_element,
+                    json_value *old_element)
+{
+  return json_array_replace_ext (&std_allocator, array, index, new_element,
+                                 old_element);
+}
+
+json_error
+json_array_insert_ext (json_allocator *allocator, json_array *array,
+                       jusize index, json_value *value)
+{
+  json_error error;
+
+  if ((error = json_array_unpack (allocator, array)) != JSON_ERROR_NONE
+      || (error = json_array_append_ext (allocator, array, value))
+             != JSON_ERROR_NONE)
+    return error;
+
+  memmove (array->elements + index + 1, array->elements + index,
+           (array->size - 1 - index) * sizeof (json_value));
+  array->elements[index] = *value;
+
   return JSON_ERROR_NONE;
 }
 
+void
+json_array_remove_at (json_array *array, jusize index, json_value *out_value)
+{
+  json_value tmp;
+
+  *out_value = *json_array_at (array, index, &tmp);
+
+  switch (array->kind)
+    {
+    case JSON_ARRAY_NUMBERS:
+      memmove (json_packed_numbers (array) + index,
+               json_packed_numbers (array) + index + 1,
+               (array->size - index - 1) * sizeof (json_number));
+      break;
+    case JSON_ARRAY_BOOLS:
+      for (jusize i = index; i + 1 < array->size; ++i)
+        json_packed_set (array, i, json_array_at (array, i + 1, &tmp));
+      break;
+    default:
+      memmove (array->elements + index, array->elements + index + 1,
+               (array->size - index - 1) * sizeof (json_value));
+      break;
+    }
+
+  --array->size;
+}
+
 void
 json_array_dispose_ext (json_allocator *allocator, json_array *array)
 {
-  for (jusize i = 0; i < array->size; i++)
-    json_value_dispose_ext (allocator, array->elements + i);
+  if (array->kind != JSON_ARRAY_VALUES)
+    json_storage_free (allocator, json_packed_head_of (array), array->cap);
+  else
+    {
+      for (jusize i = 0; i < array->size; i++)
+        json_value_dispose_ext (allocator, array->elements + i);
+
+      json_storage_free (allocator, array->elements, array->cap);
+    }
 
-  allocator->json_free (array->elements, allocator->ctx);
-  memset (allocator, 0, sizeof (json_array));
+  memset (array, 0, sizeof (json_array));
 }
 
 void
@@ -75,15 +377,28 @@ json_array_destroy_ext (json_allocator *allocator, json_array *array)
   allocator->json_free (array, allocator->ctx);
 }
 
-json_error
-json_decode_array (json_decoder *decoder, json_value *value, buffer *buf)
+void
+json_array_dispose (json_array *array)
+{
+  json_array_dispose_ext (&std_allocator, array);
+}
+
+void
+json_array_destroy (json_array *array)
+{
+  json_array_destroy_ext (&std_allocator, array);
+}
+
+static JSON_ALWAYS_INLINE json_error
+json_decode_array_impl (json_decoder *decoder, json_value *value, buffer *buf,
+                        json_bool strict, json_bool validate)
 {
   BUF_ADVANCE_COL (buf);
 
   json_value tmpval = { 0 };
   json_array array  = { 0 };
 
-  json_consume_whitespace (decoder, buf);
+  JSON_CONSUME_WHITESPACE (strict, decoder, buf);
 
   if (!buf->size)
     return JSON_ERROR_UNCLOSED_ARR;
@@ -96,20 +411,40 @@ json_decode_array (json_decoder *decoder, json_value *value, buffer *buf)
 
   while (1)
     {
-      json_error error = json_decode_value (decoder, &tmpval, buf);
+      json_error error = json_decode_value_variant (decoder, &tmpval, buf,
+                                                    strict, validate);
 
       if (error == JSON_ERROR_EOF)
         {
-          json_array_dispose_ext (decoder->allocator, &array);
+          if (!validate)
+            json_array_dispose_ext (decoder->allocator, &array);
+
           return JSON_ERROR_UNCLOSED_ARR;
         }
 
       if (error != JSON_ERROR_NONE)
         {
-          json_array_dispose_ext (decoder->allocator, &array);
+          if (!validate)
+            json_array_dispose_ext (decoder->allocator, &array);
+
           return error;
         }
 
+      if (validate)
+        goto next;
+
+      tmpval.start -= value->start;
+
+      // the first element picks the packed kind; a later element of another
+      // type unpacks the array
+      if (!array.size && decoder->pack_arrays)
+        {
+          if (tmpval.type == JSON_VALUE_TYPE_NUMBER)
+            array.kind = JSON_ARRAY_NUMBERS;
+          else if (tmpval.type == JSON_VALUE_TYPE_BOOL)
+            array.kind = JSON_ARRAY_BOOLS;
+        }
+
       if ((error = json_array_append_ext (decoder->allocator, &array, &tmpval))
           != JSON_ERROR_NONE)
         {
@@ -118,7 +453,8 @@ json_decode_array (json_decoder *decoder, json_value *value, buffer *buf)
           return error;
         }
 
-      json_consume_whitespace (decoder, buf);
+    next:
+      JSON_CONSUME_WHITESPACE (strict, decoder, buf);
 
       if (buf->size)
         {
@@ -127,7 +463,7 @@ json_decode_array (json_decoder *decoder, json_value *value, buffer *buf)
           if (ch == 0x2C)
             {
               BUF_ADVANCE_COL (buf);
-              json_consume_whitespace (decoder, buf);
+              JSON_CONSUME_WHITESPACE (strict, decoder, buf);
             }
           else if (ch == 0x5D)
             {
@@ -136,7 +472,9 @@ json_decode_array (json_decoder *decoder, json_value *value, buffer *buf)
             }
           else
             {
-              json_array_dispose_ext (decoder->allocator, &array);
+              if (!validate)
+                json_array_dispose_ext (decoder->allocator, &array);
+
               return JSON_ERROR_BAD_ARRAY;
             }
         }
@@ -148,3 +486,29 @@ end_array:
 
   return JSON_ERROR_NONE;
 }
+
+json_error
+json_decode_array (json_decoder *decoder, json_value *value, buffer *buf)
+{
+  return json_decode_array_impl (decoder, value, buf, JSON_FALSE, JSON_FALSE);
+}
+
+json_error
+json_decode_array_strict (json_decoder *decoder, json_value *value,
+                          buffer *buf)
+{
+  return json_decode_array_impl (decoder, value, buf, JSON_TRUE, JSON_FALSE);
+}
+
+json_error
+json_validate_array (json_decoder *decoder, json_value *value, buffer *buf)
+{
+  return json_decode_array_impl (decoder, value, buf, JSON_FALSE, JSON_TRUE);
+}
+
+json_error
+json_validate_array_strict (json_decoder *decoder, json_value *value,
+                            buffer *buf)
+{
+  return json_decode_array_impl (decoder, value, buf, JSON_TRUE, JSON_TRUE);
+}
@@ -20,4 +20,50 @@
  * IN THE SOFTWARE.
  */
 
+#include <string.h>
+
 #include "_internal.h"
+#include "json_types.h"
+
+json_error
+json_decode_literal (json_decoder *decoder, json_value *value, buffer *buf,
+                     char ch)
+{
+  const char *literal;
+  json_value_type type;
+  jusize len;
+
+  (void) decoder;
+
+  switch (ch)
+    {
+    case 0x74:
+      literal = "true";
+      type    = JSON_VALUE_TYPE_BOOL;
+      break;
+    case 0x66:
+      literal = "false";
+      type    = JSON_VALUE_TYPE_BOOL;
+      break;
+    case 0x6E:
+      literal = "null";
+      type    = JSON_VALUE_TYPE_NULL;
+      break;
+    default:
+      return JSON_ERROR_BAD_VALUE;
+    }
+
+  len = strlen (literal);
+
+  if (buf->size < len || memcmp (buf->data, literal, len) != 0)
+    return JSON_ERROR_BAD_LITERAL;
+
+  buf->data += len;
+  buf->size -= len;
+  buf->col += len;
+
+  value->type       = type;
+  value->value.bool = ch == 0x74;
+
+  return JSON_ERROR_NONE;
+}
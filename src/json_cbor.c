@@ -0,0 +1,655 @@
+/*
+ * Copyright (c) 2025 Zachary Lamb
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <math.h>
+
+#include "_internal.h"
+#include "json_types.h"
+
+#define JSON_CBOR_MAJOR_UINT   0
+#define JSON_CBOR_MAJOR_NINT   1
+#define JSON_CBOR_MAJOR_BYTES  2
+#define JSON_CBOR_MAJOR_TEXT   3
+#define JSON_CBOR_MAJOR_ARRAY  4
+#define JSON_CBOR_MAJOR_MAP    5
+#define JSON_CBOR_MAJOR_TAG    6
+#define JSON_CBOR_MAJOR_SIMPLE 7
+
+#define JSON_CBOR_INDEFINITE 31
+#define JSON_CBOR_BREAK      0xFF
+
+static void
+json_cbor_put_head (ju8 *out, jusize *len, ju8 major, ju64 arg)
+{
+  ju8 tmp[9];
+
+  major <<= 5;
+
+  if (arg < 24)
+    {
+      tmp[0] = major | (ju8) arg;
+      json_bin_put (out, len, tmp, 1);
+    }
+  else if (arg <= 0xFF)
+    {
+      tmp[0] = major | 24;
+      tmp[1] = (ju8) arg;
+      json_bin_put (out, len, tmp, 2);
+    }
+  else if (arg <= 0xFFFF)
+    {
+      tmp[0] = major | 25;
+      json_store_be16 (tmp + 1, (ju16) arg);
+      json_bin_put (out, len, tmp, 3);
+    }
+  else if (arg <= 0xFFFFFFFF)
+    {
+      tmp[0] = major | 26;
+      json_store_be32 (tmp + 1, (ju32) arg);
+      json_bin_put (out, len, tmp, 5);
+    }
+  else
+    {
+      tmp[0] = major | 27;
+      json_store_be64 (tmp + 1, arg);
+      json_bin_put (out, len, tmp, 9);
+    }
+}
+
+static void
+json_cbor_put_number (ju8 *out, jusize *len, json_number number)
+{
+  ju8 tmp[9];
+  ju64 mag;
+  json_bool neg;
+
+  if (json_number_to_int (number, &mag, &neg))
+    {
+      if (neg)
+        json_cbor_put_head (out, len, JSON_CBOR_MAJOR_NINT, mag - 1);
+      else
+        json_cbor_put_head (out, len, JSON_CBOR_MAJOR_UINT, mag);
+
+      return;
+    }
+
+  if ((json_number) (float) number == number)
+    {
+      union
+      {
+        float f;
+        ju32 u;
+      } bits = { (float) number };
+
+      tmp[0] = 0xFA;
+      json_store_be32 (tmp + 1, bits.u);
+      json_bin_put (out, len, tmp, 5);
+    }
+  else
+    {
+      union
+      {
+        json_number n;
+        ju64 u;
+      } bits = { number };
+
+      tmp[0] = 0xFB;
+      json_store_be64 (tmp + 1, bits.u);
+      json_bin_put (out, len, tmp, 9);
+    }
+}
+
+static json_error
+json_cbor_put_value (ju8 *out, jusize *len, json_value *value)
+{
+  json_error error;
+  ju8 simple;
+
+  switch (value->type)
+    {
+    case JSON_VALUE_TYPE_OBJECT:
+      {
+        json_object *object = &value->value.object;
+
+        json_cbor_put_head (out, len, JSON_CBOR_MAJOR_MAP, object->size);
+
+        for (jusize i = 0; i < object->size; ++i)
+          {
+            json_entry *entry = object->entries + i;
+
+            json_cbor_put_head (out, len, JSON_CBOR_MAJOR_TEXT,
+                                entry->key_len);
+            json_bin_put (out, len, entry->key, entry->key_len);
+
+            if ((error = json_cbor_put_value (out, len, &entry->value))
+                != JSON_ERROR_NONE)
+              return error;
+          }
+
+        break;
+      }
+    case JSON_VALUE_TYPE_ARRAY:
+      {
+        json_array *array = &value->value.array;
+        json_value tmp;
+
+        json_cbor_put_head (out, len, JSON_CBOR_MAJOR_ARRAY, array->size);
+
+        for (jusize i = 0; i < array->size; ++i)
+          if ((error = json_cbor_put_value (out, len,
+                                            json_array_at (array, i, &tmp)))
+              != JSON_ERROR_NONE)
+            return error;
+
+        break;
+      }
+    case JSON_VALUE_TYPE_NUMBER:
+    case JSON_VALUE_TYPE_RAW_NUMBER:
+      json_cbor_put_number (out, len, json_value_to_number (value));
+      break;
+    case JSON_VALUE_TYPE_STRING:
+      json_cbor_put_head (out, len, JSON_CBOR_MAJOR_TEXT,
+                          value->value.string.len);
+      json_bin_put (out, len, value->value.string.str,
+                    value->value.string.len);
+      break;
+    case JSON_VALUE_TYPE_BOOL:
+      simple = value->value.bool ? 0xF5 : 0xF4;
+      json_bin_put (out, len, &simple, 1);
+      break;
+    case JSON_VALUE_TYPE_NULL:
+      simple = 0xF6;
+      json_bin_put (out, len, &simple, 1);
+      break;
+    default:
+      return JSON_ERROR_INTERNAL;
+    }
+
+  return JSON_ERROR_NONE;
+}
+
+json_error
+json_cbor_encode_ext (json_allocator *allocator, json_value *value,
+                      char **out_buf, jusize *out_size)
+{
+  jusize len = 0;
+  json_error error;
+  ju8 *out;
+
+  if ((error = json_cbor_put_value (NULL, &len, value)) != JSON_ERROR_NONE)
+    return error;
+
+  if (!(out = allocator->json_malloc (len ? len : 1, allocator->ctx)))
+    return JSON_ERROR_NOMEM;
+
+  len = 0;
+  json_cbor_put_value (out, &len, value);
+
+  *out_buf  = (char *) out;
+  *out_size = len;
+
+  return JSON_ERROR_NONE;
+}
+
+json_error
+json_cbor_encode (json_value *value, char **out_buf, jusize *out_size)
+{
+  return json_cbor_encode_ext (&std_allocator, value, out_buf, out_size);
+}
+
+/**
+ * Reads the initial byte of a data item and its argument. Indefinite lengths
+ * are reported by setting out_indefinite; the argument is then zero.
+ */
+
+static json_error
+json_cbor_take_head (buffer *buf, ju8 *out_major, ju8 *out_info,
+                     ju64 *out_arg)
+{
+  const ju8 *p = json_bin_take (buf, 1);
+  ju8 info;
+
+  if (!p)
+    return JSON_ERROR_EOF;
+
+  *out_major = p[0] >> 5;
+  *out_info = info = p[0] & 0x1F;
+
+  if (info < 24 || info == JSON_CBOR_INDEFINITE)
+    {
+      *out_arg = info < 24 ? info : 0;
+      return JSON_ERROR_NONE;
+    }
+
+  if (info > 27)
+    return JSON_ERROR_DECODING;
+
+  if (!(p = json_bin_take (buf, (jusize) 1 << (info - 24))))
+    return JSON_ERROR_EOF;
+
+  switch (info)
+    {
+    case 24:
+      *out_arg = p[0];
+      break;
+    case 25:
+      *out_arg = json_load_be16 (p);
+      break;
+    case 26:
+      *out_arg = json_load_be32 (p);
+      break;
+    default:
+      *out_arg = json_load_be64 (p);
+      break;
+    }
+
+  return JSON_ERROR_NONE;
+}
+
+static inline json_bool
+json_cbor_at_break (buffer *buf)
+{
+  if (buf->size && (ju8) buf->data[0] == JSON_CBOR_BREAK)
+    {
+      json_bin_take (buf, 1);
+      return JSON_TRUE;
+    }
+
+  return JSON_FALSE;
+}
+
+/**
+ * Decodes a text string whose head has already been read. Indefinite length
+ * strings are concatenated from their definite length chunks.
+ */
+
+static json_error
+json_cbor_decode_text (json_decoder *decoder, json_string *string,
+                       buffer *buf, ju8 info, ju64 arg)
+{
+  const ju8 *p;
+  json_error error;
+
+  if (info != JSON_CBOR_INDEFINITE)
+    {
+      if (arg > buf->size)
+        return JSON_ERROR_EOF;
+
+      p = json_bin_take (buf, arg);
+
+      return json_string_init_ext (decoder->allocator, string,
+                                   (const char *) p, arg);
+    }
+
+  if ((error = json_string_init_ext (decoder->allocator, string, "", 0))
+      != JSON_ERROR_NONE)
+    return error;
+
+  while (!json_cbor_at_break (buf))
+    {
+      ju8 major;
+
+      if ((error = json_cbor_take_head (buf, &major, &info, &arg))
+          != JSON_ERROR_NONE)
+        goto fail;
+
+      if (major != JSON_CBOR_MAJOR_TEXT || info == JSON_CBOR_INDEFINITE)
+        {
+          error = JSON_ERROR_DECODING;
+          goto fail;
+        }
+
+      if (arg > buf->size)
+        {
+          error = JSON_ERROR_EOF;
+          goto fail;
+        }
+
+      p = json_bin_take (buf, arg);
+
+      if ((error = json_string_append_from_buf_ext (
+               decoder->allocator, string, (const char *) p, arg))
+          != JSON_ERROR_NONE)
+        goto fail;
+    }
+
+  return JSON_ERROR_NONE;
+
+fail:
+  json_string_clear_ext (decoder->allocator, string, JSON_TRUE);
+  return error;
+}
+
+static json_error json_cbor_decode_value (json_decoder *decoder,
+                                          json_value *value, buffer *buf);
+
+static json_error
+json_cbor_decode_array (json_decoder *decoder, json_value *value, buffer *buf,
+                        ju8 info, ju64 size)
+{
+  json_array array = { 0 };
+  json_value tmpval;
+  json_error error;
+
+  if (info == JSON_CBOR_INDEFINITE)
+    {
+      while (!json_cbor_at_break (buf))
+        {
+          if ((error = json_cbor_decode_value (decoder, &tmpval, buf))
+              != JSON_ERROR_NONE)
+            goto fail;
+
+          if ((error = json_array_append_ext (decoder->allocator, &array,
+                                              &tmpval))
+              != JSON_ERROR_NONE)
+            {
+              json_value_dispose_ext (decoder->allocator, &tmpval);
+              goto fail;
+            }
+        }
+
+      goto end_array;
+    }
+
+  // every element takes at least one byte
+  if (size > buf->size)
+    return JSON_ERROR_EOF;
+
+  if ((error = json_array_reserve_ext (decoder->allocator, &array, size))
+      != JSON_ERROR_NONE)
+    return error;
+
+  for (; array.size < size; ++array.size)
+    if ((error = json_cbor_decode_value (decoder, array.elements + array.size,
+                                         buf))
+        != JSON_ERROR_NONE)
+      goto fail;
+
+end_array:
+  value->type        = JSON_VALUE_TYPE_ARRAY;
+  value->value.array = array;
+
+  return JSON_ERROR_NONE;
+
+fail:
+  json_array_dispose_ext (decoder->allocator, &array);
+  return error;
+}
+
+static json_error
+json_cbor_decode_object (json_decoder *decoder, json_value *value,
+                         buffer *buf, ju8 info, ju64 size)
+{
+  json_object object = { 0 };
+  json_bool indefinite = info == JSON_CBOR_INDEFINITE;
+  json_value tmpval;
+  json_error error;
+
+  if (!indefinite)
+    {
+      // every member takes at least two bytes
+      if (size > buf->size / 2)
+        return JSON_ERROR_EOF;
+
+      if ((error = json_object_reserve_ext (decoder->allocator, &object, size))
+          != JSON_ERROR_NONE)
+        return error;
+    }
+
+  for (ju64 n = 0; indefinite ? !json_cbor_at_break (buf) : n < size; ++n)
+    {
+      json_string key;
+      ju8 major;
+      jusize i;
+      ju32 hash;
+      ju64 arg;
+
+      if ((error = json_cbor_take_head (buf, &major, &info, &arg))
+          != JSON_ERROR_NONE)
+        goto fail;
+
+      if (major != JSON_CBOR_MAJOR_TEXT)
+        {
+          error = JSON_ERROR_BAD_KEY;
+          goto fail;
+        }
+
+      if ((error = json_cbor_decode_text (decoder, &key, buf, info, arg))
+          != JSON_ERROR_NONE)
+        goto fail;
+
+      hash = json_hash_key (key.str, key.len);
+      i    = json_object_find (&object, key.str, key.len, hash);
+
+      if (i < object.size && !(decoder->ext_flags & JSON_EXT_ALLOW_DUP_KEYS))
+        {
+          error = JSON_ERROR_DUP_KEY;
+          goto fail_key;
+        }
+
+      if ((error = json_cbor_decode_value (decoder, &tmpval, buf))
+          != JSON_ERROR_NONE)
+        goto fail_key;
+
+      if (i < object.size)
+        {
+          json_value_dispose_ext (decoder->allocator,
+                                  &object.entries[i].value);
+          object.entries[i].value = tmpval;
+          decoder->allocator->json_free (key.str, decoder->allocator->ctx);
+        }
+      else if ((error = json_object_append_ext (decoder->allocator, &object,
+                                                key.str, key.len, hash,
+                                                &tmpval))
+               != JSON_ERROR_NONE)
+        {
+          json_value_dispose_ext (decoder->allocator, &tmpval);
+          goto fail_key;
+        }
+
+      continue;
+
+    fail_key:
+      decoder->allocator->json_free (key.str, decoder->allocator->ctx);
+      goto fail;
+    }
+
+  value->type         = JSON_VALUE_TYPE_OBJECT;
+  value->value.object = object;
+
+  return JSON_ERROR_NONE;
+
+fail:
+  json_object_dispose_ext (decoder->allocator, &object);
+  return error;
+}
+
+static json_number
+json_cbor_half_to_number (ju16 half)
+{
+  ju32 exp  = (half >> 10) & 0x1F;
+  ju32 mant = half & 0x3FF;
+  json_number number;
+
+  if (exp == 0)
+    number = mant / 16777216.0; // mant * 2^-24
+  else if (exp == 31)
+    number = mant ? NAN : INFINITY;
+  else
+    {
+      number = 1.0 + mant / 1024.0;
+
+      for (; exp > 15; --exp)
+        number *= 2;
+
+      for (; exp < 15; ++exp)
+        number /= 2;
+    }
+
+  return (half & 0x8000) ? -number : number;
+}
+
+static json_error
+json_cbor_decode_value (json_decoder *decoder, json_value *value, buffer *buf)
+{
+  json_error error;
+  ju8 major, info;
+  ju64 arg;
+
+take_head:
+  if ((error = json_cbor_take_head (buf, &major, &info, &arg))
+      != JSON_ERROR_NONE)
+    return error;
+
+  if (info == JSON_CBOR_INDEFINITE
+      && (major < JSON_CBOR_MAJOR_BYTES || major == JSON_CBOR_MAJOR_TAG
+          || major == JSON_CBOR_MAJOR_SIMPLE))
+    return JSON_ERROR_DECODING;
+
+  switch (major)
+    {
+    case JSON_CBOR_MAJOR_UINT:
+      value->type         = JSON_VALUE_TYPE_NUMBER;
+      value->value.number = (json_number) arg;
+      return JSON_ERROR_NONE;
+    case JSON_CBOR_MAJOR_NINT:
+      value->type         = JSON_VALUE_TYPE_NUMBER;
+      // -1.0 - arg would round twice once arg is past 2^53; -2^64 is the one
+      // value arg + 1 cannot hold
+      value->value.number = arg == (ju64) -1
+                                ? -18446744073709551616.0
+                                : -(json_number) (arg + 1);
+      return JSON_ERROR_NONE;
+    case JSON_CBOR_MAJOR_TEXT:
+      if ((error = json_cbor_decode_text (decoder, &value->value.string, buf,
+                                          info, arg))
+          != JSON_ERROR_NONE)
+        return error;
+
+      value->type = JSON_VALUE_TYPE_STRING;
+      return JSON_ERROR_NONE;
+    case JSON_CBOR_MAJOR_ARRAY:
+    case JSON_CBOR_MAJOR_MAP:
+      if (decoder->depth == decoder->max_depth)
+        return JSON_ERROR_TOO_DEEP;
+
+      ++decoder->depth;
+      error = major == JSON_CBOR_MAJOR_ARRAY
+                  ? json_cbor_decode_array (decoder, value, buf, info, arg)
+                  : json_cbor_decode_object (decoder, value, buf, info, arg);
+      --decoder->depth;
+      return error;
+    case JSON_CBOR_MAJOR_TAG:
+      // tags only annotate the item that follows, which is read in place so
+      // that a run of tags does not nest
+      goto take_head;
+    case JSON_CBOR_MAJOR_SIMPLE:
+      break;
+    default:
+      // byte strings have no JSON equivalent
+      return JSON_ERROR_DECODING;
+    }
+
+  switch (info)
+    {
+    case 20:
+    case 21:
+      value->type       = JSON_VALUE_TYPE_BOOL;
+      value->value.bool = info == 21;
+      return JSON_ERROR_NONE;
+    case 22:
+    case 23:
+      // undefined is mapped to null
+      value->type = JSON_VALUE_TYPE_NULL;
+      return JSON_ERROR_NONE;
+    case 25:
+      value->type         = JSON_VALUE_TYPE_NUMBER;
+      value->value.number = json_cbor_half_to_number ((ju16) arg);
+      return JSON_ERROR_NONE;
+    case 26:
+      {
+        union
+        {
+          float f;
+          ju32 u;
+        } bits = { .u = (ju32) arg };
+
+        value->type         = JSON_VALUE_TYPE_NUMBER;
+        value->value.number = bits.f;
+        return JSON_ERROR_NONE;
+      }
+    case 27:
+      {
+        union
+        {
+          json_number n;
+          ju64 u;
+        } bits = { .u = arg };
+
+        value->type         = JSON_VALUE_TYPE_NUMBER;
+        value->value.number = bits.n;
+        return JSON_ERROR_NONE;
+      }
+    default:
+      return JSON_ERROR_DECODING;
+    }
+}
+
+json_value *
+json_cbor_decode (const json_decoder_opts *decoder_opts, const char *_buf,
+                  size_t size, json_decode_error *decode_error)
+{
+  json_decoder decoder;
+  json_decoder_init (&decoder, decoder_opts);
+
+  buffer buf = { .data = _buf, .size = size, .row = 0, .col = 0 };
+
+  json_error error;
+  json_value value;
+  json_value *value_a;
+
+  if ((error = json_cbor_decode_value (&decoder, &value, &buf))
+      != JSON_ERROR_NONE)
+    {
+      EMIT_DECODE_ERROR (error, buf.row, buf.col);
+      return NULL;
+    }
+
+  if (buf.size)
+    {
+      json_value_dispose_ext (decoder.allocator, &value);
+      EMIT_DECODE_ERROR (JSON_ERROR_TRAILING_DATA, buf.row, buf.col);
+      return NULL;
+    }
+
+  if (!(value_a = decoder.allocator->json_malloc (sizeof (json_value),
+                                                  decoder.allocator->ctx)))
+    {
+      json_value_dispose_ext (decoder.allocator, &value);
+      EMIT_DECODE_ERROR (JSON_ERROR_NOMEM, buf.row, buf.col);
+      return NULL;
+    }
+
+  *value_a = value;
+
+  return value_a;
+}
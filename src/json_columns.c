@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2025 Zachary Lamb
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "_internal.h"
+#include "json.h"
+
+/**
+ * @return - zeroed storage for n cells of size bytes, or NULL if n is zero or
+ * memory runs out, in which case error is set
+ */
+
+static void *
+json_column_alloc (json_allocator *allocator, jusize n, jusize size,
+                   json_error *error)
+{
+  void *cells;
+
+  if (!n)
+    return NULL;
+
+  if (n > (jusize) -1 / size
+      || !(cells = allocator->json_malloc (n * size, allocator->ctx)))
+    {
+      *error = JSON_ERROR_NOMEM;
+      return NULL;
+    }
+
+  return memset (cells, 0, n * size);
+}
+
+static json_error
+json_column_init (json_allocator *allocator, json_column *column,
+                  json_value_type type, jusize rows)
+{
+  json_error error = JSON_ERROR_NONE;
+
+  *column = (json_column) { .type = type, .size = rows };
+
+  column->valid = json_column_alloc (allocator, (rows + 7) / 8, 1, &error);
+
+  switch (type)
+    {
+    case JSON_VALUE_TYPE_NUMBER:
+      column->numbers = json_column_alloc (allocator, rows,
+                                           sizeof (json_number), &error);
+      break;
+    case JSON_VALUE_TYPE_BOOL:
+      column->bools = json_column_alloc (allocator, rows, sizeof (json_bool),
+                                         &error);
+      break;
+    case JSON_VALUE_TYPE_STRING:
+      column->strings = json_column_alloc (allocator, rows,
+                                           sizeof (const char *), &error);
+      column->lens
+          = json_column_alloc (allocator, rows, sizeof (jusize), &error);
+      break;
+    case JSON_VALUE_TYPE_OBJECT:
+    case JSON_VALUE_TYPE_ARRAY:
+      column->values = json_column_alloc (allocator, rows,
+                                          sizeof (json_value *), &error);
+      break;
+    default:
+      break;
+    }
+
+  return error;
+}
+
+/**
+ * Stores the field of one row if it has the column's type.
+ */
+
+static inline void
+json_column_put (json_column *column, jusize row, json_value *value)
+{
+  if (json_value_type_of (value) != column->type)
+    return;
+
+  switch (column->type)
+    {
+    case JSON_VALUE_TYPE_NUMBER:
+      column->numbers[row] = json_value_to_number (value);
+      break;
+    case JSON_VALUE_TYPE_BOOL:
+      column->bools[row] = value->value.bool;
+      break;
+    case JSON_VALUE_TYPE_STRING:
+      column->strings[row] = value->value.string.str;
+      column->lens[row]    = value->value.string.len;
+      break;
+    case JSON_VALUE_TYPE_OBJECT:
+    case JSON_VALUE_TYPE_ARRAY:
+      column->values[row] = value;
+      break;
+    default:
+      break;
+    }
+
+  column->valid[row >> 3] |= (ju8) (1 << (row & 7));
+  ++column->n_valid;
+}
+
+json_error
+json_array_to_columns_ext (json_allocator *allocator, json_array *array,
+                           const char *const fields[],
+                           const json_value_type types[], jusize n,
+                           json_column columns[])
+{
+  json_error error = JSON_ERROR_NONE;
+  json_value tmp, *element, *value;
+  json_object *object;
+  json_key *keys;
+  jusize i;
+
+  if (!n)
+    return JSON_ERROR_NONE;
+
+  if (n > (jusize) -1 / sizeof (json_key)
+      || !(keys = allocator->json_malloc (n * sizeof (json_key),
+                                          allocator->ctx)))
+    return JSON_ERROR_NOMEM;
+
+  for (i = 0; i < n; ++i)
+    {
+      keys[i] = json_key_make (fields[i]);
+
+      if ((error = json_column_init (allocator, columns + i, types[i],
+                                     array->size))
+          != JSON_ERROR_NONE)
+        {
+          json_columns_dispose_ext (allocator, columns, i + 1);
+          goto done;
+        }
+    }
+
+  // rows go in order so every object is visited once; objects of the same
+  // shape find each key at its remembered position
+  for (jusize row = 0; row < array->size; ++row)
+    {
+      element = json_array_at (array, row, &tmp);
+
+      if (!json_value_get_object (element, &object))
+        continue;
+
+      for (i = 0; i < n; ++i)
+        if ((value = json_object_get_key (object, keys + i)))
+          json_column_put (columns + i, row, value);
+    }
+
+done:
+  allocator->json_free (keys, allocator->ctx);
+
+  return error;
+}
+
+json_error
+json_array_to_columns (json_array *array, const char *const fields[],
+                       const json_value_type types[], jusize n,
+                       json_column columns[])
+{
+  return json_array_to_columns_ext (&std_allocator, array, fields, types, n,
+                                    columns);
+}
+
+void
+json_columns_dispose_ext (json_allocator *allocator, json_column columns[],
+                          jusize n)
+{
+  for (jusize i = 0; i < n; ++i)
+    {
+      json_column *column = columns + i;
+
+      allocator->json_free (column->valid, allocator->ctx);
+      allocator->json_free (column->numbers, allocator->ctx);
+      allocator->json_free (column->bools, allocator->ctx);
+      allocator->json_free ((void *) column->strings, allocator->ctx);
+      allocator->json_free (column->lens, allocator->ctx);
+      allocator->json_free (column->values, allocator->ctx);
+
+      memset (column, 0, sizeof (json_column));
+    }
+}
+
+void
+json_columns_dispose (json_column columns[], jusize n)
+{
+  json_columns_dispose_ext (&std_allocator, columns, n);
+}
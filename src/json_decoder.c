@@ -25,18 +25,6 @@
 #include "_internal.h"
 #include "json_alloc.h"
 
-#define EMIT_DECODE_ERROR(ERR, ROW, COL)                                      \
-  do                                                                          \
-    {                                                                         \
-      if (decode_error)                                                       \
-        {                                                                     \
-          decode_error->error = (ERR);                                        \
-          decode_error->row   = (ROW);                                        \
-          decode_error->col   = (COL);                                        \
-        }                                                                     \
-    }                                                                         \
-  while (0)
-
 const json_decoder_opts std_opts = STD_DECODER_OPTS;
 
 json_allocator std_allocator = {
@@ -45,9 +33,93 @@ json_allocator std_allocator = {
   .json_free    = json_free_s,
 };
 
-void
-json_consume_whitespace (json_decoder *decoder, buffer *buf)
+/**
+ * Skips the comment starting at buf->data[0] if it is one the decoder
+ * allows, keeping the row and column in step. The comment text is searched
+ * a vector at a time for the bytes that end it or move the position. A
+ * single line comment ends before its line break, which is left to the
+ * whitespace loop.
+ *
+ * @return - JSON_FALSE if there is no allowed comment, or an unclosed block
+ * comment that is left for the caller to reject
+ */
+
+static json_bool
+json_consume_comment (json_decoder *decoder, buffer *buf)
+{
+  const char *data = buf->data;
+  jusize size = buf->size, row = buf->row, col = buf->col + 2, i = 2;
+  json_bool block;
+
+  if (size < 2)
+    return JSON_FALSE;
+
+  if (data[1] == 0x2F
+      && (decoder->ext_flags & JSON_EXT_SINGLE_LINE_COMMENTS))
+    block = JSON_FALSE;
+  else if (data[1] == 0x2A
+           && (decoder->ext_flags & JSON_EXT_MULTI_LINE_COMMENTS))
+    block = JSON_TRUE;
+  else
+    return JSON_FALSE;
+
+  while (1)
+    {
+      jusize n = json_find_comment_stop (data + i, size - i, block);
+
+      i += n;
+      col += n;
+
+      if (i == size)
+        {
+          if (block)
+            return JSON_FALSE;
+
+          break;
+        }
+
+      if (data[i] == 0x09)
+        {
+          col += decoder->tab_size;
+          ++i;
+        }
+      else if (data[i] == 0x2A)
+        {
+          ++col;
+
+          if (++i < size && data[i] == 0x2F)
+            {
+              ++col;
+              ++i;
+              break;
+            }
+        }
+      else if (!block)
+        break;
+      else
+        {
+          ++row;
+          col = 0;
+
+          // a carriage return and line feed is one line break
+          i += data[i] == 0x0D && i + 1 < size && data[i + 1] == 0x0A ? 2 : 1;
+        }
+    }
+
+  buf->data += i;
+  buf->size -= i;
+  buf->row = row;
+  buf->col = col;
+
+  return JSON_TRUE;
+}
+
+static JSON_ALWAYS_INLINE void
+json_consume_whitespace_impl (json_decoder *decoder, buffer *buf,
+                              json_bool strict)
 {
+  JSON_PROFILE_ENTER (decoder, JSON_DECODE_PHASE_WHITESPACE, buf->data);
+
   while (buf->size)
     {
       switch (buf->data[0])
@@ -74,76 +146,689 @@ json_consume_whitespace (json_decoder *decoder, buffer *buf)
         case 0x20:
           ++buf->col;
           break;
+        case 0x2F:
+          if (strict || !(decoder->ext_flags & JSON_EXT_COMMENTS)
+              || !json_consume_comment (decoder, buf))
+            goto end;
+          continue;
         default:
-          return;
+          goto end;
         }
 
       ++buf->data;
       --buf->size;
     }
+
+end:
+  JSON_PROFILE_LEAVE (decoder, buf->data);
 }
 
-json_error
-json_decode_value (json_decoder *decoder, json_value *value, buffer *buf)
+void
+json_consume_whitespace (json_decoder *decoder, buffer *buf)
+{
+  json_consume_whitespace_impl (decoder, buf, JSON_FALSE);
+}
+
+void
+json_consume_whitespace_strict (json_decoder *decoder, buffer *buf)
 {
+  json_consume_whitespace_impl (decoder, buf, JSON_TRUE);
+}
+
+// the kind of value each byte can start, indexed by the first byte
+#define JSON_FIRST_OTHER  0
+#define JSON_FIRST_STRING 1
+#define JSON_FIRST_NUMBER 2
+#define JSON_FIRST_ARRAY  3
+#define JSON_FIRST_OBJECT 4
+
+static const ju8 first_byte_table[256] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0,
+  2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+static JSON_ALWAYS_INLINE json_error
+json_decode_value_impl (json_decoder *decoder, json_value *value, buffer *buf,
+                        json_bool strict, json_bool validate)
+{
+  json_error error;
+
   if (!buf->size)
     return JSON_ERROR_EOF;
 
   char ch = buf->data[0];
 
-  if (ch == 0x2D || is_digit (ch))
-    return json_decode_number (decoder, value, buf, ch);
+  value->start = (ju32) (buf->data - decoder->base);
 
-  if (ch == 0x5B)
-    return json_decode_array (decoder, value, buf);
+  switch (first_byte_table[(ju8) ch])
+    {
+    case JSON_FIRST_STRING:
+      {
+        JSON_PROFILE_ENTER (decoder, JSON_DECODE_PHASE_STRING, buf->data);
+
+        if (!validate)
+          error = json_decode_string (decoder, value, buf);
+        else if ((error = json_scan_string (decoder, buf)) == JSON_ERROR_NONE)
+          value->type = JSON_VALUE_TYPE_STRING;
+
+        JSON_PROFILE_LEAVE (decoder, buf->data);
+        break;
+      }
+    case JSON_FIRST_NUMBER:
+      {
+        JSON_PROFILE_ENTER (decoder, JSON_DECODE_PHASE_NUMBER, buf->data);
+        error = strict ? json_decode_number_strict (decoder, value, buf, ch)
+                       : json_decode_number (decoder, value, buf, ch);
+        JSON_PROFILE_LEAVE (decoder, buf->data);
+        break;
+      }
+    case JSON_FIRST_ARRAY:
+      {
+        if (decoder->depth == decoder->max_depth)
+          return JSON_ERROR_TOO_DEEP;
+
+        ++decoder->depth;
+        JSON_PROFILE_ENTER (decoder, JSON_DECODE_PHASE_ARRAY, buf->data);
+
+        if (validate)
+          error = strict ? json_validate_array_strict (decoder, value, buf)
+                         : json_validate_array (decoder, value, buf);
+        else
+          error = strict ? json_decode_array_strict (decoder, value, buf)
+                         : json_decode_array (decoder, value, buf);
+
+        JSON_PROFILE_LEAVE (decoder, buf->data);
+        --decoder->depth;
+        break;
+      }
+    case JSON_FIRST_OBJECT:
+      {
+        if (decoder->depth == decoder->max_depth)
+          return JSON_ERROR_TOO_DEEP;
+
+        ++decoder->depth;
+        JSON_PROFILE_ENTER (decoder, JSON_DECODE_PHASE_OBJECT, buf->data);
+
+        if (validate)
+          error = strict ? json_validate_object_strict (decoder, value, buf)
+                         : json_validate_object (decoder, value, buf);
+        else
+          error = strict ? json_decode_object_strict (decoder, value, buf)
+                         : json_decode_object (decoder, value, buf);
 
-  return JSON_ERROR_INTERNAL;
+        JSON_PROFILE_LEAVE (decoder, buf->data);
+        --decoder->depth;
+        break;
+      }
+    default:
+      {
+        // the literal decoder also reports bytes that start no value
+        JSON_PROFILE_ENTER (decoder, JSON_DECODE_PHASE_LITERAL, buf->data);
+        error = json_decode_literal (decoder, value, buf, ch);
+        JSON_PROFILE_LEAVE (decoder, buf->data);
+        break;
+      }
+    }
+
+  if (decoder->stats && error == JSON_ERROR_NONE)
+    ++decoder->stats->values[json_value_type_of (value)];
+
+  return error;
 }
 
-json_value *
-json_decode (const json_decoder_opts *decoder_opts, const char *_buf,
-             size_t size, json_decode_error *decode_error)
+json_error
+json_decode_value (json_decoder *decoder, json_value *value, buffer *buf)
+{
+  return json_decode_value_impl (decoder, value, buf, JSON_FALSE, JSON_FALSE);
+}
+
+json_error
+json_decode_value_strict (json_decoder *decoder, json_value *value,
+                          buffer *buf)
+{
+  return json_decode_value_impl (decoder, value, buf, JSON_TRUE, JSON_FALSE);
+}
+
+json_error
+json_validate_value (json_decoder *decoder, json_value *value, buffer *buf)
+{
+  return json_decode_value_impl (decoder, value, buf, JSON_FALSE, JSON_TRUE);
+}
+
+json_error
+json_validate_value_strict (json_decoder *decoder, json_value *value,
+                            buffer *buf)
+{
+  return json_decode_value_impl (decoder, value, buf, JSON_TRUE, JSON_TRUE);
+}
+
+void
+json_decoder_init (json_decoder *decoder, const json_decoder_opts *decoder_opts)
 {
   if (decoder_opts == NULL)
     decoder_opts = &std_opts;
 
-  json_decoder decoder = { .allocator = decoder_opts->allocator,
-                           .ext_flags = decoder_opts->ext_flags,
-                           .tab_size  = decoder_opts->tab_size };
+  decoder->allocator    = decoder_opts->allocator;
+  decoder->ext_flags    = decoder_opts->ext_flags;
+  decoder->tab_size     = decoder_opts->tab_size;
+  decoder->base         = NULL;
+  decoder->stats        = decoder_opts->stats;
+  decoder->lazy_numbers = decoder_opts->lazy_numbers;
+  decoder->pack_arrays  = decoder_opts->pack_arrays;
+  decoder->validate     = JSON_FALSE;
+  decoder->max_depth    = decoder_opts->max_depth ? decoder_opts->max_depth
+                                                  : JSON_ANY_DEPTH;
+  decoder->depth        = 0;
+  decoder->text         = NULL;
+  decoder->text_cap     = 0;
 
-  if (decoder.allocator == NULL)
-    decoder.allocator = &std_allocator;
+#if JSON_PROFILING
+  decoder->profile = decoder_opts->profile;
+  decoder->phase   = JSON_DECODE_PHASE_OTHER;
+  decoder->pos     = NULL;
+#endif
 
-  buffer buf = { .data = _buf, .size = size, .row = 1, .col = 1 };
+  if (decoder->allocator == NULL)
+    decoder->allocator = &std_allocator;
+}
+
+void
+json_decoder_release (json_decoder *decoder)
+{
+  json_allocator *allocator = decoder->allocator;
+
+  if (decoder->text)
+    allocator->json_free (decoder->text, allocator->ctx);
+
+  decoder->text     = NULL;
+  decoder->text_cap = 0;
+}
+
+/**
+ * Decodes UTF-16 or UTF-32 text by way of a UTF-8 transcoding, from which
+ * the offsets of the values are then taken.
+ */
+
+static json_error
+json_decode_transcoded (json_decoder *decoder, json_encoding encoding,
+                        const char *_buf, size_t size, jusize bom,
+                        json_value *value, json_decode_error *decode_error)
+{
+  json_allocator *allocator = decoder->allocator;
+  ju32 ext_flags            = decoder->ext_flags;
+  json_bool lazy_numbers    = decoder->lazy_numbers;
+  jusize text_size, pos;
+  json_error error;
 
-  if (!size)
+  if ((error = json_transcode_utf8 (allocator, encoding, ext_flags,
+                                    _buf + bom, size - bom, &decoder->text,
+                                    &decoder->text_cap, &text_size, &pos))
+      != JSON_ERROR_NONE)
     {
-      EMIT_DECODE_ERROR (JSON_ERROR_EOF, buf.row, buf.col);
-      return NULL;
+      // there is no UTF-8 text to count rows in, so the column is the byte
+      // offset of the invalid code unit
+      EMIT_DECODE_ERROR (error, 1, bom + pos + 1);
+      return error;
     }
 
-  json_consume_whitespace (&decoder, &buf);
+  // the transcoding is overwritten by the next text, so no number can point
+  // into it unless nothing is kept
+  decoder->ext_flags &= ~(JSON_EXT_IGNORE_BOM | JSON_EXT_DETECT_ENCODING);
+  decoder->lazy_numbers = decoder->validate;
+
+  error = json_decode_text (decoder, decoder->text, text_size, value,
+                            decode_error);
+
+  decoder->ext_flags    = ext_flags;
+  decoder->lazy_numbers = lazy_numbers;
 
+  return error;
+}
+
+json_error
+json_decode_text (json_decoder *decoder, const char *_buf, size_t size,
+                  json_value *value, json_decode_error *decode_error)
+{
+  buffer buf = { .data = _buf, .size = size, .row = 1, .col = 1 };
+  json_encoding encoding;
   json_error error;
-  json_value value;
+  jusize bom;
+
+  decoder->base  = _buf;
+  decoder->depth = 0;
+
+  encoding = json_detect_encoding (_buf, size, decoder->ext_flags, &bom);
+
+  if (encoding != JSON_ENCODING_UTF8)
+    return json_decode_transcoded (decoder, encoding, _buf, size, bom, value,
+                                   decode_error);
 
-  if ((error = json_decode_value (&decoder, &value, &buf)) != JSON_ERROR_NONE)
+  // the marker is not part of the text, but offsets still count it
+  buf.data += bom;
+  buf.size -= bom;
+
+  if (!buf.size)
     {
-      EMIT_DECODE_ERROR (error, buf.row, buf.col);
-      return NULL;
+      EMIT_DECODE_ERROR (JSON_ERROR_EOF, buf.row, buf.col);
+      return JSON_ERROR_EOF;
     }
 
-  json_consume_whitespace (&decoder, &buf);
+  JSON_PROFILE_BEGIN (decoder, buf.data);
+
+  json_consume_whitespace (decoder, &buf);
+
+  error = decoder->validate ? json_validate_value_any (decoder, value, &buf)
+                            : json_decode_value_any (decoder, value, &buf);
+
+  if (error != JSON_ERROR_NONE)
+    goto fail;
+
+  json_consume_whitespace (decoder, &buf);
 
   if (buf.size != 0 && (buf.size != 1 || buf.data[0] != 0))
     {
-      EMIT_DECODE_ERROR (JSON_ERROR_TRAILING_DATA, buf.row, buf.col);
+      if (!decoder->validate)
+        json_value_dispose_ext (decoder->allocator, value);
+
+      error = JSON_ERROR_TRAILING_DATA;
+      goto fail;
+    }
+
+  JSON_PROFILE_END (decoder, buf.data + buf.size);
+
+  return JSON_ERROR_NONE;
+
+fail:
+  JSON_PROFILE_END (decoder, buf.data);
+  EMIT_DECODE_ERROR (error, buf.row, buf.col);
+  return error;
+}
+
+json_value *
+json_decode (const json_decoder_opts *decoder_opts, const char *_buf,
+             size_t size, json_decode_error *decode_error)
+{
+  json_decoder decoder;
+  json_value *value;
+
+  json_decoder_init (&decoder, decoder_opts);
+
+  value = json_decoder_decode (&decoder, _buf, size, decode_error);
+
+  json_decoder_release (&decoder);
+
+  return value;
+}
+
+json_error
+json_validate (const json_decoder_opts *decoder_opts, const char *_buf,
+               size_t size, json_decode_error *decode_error)
+{
+  json_decoder decoder;
+  json_value value;
+  json_error error;
+
+  json_decoder_init (&decoder, decoder_opts);
+
+  // numbers are only checked, never converted
+  decoder.validate     = JSON_TRUE;
+  decoder.lazy_numbers = JSON_TRUE;
+
+  error = json_decode_text (&decoder, _buf, size, &value, decode_error);
+
+  json_decoder_release (&decoder);
+
+  return error;
+}
+
+json_decoder *
+json_decoder_create (const json_decoder_opts *decoder_opts)
+{
+  json_allocator *allocator = decoder_opts && decoder_opts->allocator
+                                  ? decoder_opts->allocator
+                                  : &std_allocator;
+  json_decoder *decoder
+      = allocator->json_malloc (sizeof (json_decoder), allocator->ctx);
+
+  if (decoder)
+    json_decoder_init (decoder, decoder_opts);
+
+  return decoder;
+}
+
+json_value *
+json_decoder_decode (json_decoder *decoder, const char *_buf, size_t size,
+                     json_decode_error *decode_error)
+{
+  json_allocator *allocator = decoder->allocator;
+  json_value value, *value_a;
+
+  if (json_decode_text (decoder, _buf, size, &value, decode_error)
+      != JSON_ERROR_NONE)
+    return NULL;
+
+  if (!(value_a = allocator->json_malloc (sizeof (json_value),
+                                          allocator->ctx)))
+    {
+      json_value_dispose_ext (allocator, &value);
+      EMIT_DECODE_ERROR (JSON_ERROR_NOMEM, 0, 0);
       return NULL;
     }
 
-  json_value *value_a = decoder.allocator->json_malloc (
-      sizeof (json_value), decoder.allocator->ctx);
   *value_a = value;
 
   return value_a;
 }
+
+void
+json_decoder_reset (json_decoder *decoder)
+{
+  json_decoder_release (decoder);
+}
+
+void
+json_decoder_destroy (json_decoder *decoder)
+{
+  json_allocator *allocator;
+
+  if (!decoder)
+    return;
+
+  allocator = decoder->allocator;
+
+  json_decoder_release (decoder);
+  allocator->json_free (decoder, allocator->ctx);
+}
+
+/**
+ * Skips a comment starting at data[0], if there is one.
+ *
+ * @return - the length of the comment or zero
+ */
+
+static jusize
+json_skip_comment (const char *data, jusize size)
+{
+  jusize i = 2;
+
+  if (size < 2 || data[0] != 0x2F)
+    return 0;
+
+  if (data[1] == 0x2F)
+    {
+      while (i < size && data[i] != 0x0A)
+        ++i;
+
+      return i;
+    }
+
+  if (data[1] == 0x2A)
+    {
+      while (i + 1 < size && !(data[i] == 0x2A && data[i + 1] == 0x2F))
+        ++i;
+
+      return i + 2 < size ? i + 2 : size;
+    }
+
+  return 0;
+}
+
+/**
+ * Finds the end of the value at data[0] in text that is already known to be
+ * valid, so only nesting, strings and comments are tracked.
+ *
+ * @return - the length of the value
+ */
+
+static jusize
+json_skip_value (const char *data, jusize size)
+{
+  jusize i = 0, depth = 0, n;
+
+  do
+    {
+      switch (data[i])
+        {
+        case 0x22:
+          while (++i < size && data[i] != 0x22)
+            if (data[i] == 0x5C)
+              ++i;
+
+          ++i;
+          break;
+        case 0x5B:
+        case 0x7B:
+          ++depth;
+          ++i;
+          break;
+        case 0x5D:
+        case 0x7D:
+          --depth;
+          ++i;
+          break;
+        default:
+          if ((n = json_skip_comment (data + i, size - i)))
+            {
+              i += n;
+              break;
+            }
+
+          if (depth)
+            {
+              ++i;
+              break;
+            }
+
+          // a number or literal ends at the first delimiter
+          while (i < size && data[i] != 0x2C && data[i] != 0x5D
+                 && data[i] != 0x7D && data[i] != 0x20 && data[i] != 0x09
+                 && data[i] != 0x0A && data[i] != 0x0D && data[i] != 0x2F
+                 && data[i] != 0x00)
+            ++i;
+        }
+    }
+  while (depth && i < size);
+
+  return i < size ? i : size;
+}
+
+static json_value *
+json_redecode_child (json_value *value, jusize i)
+{
+  if (value->type == JSON_VALUE_TYPE_OBJECT)
+    return &value->value.object.entries[i].value;
+
+  return value->value.array.elements + i;
+}
+
+static jusize
+json_redecode_size (json_value *value)
+{
+  if (value->type == JSON_VALUE_TYPE_OBJECT)
+    return value->value.object.size;
+
+  if (value->type == JSON_VALUE_TYPE_ARRAY)
+    return value->value.array.size;
+
+  return 0;
+}
+
+// values nested deeper than this are re-decoded with their ancestor
+#ifndef JSON_REDECODE_MAX_DEPTH
+#define JSON_REDECODE_MAX_DEPTH 64
+#endif
+
+typedef struct json_redecode_frame
+{
+  json_value *value;
+  jusize start, index;
+} json_redecode_frame;
+
+static json_error
+json_redecode_impl (json_decoder *decoder, json_value *value,
+                    const char *old_buf, jusize old_size, const char *new_buf,
+                    jusize new_size, jusize edit_start, jusize edit_len,
+                    json_decode_error *decode_error)
+{
+  json_redecode_frame frames[JSON_REDECODE_MAX_DEPTH];
+  jusize depth = 0, edit_end = edit_start + edit_len, bound = old_size;
+  jusize new_len = new_size + edit_len - old_size, bom;
+  json_value tmp;
+
+  if (old_size > (ju32) -1 || new_size > (ju32) -1 || edit_end > old_size
+      || new_size + edit_len < old_size)
+    goto full;
+
+  // raw numbers outside the edit would keep pointing into old_buf, and
+  // packed elements keep no offsets
+  if (decoder->lazy_numbers || decoder->pack_arrays)
+    goto full;
+
+  // offsets into a transcoding do not match the edit
+  if (json_detect_encoding (new_buf, new_size, decoder->ext_flags, &bom)
+          != JSON_ENCODING_UTF8
+      || json_detect_encoding (old_buf, old_size, decoder->ext_flags, &bom)
+             != JSON_ENCODING_UTF8)
+    goto full;
+
+  frames[depth++] = (json_redecode_frame) { value, value->start, 0 };
+
+  // descend to the deepest value whose region could hold the whole edit
+  while (depth < JSON_REDECODE_MAX_DEPTH)
+    {
+      json_redecode_frame *frame = frames + depth - 1;
+      jusize size = json_redecode_size (frame->value), lo = 0, hi = size;
+
+      // the last child that starts at or before the edit
+      while (lo < hi)
+        {
+          jusize mid = lo + (hi - lo) / 2;
+
+          if (frame->start + json_redecode_child (frame->value, mid)->start
+              <= edit_start)
+            lo = mid + 1;
+          else
+            hi = mid;
+        }
+
+      if (!lo)
+        break;
+
+      if (lo < size)
+        bound = frame->start
+                + json_redecode_child (frame->value, lo)->start;
+
+      if (edit_end > bound)
+        break;
+
+      frames[depth] = (json_redecode_frame) {
+        json_redecode_child (frame->value, lo - 1),
+        frame->start + json_redecode_child (frame->value, lo - 1)->start,
+        lo - 1,
+      };
+      ++depth;
+    }
+
+  // re-decode the innermost candidate whose old text contains the edit and
+  // whose new text decodes to a single value of the shifted length
+  while (depth--)
+    {
+      json_redecode_frame *frame = frames + depth;
+      jusize end, new_end;
+      ju32 delta;
+
+      end = frame->start
+            + json_skip_value (old_buf + frame->start,
+                               old_size - frame->start);
+
+      if (edit_start < frame->start || edit_end > end)
+        continue;
+
+      new_end = edit_start + new_len + (end - edit_end);
+
+      buffer buf = {
+        .data = new_buf + frame->start,
+        .size = new_end - frame->start,
+        .row  = 1,
+        .col  = 1,
+      };
+
+      decoder->base  = new_buf;
+      decoder->depth = (ju32) depth;
+
+      if (json_decode_value_any (decoder, &tmp, &buf) != JSON_ERROR_NONE)
+        continue;
+
+      if (buf.size)
+        {
+          json_value_dispose_ext (decoder->allocator, &tmp);
+          continue;
+        }
+
+      tmp.start = frame->value->start;
+      json_value_dispose_ext (decoder->allocator, frame->value);
+      *frame->value = tmp;
+
+      // offsets are relative, so only later siblings of each ancestor move
+      delta = (ju32) (new_size - old_size);
+
+      for (; depth; --depth)
+        {
+          json_value *parent = frames[depth - 1].value;
+          jusize size        = json_redecode_size (parent);
+
+          for (jusize i = frames[depth].index + 1; i < size; ++i)
+            json_redecode_child (parent, i)->start += delta;
+        }
+
+      return JSON_ERROR_NONE;
+    }
+
+full:
+  {
+    json_error error;
+
+    if ((error = json_decode_text (decoder, new_buf, new_size, &tmp,
+                                   decode_error))
+        != JSON_ERROR_NONE)
+      return error;
+
+    json_value_dispose_ext (decoder->allocator, value);
+    *value = tmp;
+
+    return JSON_ERROR_NONE;
+  }
+}
+
+json_error
+json_redecode (const json_decoder_opts *decoder_opts, json_value *value,
+               const char *old_buf, jusize old_size, const char *new_buf,
+               jusize new_size, jusize edit_start, jusize edit_len,
+               json_decode_error *decode_error)
+{
+  json_decoder decoder;
+  json_error error;
+
+  json_decoder_init (&decoder, decoder_opts);
+
+  error = json_redecode_impl (&decoder, value, old_buf, old_size, new_buf,
+                              new_size, edit_start, edit_len, decode_error);
+
+  json_decoder_release (&decoder);
+
+  return error;
+}
@@ -0,0 +1,460 @@
+/*
+ * Copyright (c) 2025 Zachary Lamb
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Shortest round-trip formatting of doubles after Ulf Adams' Ryu (PLDI 2018).
+ * The number is split into a decimal interval of values that round to it and
+ * trailing digits are removed while the interval still contains a unique
+ * shortest representation.
+ */
+
+#include <string.h>
+
+#include "_internal.h"
+#include "json_dtoa_table.h"
+
+#define JSON_DOUBLE_MANTISSA_BITS 52
+#define JSON_DOUBLE_EXPONENT_BITS 11
+#define JSON_DOUBLE_BIAS          1023
+
+// integers below 2^53 are exact and take the integer path
+#define JSON_DTOA_MAX_INT 9007199254740992.0
+
+// scientific exponents in [JSON_DTOA_MIN_FIXED, JSON_DTOA_MAX_FIXED) are
+// written without an exponent
+#define JSON_DTOA_MIN_FIXED -6
+#define JSON_DTOA_MAX_FIXED 21
+
+static const char digit_pairs[200] = {
+  '0', '0', '0', '1', '0', '2', '0', '3', '0', '4', '0', '5', '0', '6', '0',
+  '7', '0', '8', '0', '9', '1', '0', '1', '1', '1', '2', '1', '3', '1', '4',
+  '1', '5', '1', '6', '1', '7', '1', '8', '1', '9', '2', '0', '2', '1', '2',
+  '2', '2', '3', '2', '4', '2', '5', '2', '6', '2', '7', '2', '8', '2', '9',
+  '3', '0', '3', '1', '3', '2', '3', '3', '3', '4', '3', '5', '3', '6', '3',
+  '7', '3', '8', '3', '9', '4', '0', '4', '1', '4', '2', '4', '3', '4', '4',
+  '4', '5', '4', '6', '4', '7', '4', '8', '4', '9', '5', '0', '5', '1', '5',
+  '2', '5', '3', '5', '4', '5', '5', '5', '6', '5', '7', '5', '8', '5', '9',
+  '6', '0', '6', '1', '6', '2', '6', '3', '6', '4', '6', '5', '6', '6', '6',
+  '7', '6', '8', '6', '9', '7', '0', '7', '1', '7', '2', '7', '3', '7', '4',
+  '7', '5', '7', '6', '7', '7', '7', '8', '7', '9', '8', '0', '8', '1', '8',
+  '2', '8', '3', '8', '4', '8', '5', '8', '6', '8', '7', '8', '8', '8', '9',
+  '9', '0', '9', '1', '9', '2', '9', '3', '9', '4', '9', '5', '9', '6', '9',
+  '7', '9', '8', '9', '9',
+};
+
+#if defined(__SIZEOF_INT128__)
+__extension__ typedef unsigned __int128 ju128;
+
+static inline ju64
+mul_shift64 (ju64 m, const ju64 *mul, j32 j)
+{
+  ju128 b0 = (ju128) m * mul[0];
+  ju128 b2 = (ju128) m * mul[1];
+  return (ju64) (((b0 >> 64) + b2) >> (j - 64));
+}
+#else
+static inline ju64
+umul128 (ju64 a, ju64 b, ju64 *hi)
+{
+  ju64 a_lo = (ju32) a, a_hi = a >> 32;
+  ju64 b_lo = (ju32) b, b_hi = b >> 32;
+
+  ju64 b00 = a_lo * b_lo;
+  ju64 b01 = a_lo * b_hi;
+  ju64 b10 = a_hi * b_lo;
+  ju64 b11 = a_hi * b_hi;
+
+  ju64 mid1 = b10 + (b00 >> 32);
+  ju64 mid2 = b01 + (ju32) mid1;
+
+  *hi = b11 + (mid1 >> 32) + (mid2 >> 32);
+  return (mid2 << 32) | (ju32) b00;
+}
+
+static inline ju64
+mul_shift64 (ju64 m, const ju64 *mul, j32 j)
+{
+  ju64 high0, high1, low1, sum;
+  ju32 dist = j - 64;
+
+  low1 = umul128 (m, mul[1], &high1);
+  umul128 (m, mul[0], &high0);
+
+  sum = high0 + low1;
+
+  if (sum < high0)
+    ++high1;
+
+  if (!dist)
+    return sum;
+
+  return (high1 << (64 - dist)) | (sum >> dist);
+}
+#endif
+
+static inline ju32
+pow5_bits (j32 e)
+{
+  return (ju32) (((ju32) e * 1217359) >> 19) + 1;
+}
+
+static inline ju32
+log10_pow2 (j32 e)
+{
+  return ((ju32) e * 78913) >> 18;
+}
+
+static inline ju32
+log10_pow5 (j32 e)
+{
+  return ((ju32) e * 732923) >> 20;
+}
+
+static inline ju32
+pow5_factor (ju64 value)
+{
+  ju32 count = 0;
+
+  while (value % 5 == 0)
+    {
+      value /= 5;
+      ++count;
+    }
+
+  return count;
+}
+
+static inline json_bool
+multiple_of_pow5 (ju64 value, ju32 p)
+{
+  return pow5_factor (value) >= p;
+}
+
+static inline json_bool
+multiple_of_pow2 (ju64 value, ju32 p)
+{
+  return (value & ((1ull << p) - 1)) == 0;
+}
+
+static inline ju32
+decimal_length (ju64 v)
+{
+  ju32 len = 1;
+
+  while (v >= 10)
+    {
+      v /= 10;
+      ++len;
+    }
+
+  return len;
+}
+
+/**
+ * Writes the digits of v right to left ending just before out + len.
+ */
+
+static inline void
+write_digits (char *out, ju32 len, ju64 v)
+{
+  char *p = out + len;
+
+  while (v >= 100)
+    {
+      ju32 r = (ju32) (v % 100);
+      v /= 100;
+      p -= 2;
+      memcpy (p, digit_pairs + r * 2, 2);
+    }
+
+  if (v >= 10)
+    {
+      p -= 2;
+      memcpy (p, digit_pairs + v * 2, 2);
+    }
+  else
+    *--p = (char) ('0' + v);
+}
+
+/**
+ * Computes the shortest decimal digits and exponent of a finite, non-zero
+ * double given its raw mantissa and biased exponent.
+ */
+
+static void
+json_d2d (ju64 ieee_mantissa, ju32 ieee_exponent, ju64 *out_digits,
+          j32 *out_exp)
+{
+  j32 e2, e10;
+  ju64 m2, mv, vr, vp, vm, output;
+  ju32 mm_shift, removed = 0;
+  ju8 last_removed_digit = 0;
+  json_bool accept_bounds, vm_trailing_zeros = 0, vr_trailing_zeros = 0;
+
+  if (ieee_exponent == 0)
+    {
+      e2 = 1 - JSON_DOUBLE_BIAS - JSON_DOUBLE_MANTISSA_BITS - 2;
+      m2 = ieee_mantissa;
+    }
+  else
+    {
+      e2 = (j32) ieee_exponent - JSON_DOUBLE_BIAS - JSON_DOUBLE_MANTISSA_BITS
+           - 2;
+      m2 = (1ull << JSON_DOUBLE_MANTISSA_BITS) | ieee_mantissa;
+    }
+
+  accept_bounds = (m2 & 1) == 0;
+
+  // the interval of values that round to this double is [vm, vp] around vr,
+  // all scaled by four to keep the bounds integral
+  mv       = 4 * m2;
+  mm_shift = ieee_mantissa != 0 || ieee_exponent <= 1;
+
+  if (e2 >= 0)
+    {
+      ju32 q = log10_pow2 (e2) - (e2 > 3);
+      j32 k  = JSON_POW5_INV_BITCOUNT + pow5_bits (q) - 1;
+      j32 i  = -e2 + (j32) q + k;
+
+      e10 = q;
+
+      vr = mul_shift64 (4 * m2, json_pow5_inv_split[q], i);
+      vp = mul_shift64 (4 * m2 + 2, json_pow5_inv_split[q], i);
+      vm = mul_shift64 (4 * m2 - 1 - mm_shift, json_pow5_inv_split[q], i);
+
+      if (q <= 21)
+        {
+          if (mv % 5 == 0)
+            vr_trailing_zeros = multiple_of_pow5 (mv, q);
+          else if (accept_bounds)
+            vm_trailing_zeros = multiple_of_pow5 (mv - 1 - mm_shift, q);
+          else
+            vp -= multiple_of_pow5 (mv + 2, q);
+        }
+    }
+  else
+    {
+      ju32 q = log10_pow5 (-e2) - (-e2 > 1);
+      j32 i  = -e2 - (j32) q;
+      j32 k  = (j32) pow5_bits (i) - JSON_POW5_BITCOUNT;
+      j32 j  = (j32) q - k;
+
+      e10 = (j32) q + e2;
+
+      vr = mul_shift64 (4 * m2, json_pow5_split[i], j);
+      vp = mul_shift64 (4 * m2 + 2, json_pow5_split[i], j);
+      vm = mul_shift64 (4 * m2 - 1 - mm_shift, json_pow5_split[i], j);
+
+      if (q <= 1)
+        {
+          vr_trailing_zeros = 1;
+
+          if (accept_bounds)
+            vm_trailing_zeros = mm_shift == 1;
+          else
+            --vp;
+        }
+      else if (q < 63)
+        vr_trailing_zeros = multiple_of_pow2 (mv, q);
+    }
+
+  if (vm_trailing_zeros || vr_trailing_zeros)
+    {
+      // rare path that tracks whether the removed digits are all zero
+      while (vp / 10 > vm / 10)
+        {
+          vm_trailing_zeros &= vm % 10 == 0;
+          vr_trailing_zeros &= last_removed_digit == 0;
+          last_removed_digit = vr % 10;
+
+          vr /= 10;
+          vp /= 10;
+          vm /= 10;
+          ++removed;
+        }
+
+      if (vm_trailing_zeros)
+        while (vm % 10 == 0)
+          {
+            vr_trailing_zeros &= last_removed_digit == 0;
+            last_removed_digit = vr % 10;
+
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            ++removed;
+          }
+
+      // round half to even when the exact value ends in 5
+      if (vr_trailing_zeros && last_removed_digit == 5 && vr % 2 == 0)
+        last_removed_digit = 4;
+
+      output = vr
+               + ((vr == vm && (!accept_bounds || !vm_trailing_zeros))
+                  || last_removed_digit >= 5);
+    }
+  else
+    {
+      json_bool round_up = 0;
+
+      if (vp / 100 > vm / 100)
+        {
+          round_up = vr % 100 >= 50;
+
+          vr /= 100;
+          vp /= 100;
+          vm /= 100;
+          removed += 2;
+        }
+
+      while (vp / 10 > vm / 10)
+        {
+          round_up = vr % 10 >= 5;
+
+          vr /= 10;
+          vp /= 10;
+          vm /= 10;
+          ++removed;
+        }
+
+      output = vr + (vr == vm || round_up);
+    }
+
+  *out_digits = output;
+  *out_exp    = e10 + (j32) removed;
+}
+
+/**
+ * Lays out digits * 10^exp in fixed or scientific notation.
+ */
+
+static jusize
+json_dtoa_layout (char *out, ju64 digits, j32 exp)
+{
+  ju32 len = decimal_length (digits);
+  j32 sci  = exp + (j32) len - 1;
+  char *p  = out;
+
+  if (sci >= JSON_DTOA_MIN_FIXED && sci < JSON_DTOA_MAX_FIXED)
+    {
+      if (exp >= 0)
+        {
+          write_digits (p, len, digits);
+          p += len;
+          memset (p, '0', exp);
+          return p - out + exp;
+        }
+
+      if (sci >= 0)
+        {
+          // 123.45: shift the fractional digits right to make room for '.'
+          write_digits (p, len, digits);
+          memmove (p + sci + 2, p + sci + 1, len - sci - 1);
+          p[sci + 1] = '.';
+          return len + 1;
+        }
+
+      // 0.00123
+      p[0] = '0';
+      p[1] = '.';
+      memset (p + 2, '0', -sci - 1);
+      p += 2 + (-sci - 1);
+      write_digits (p, len, digits);
+      return p - out + len;
+    }
+
+  // 1.2345e-7
+  write_digits (p + 1, len, digits);
+  p[0] = p[1];
+
+  if (len > 1)
+    {
+      p[1] = '.';
+      p += len + 1;
+    }
+  else
+    p += 1;
+
+  *p++ = 'e';
+
+  if (sci < 0)
+    {
+      *p++ = '-';
+      sci  = -sci;
+    }
+
+  len = decimal_length ((ju64) sci);
+  write_digits (p, len, (ju64) sci);
+
+  return p - out + len;
+}
+
+jusize
+json_dtoa (json_number number, char *buf)
+{
+  ju64 bits, ieee_mantissa, digits;
+  ju32 ieee_exponent;
+  j32 exp;
+  char *p = buf;
+
+  memcpy (&bits, &number, sizeof (bits));
+
+  ieee_mantissa = bits & ((1ull << JSON_DOUBLE_MANTISSA_BITS) - 1);
+  ieee_exponent = (ju32) ((bits >> JSON_DOUBLE_MANTISSA_BITS)
+                          & ((1u << JSON_DOUBLE_EXPONENT_BITS) - 1));
+
+  // JSON has no representation for infinities or NaN
+  if (ieee_exponent == (1u << JSON_DOUBLE_EXPONENT_BITS) - 1)
+    {
+      memcpy (buf, "null", 4);
+      return 4;
+    }
+
+  if (bits >> 63)
+    {
+      *p++   = '-';
+      number = -number;
+    }
+
+  if (!ieee_exponent && !ieee_mantissa)
+    {
+      *p++ = '0';
+      return p - buf;
+    }
+
+  if (number < JSON_DTOA_MAX_INT && number == (json_number) (ju64) number)
+    {
+      digits = (ju64) number;
+      exp    = 0;
+
+      // keep trailing zeros out of the digits so layout matches json_d2d
+      while (digits % 10 == 0)
+        {
+          digits /= 10;
+          ++exp;
+        }
+    }
+  else
+    json_d2d (ieee_mantissa, ieee_exponent, &digits, &exp);
+
+  return p - buf + json_dtoa_layout (p, digits, exp);
+}
@@ -55,6 +55,42 @@ json_error_to_str (json_error error)
       return "expected [0-9] after '0'";
     case JSON_ERROR_BAD_HEX:
       return "expected [0-9] after '0x'";
+    case JSON_ERROR_BAD_ARRAY:
+      return "expected ',' or ']' after array element";
+    case JSON_ERROR_BAD_OBJECT:
+      return "expected ',' or '}' after object member";
+    case JSON_ERROR_BAD_KEY:
+      return "expected string key";
+    case JSON_ERROR_BAD_MEMBER:
+      return "expected ':' after key";
+    case JSON_ERROR_UNCLOSED_STR:
+      return "expected closing '\"' for '\"'";
+    case JSON_ERROR_BAD_STRING:
+      return "unescaped control character in string";
+    case JSON_ERROR_BAD_ESCAPE:
+      return "invalid escape sequence";
+    case JSON_ERROR_BAD_LITERAL:
+      return "expected 'true', 'false' or 'null'";
+    case JSON_ERROR_BAD_VALUE:
+      return "expected value";
+    case JSON_ERROR_DUP_KEY:
+      return "duplicate key in object";
+    case JSON_ERROR_IO:
+      return "I/O error";
+    case JSON_ERROR_BAD_SNAPSHOT:
+      return "invalid or incompatible snapshot";
+    case JSON_ERROR_BAD_PATCH:
+      return "invalid patch document";
+    case JSON_ERROR_BAD_POINTER:
+      return "json pointer does not resolve";
+    case JSON_ERROR_TEST_FAILED:
+      return "patch test operation failed";
+    case JSON_ERROR_BAD_UTF8:
+      return "invalid UTF-8 in string";
+    case JSON_ERROR_BAD_ENCODING:
+      return "invalid UTF-16 or UTF-32 text";
+    case JSON_ERROR_TOO_DEEP:
+      return "maximum nesting depth exceeded";
     default:
       return "unknown error";
     }
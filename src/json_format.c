@@ -0,0 +1,477 @@
+/*
+ * Copyright (c) 2025 Zachary Lamb
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "_internal.h"
+
+#ifndef JSON_FORMAT_BUF_SIZE
+#define JSON_FORMAT_BUF_SIZE (1024 * 64)
+#endif
+
+#define JSON_FORMAT_NUMBER_EXTS                                               \
+  (JSON_EXT_TRAILING_DECIMAL | JSON_EXT_OCTAL_LITERALS | JSON_EXT_HEX_LITERALS)
+
+typedef struct json_formatter
+{
+  json_decoder decoder;
+  json_writer *writer;
+  json_bool pretty;
+  ju32 indent, depth;
+  jusize len;
+  char out[JSON_FORMAT_BUF_SIZE];
+} json_formatter;
+
+static json_error json_format_value (json_formatter *formatter, buffer *buf);
+
+static json_error
+json_format_flush (json_formatter *formatter)
+{
+  json_writer *writer = formatter->writer;
+  jusize len          = formatter->len;
+
+  if (!len)
+    return JSON_ERROR_NONE;
+
+  formatter->len = 0;
+  return writer->json_write (formatter->out, len, writer->ctx);
+}
+
+static json_error
+json_format_emit (json_formatter *formatter, const char *data, jusize size)
+{
+  json_error error;
+
+  if (size > JSON_FORMAT_BUF_SIZE - formatter->len)
+    {
+      if ((error = json_format_flush (formatter)) != JSON_ERROR_NONE)
+        return error;
+
+      // spans larger than the buffer skip the copy entirely
+      if (size >= JSON_FORMAT_BUF_SIZE)
+        return formatter->writer->json_write (data, size,
+                                              formatter->writer->ctx);
+    }
+
+  memcpy (formatter->out + formatter->len, data, size);
+  formatter->len += size;
+
+  return JSON_ERROR_NONE;
+}
+
+static inline json_error
+json_format_putc (json_formatter *formatter, char ch)
+{
+  json_error error;
+
+  if (formatter->len == JSON_FORMAT_BUF_SIZE
+      && (error = json_format_flush (formatter)) != JSON_ERROR_NONE)
+    return error;
+
+  formatter->out[formatter->len++] = ch;
+  return JSON_ERROR_NONE;
+}
+
+static json_error
+json_format_newline (json_formatter *formatter)
+{
+  static const char spaces[] = "                                ";
+  json_error error;
+  jusize n;
+
+  if (!formatter->pretty)
+    return JSON_ERROR_NONE;
+
+  if ((error = json_format_putc (formatter, 0x0A)) != JSON_ERROR_NONE)
+    return error;
+
+  n = (jusize) formatter->indent * formatter->depth;
+
+  while (n)
+    {
+      jusize chunk = n < sizeof (spaces) - 1 ? n : sizeof (spaces) - 1;
+
+      if ((error = json_format_emit (formatter, spaces, chunk))
+          != JSON_ERROR_NONE)
+        return error;
+
+      n -= chunk;
+    }
+
+  return JSON_ERROR_NONE;
+}
+
+static json_error
+json_format_number (json_formatter *formatter, buffer *buf, char ch)
+{
+  const char *start = buf->data;
+  json_value value;
+  json_error error;
+  jusize len, i;
+
+  if ((error = json_decode_number (&formatter->decoder, &value, buf, ch))
+      != JSON_ERROR_NONE)
+    return error;
+
+  len = buf->data - start;
+
+  if (!(formatter->decoder.ext_flags & JSON_FORMAT_NUMBER_EXTS))
+    return json_format_emit (formatter, start, len);
+
+  // a trailing decimal is dropped, which keeps the integer text exact
+  if (start[len - 1] == 0x2E)
+    return json_format_emit (formatter, start, len - 1);
+
+  i = start[0] == 0x2D;
+
+  // octal and hex literals are the only forms that follow a leading zero with
+  // anything other than a fraction or an exponent
+  if (len > i + 1 && start[i] == 0x30
+      && (is_digit (start[i + 1]) || start[i + 1] == 0x58
+          || start[i + 1] == 0x78))
+    {
+      char tmp[JSON_DTOA_BUF_SIZE];
+      return json_format_emit (formatter, tmp,
+                               json_dtoa (value.value.number, tmp));
+    }
+
+  return json_format_emit (formatter, start, len);
+}
+
+static json_error
+json_format_literal (json_formatter *formatter, buffer *buf, char ch)
+{
+  json_value literal;
+  json_error error;
+
+  if ((error = json_decode_literal (&formatter->decoder, &literal, buf, ch))
+      != JSON_ERROR_NONE)
+    return error;
+
+  if (literal.type == JSON_VALUE_TYPE_NULL)
+    return json_format_emit (formatter, "null", 4);
+
+  return literal.value.bool ? json_format_emit (formatter, "true", 4)
+                            : json_format_emit (formatter, "false", 5);
+}
+
+static json_error
+json_format_string (json_formatter *formatter, buffer *buf)
+{
+  const char *start = buf->data;
+  jusize size;
+  json_error error;
+
+  if ((error = json_scan_string (&formatter->decoder, buf)) != JSON_ERROR_NONE)
+    return error;
+
+  size = buf->data - start;
+
+  if (!(formatter->decoder.ext_flags & JSON_EXT_UNICODE_REPLACEMENT))
+    return json_format_emit (formatter, start, size);
+
+  // the scan accepted any invalid UTF-8, which is written out as U+FFFD
+  while (size)
+    {
+      jusize valid = json_utf8_valid_prefix (start, size);
+      ju8 len;
+
+      if ((error = json_format_emit (formatter, start, valid))
+          != JSON_ERROR_NONE)
+        return error;
+
+      if (valid == size)
+        break;
+
+      json_buf_decode_char32 (start + valid, size - valid, NULL, &len);
+
+      if ((error = json_format_emit (formatter, "\xEF\xBF\xBD", 3))
+          != JSON_ERROR_NONE)
+        return error;
+
+      start += valid + len;
+      size -= valid + len;
+    }
+
+  return JSON_ERROR_NONE;
+}
+
+static json_error
+json_format_array (json_formatter *formatter, buffer *buf)
+{
+  json_error error;
+
+  BUF_ADVANCE_COL (buf);
+
+  json_consume_whitespace (&formatter->decoder, buf);
+
+  if (!buf->size)
+    return JSON_ERROR_UNCLOSED_ARR;
+
+  if (buf->data[0] == 0x5D)
+    {
+      BUF_ADVANCE_COL (buf);
+      return json_format_emit (formatter, "[]", 2);
+    }
+
+  if ((error = json_format_putc (formatter, 0x5B)) != JSON_ERROR_NONE)
+    return error;
+
+  ++formatter->depth;
+
+  while (1)
+    {
+      if ((error = json_format_newline (formatter)) != JSON_ERROR_NONE)
+        return error;
+
+      error = json_format_value (formatter, buf);
+
+      if (error == JSON_ERROR_EOF)
+        return JSON_ERROR_UNCLOSED_ARR;
+
+      if (error != JSON_ERROR_NONE)
+        return error;
+
+      json_consume_whitespace (&formatter->decoder, buf);
+
+      if (!buf->size)
+        return JSON_ERROR_UNCLOSED_ARR;
+
+      if (buf->data[0] == 0x5D)
+        {
+          BUF_ADVANCE_COL (buf);
+          break;
+        }
+
+      if (buf->data[0] != 0x2C)
+        return JSON_ERROR_BAD_ARRAY;
+
+      BUF_ADVANCE_COL (buf);
+      json_consume_whitespace (&formatter->decoder, buf);
+
+      if ((error = json_format_putc (formatter, 0x2C)) != JSON_ERROR_NONE)
+        return error;
+    }
+
+  --formatter->depth;
+
+  if ((error = json_format_newline (formatter)) != JSON_ERROR_NONE)
+    return error;
+
+  return json_format_putc (formatter, 0x5D);
+}
+
+static json_error
+json_format_object (json_formatter *formatter, buffer *buf)
+{
+  json_error error;
+
+  BUF_ADVANCE_COL (buf);
+
+  json_consume_whitespace (&formatter->decoder, buf);
+
+  if (!buf->size)
+    return JSON_ERROR_UNCLOSED_OBJ;
+
+  if (buf->data[0] == 0x7D)
+    {
+      BUF_ADVANCE_COL (buf);
+      return json_format_emit (formatter, "{}", 2);
+    }
+
+  if ((error = json_format_putc (formatter, 0x7B)) != JSON_ERROR_NONE)
+    return error;
+
+  ++formatter->depth;
+
+  while (1)
+    {
+      if ((error = json_format_newline (formatter)) != JSON_ERROR_NONE)
+        return error;
+
+      if (!buf->size)
+        return JSON_ERROR_UNCLOSED_OBJ;
+
+      if (buf->data[0] != 0x22)
+        return JSON_ERROR_BAD_KEY;
+
+      if ((error = json_format_string (formatter, buf)) != JSON_ERROR_NONE)
+        return error;
+
+      json_consume_whitespace (&formatter->decoder, buf);
+
+      if (!buf->size)
+        return JSON_ERROR_UNCLOSED_OBJ;
+
+      if (buf->data[0] != 0x3A)
+        return JSON_ERROR_BAD_MEMBER;
+
+      BUF_ADVANCE_COL (buf);
+      json_consume_whitespace (&formatter->decoder, buf);
+
+      if (formatter->pretty)
+        error = json_format_emit (formatter, ": ", 2);
+      else
+        error = json_format_putc (formatter, 0x3A);
+
+      if (error != JSON_ERROR_NONE)
+        return error;
+
+      error = json_format_value (formatter, buf);
+
+      if (error == JSON_ERROR_EOF)
+        return JSON_ERROR_UNCLOSED_OBJ;
+
+      if (error != JSON_ERROR_NONE)
+        return error;
+
+      json_consume_whitespace (&formatter->decoder, buf);
+
+      if (!buf->size)
+        return JSON_ERROR_UNCLOSED_OBJ;
+
+      if (buf->data[0] == 0x7D)
+        {
+          BUF_ADVANCE_COL (buf);
+          break;
+        }
+
+      if (buf->data[0] != 0x2C)
+        return JSON_ERROR_BAD_OBJECT;
+
+      BUF_ADVANCE_COL (buf);
+      json_consume_whitespace (&formatter->decoder, buf);
+
+      if ((error = json_format_putc (formatter, 0x2C)) != JSON_ERROR_NONE)
+        return error;
+    }
+
+  --formatter->depth;
+
+  if ((error = json_format_newline (formatter)) != JSON_ERROR_NONE)
+    return error;
+
+  return json_format_putc (formatter, 0x7D);
+}
+
+static json_error
+json_format_value (json_formatter *formatter, buffer *buf)
+{
+  if (!buf->size)
+    return JSON_ERROR_EOF;
+
+  char ch = buf->data[0];
+
+  if (ch == 0x22)
+    return json_format_string (formatter, buf);
+
+  if (ch == 0x2D || is_digit (ch))
+    return json_format_number (formatter, buf, ch);
+
+  // depth counts the containers around this value, as the decoder's does
+  if ((ch == 0x5B || ch == 0x7B)
+      && formatter->depth == formatter->decoder.max_depth)
+    return JSON_ERROR_TOO_DEEP;
+
+  if (ch == 0x5B)
+    return json_format_array (formatter, buf);
+
+  if (ch == 0x7B)
+    return json_format_object (formatter, buf);
+
+  if (ch == 0x66 || ch == 0x6E || ch == 0x74)
+    return json_format_literal (formatter, buf, ch);
+
+  return JSON_ERROR_BAD_VALUE;
+}
+
+static json_error
+json_format (json_formatter *formatter, const char *_buf, size_t size,
+             json_decode_error *decode_error)
+{
+  buffer buf = { .data = _buf, .size = size, .row = 1, .col = 1 };
+  json_error error;
+
+  if (!size)
+    {
+      EMIT_DECODE_ERROR (JSON_ERROR_EOF, buf.row, buf.col);
+      return JSON_ERROR_EOF;
+    }
+
+  // numbers are copied from the text, so only octal and hex literals, which
+  // are never left raw, need converting
+  formatter->decoder.lazy_numbers = JSON_TRUE;
+
+  json_consume_whitespace (&formatter->decoder, &buf);
+
+  if ((error = json_format_value (formatter, &buf)) != JSON_ERROR_NONE)
+    {
+      EMIT_DECODE_ERROR (error, buf.row, buf.col);
+      return error;
+    }
+
+  json_consume_whitespace (&formatter->decoder, &buf);
+
+  if (buf.size != 0 && (buf.size != 1 || buf.data[0] != 0))
+    {
+      EMIT_DECODE_ERROR (JSON_ERROR_TRAILING_DATA, buf.row, buf.col);
+      return JSON_ERROR_TRAILING_DATA;
+    }
+
+  if ((error = json_format_flush (formatter)) != JSON_ERROR_NONE)
+    EMIT_DECODE_ERROR (error, buf.row, buf.col);
+
+  return error;
+}
+
+json_error
+json_minify (const json_decoder_opts *decoder_opts, const char *buf,
+             size_t size, json_writer *writer, json_decode_error *decode_error)
+{
+  json_formatter formatter;
+
+  json_decoder_init (&formatter.decoder, decoder_opts);
+  formatter.writer = writer;
+  formatter.pretty = JSON_FALSE;
+  formatter.indent = 0;
+  formatter.depth  = 0;
+  formatter.len    = 0;
+
+  return json_format (&formatter, buf, size, decode_error);
+}
+
+json_error
+json_prettify (const json_decoder_opts *decoder_opts, ju32 indent,
+               const char *buf, size_t size, json_writer *writer,
+               json_decode_error *decode_error)
+{
+  json_formatter formatter;
+
+  json_decoder_init (&formatter.decoder, decoder_opts);
+  formatter.writer = writer;
+  formatter.pretty = JSON_TRUE;
+  formatter.indent = indent;
+  formatter.depth  = 0;
+  formatter.len    = 0;
+
+  return json_format (&formatter, buf, size, decode_error);
+}
@@ -0,0 +1,648 @@
+/*
+ * Copyright (c) 2025 Zachary Lamb
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "_internal.h"
+#include "json_types.h"
+
+static void
+json_msgpack_put_header (ju8 *out, jusize *len, ju8 fix, jusize fix_max,
+                         ju8 tag16, jusize n)
+{
+  ju8 tmp[5];
+
+  if (n <= fix_max)
+    {
+      tmp[0] = fix | (ju8) n;
+      json_bin_put (out, len, tmp, 1);
+    }
+  else if (n <= 0xFF && tag16 == 0xDA)
+    {
+      // only strings have an 8-bit length form
+      tmp[0] = 0xD9;
+      tmp[1] = (ju8) n;
+      json_bin_put (out, len, tmp, 2);
+    }
+  else if (n <= 0xFFFF)
+    {
+      tmp[0] = tag16;
+      json_store_be16 (tmp + 1, (ju16) n);
+      json_bin_put (out, len, tmp, 3);
+    }
+  else
+    {
+      tmp[0] = tag16 + 1;
+      json_store_be32 (tmp + 1, (ju32) n);
+      json_bin_put (out, len, tmp, 5);
+    }
+}
+
+static void
+json_msgpack_put_number (ju8 *out, jusize *len, json_number number)
+{
+  ju8 tmp[9];
+  ju64 mag;
+  json_bool neg;
+
+  if (json_number_to_int (number, &mag, &neg)
+      && (!neg || mag <= (1ull << 63)))
+    {
+      if (!neg)
+        {
+          if (mag <= 0x7F)
+            {
+              tmp[0] = (ju8) mag;
+              json_bin_put (out, len, tmp, 1);
+            }
+          else if (mag <= 0xFF)
+            {
+              tmp[0] = 0xCC;
+              tmp[1] = (ju8) mag;
+              json_bin_put (out, len, tmp, 2);
+            }
+          else if (mag <= 0xFFFF)
+            {
+              tmp[0] = 0xCD;
+              json_store_be16 (tmp + 1, (ju16) mag);
+              json_bin_put (out, len, tmp, 3);
+            }
+          else if (mag <= 0xFFFFFFFF)
+            {
+              tmp[0] = 0xCE;
+              json_store_be32 (tmp + 1, (ju32) mag);
+              json_bin_put (out, len, tmp, 5);
+            }
+          else
+            {
+              tmp[0] = 0xCF;
+              json_store_be64 (tmp + 1, mag);
+              json_bin_put (out, len, tmp, 9);
+            }
+        }
+      else
+        {
+          // two's complement of the magnitude
+          ju64 v = ~mag + 1;
+
+          if (mag <= 32)
+            {
+              tmp[0] = (ju8) v;
+              json_bin_put (out, len, tmp, 1);
+            }
+          else if (mag <= 0x80)
+            {
+              tmp[0] = 0xD0;
+              tmp[1] = (ju8) v;
+              json_bin_put (out, len, tmp, 2);
+            }
+          else if (mag <= 0x8000)
+            {
+              tmp[0] = 0xD1;
+              json_store_be16 (tmp + 1, (ju16) v);
+              json_bin_put (out, len, tmp, 3);
+            }
+          else if (mag <= 0x80000000)
+            {
+              tmp[0] = 0xD2;
+              json_store_be32 (tmp + 1, (ju32) v);
+              json_bin_put (out, len, tmp, 5);
+            }
+          else
+            {
+              tmp[0] = 0xD3;
+              json_store_be64 (tmp + 1, v);
+              json_bin_put (out, len, tmp, 9);
+            }
+        }
+
+      return;
+    }
+
+  if ((json_number) (float) number == number)
+    {
+      union
+      {
+        float f;
+        ju32 u;
+      } bits = { (float) number };
+
+      tmp[0] = 0xCA;
+      json_store_be32 (tmp + 1, bits.u);
+      json_bin_put (out, len, tmp, 5);
+    }
+  else
+    {
+      union
+      {
+        json_number n;
+        ju64 u;
+      } bits = { number };
+
+      tmp[0] = 0xCB;
+      json_store_be64 (tmp + 1, bits.u);
+      json_bin_put (out, len, tmp, 9);
+    }
+}
+
+static json_error
+json_msgpack_put_value (ju8 *out, jusize *len, json_value *value)
+{
+  json_error error;
+  ju8 tag;
+
+  switch (value->type)
+    {
+    case JSON_VALUE_TYPE_OBJECT:
+      {
+        json_object *object = &value->value.object;
+
+        if (object->size > 0xFFFFFFFF)
+          return JSON_ERROR_ENCODING;
+
+        json_msgpack_put_header (out, len, 0x80, 0x0F, 0xDE, object->size);
+
+        for (jusize i = 0; i < object->size; ++i)
+          {
+            json_entry *entry = object->entries + i;
+
+            if (entry->key_len > 0xFFFFFFFF)
+              return JSON_ERROR_ENCODING;
+
+            json_msgpack_put_header (out, len, 0xA0, 0x1F, 0xDA,
+                                     entry->key_len);
+            json_bin_put (out, len, entry->key, entry->key_len);
+
+            if ((error = json_msgpack_put_value (out, len, &entry->value))
+                != JSON_ERROR_NONE)
+              return error;
+          }
+
+        break;
+      }
+    case JSON_VALUE_TYPE_ARRAY:
+      {
+        json_array *array = &value->value.array;
+        json_value tmp;
+
+        if (array->size > 0xFFFFFFFF)
+          return JSON_ERROR_ENCODING;
+
+        json_msgpack_put_header (out, len, 0x90, 0x0F, 0xDC, array->size);
+
+        for (jusize i = 0; i < array->size; ++i)
+          if ((error = json_msgpack_put_value (out, len,
+                                               json_array_at (array, i, &tmp)))
+              != JSON_ERROR_NONE)
+            return error;
+
+        break;
+      }
+    case JSON_VALUE_TYPE_NUMBER:
+    case JSON_VALUE_TYPE_RAW_NUMBER:
+      json_msgpack_put_number (out, len, json_value_to_number (value));
+      break;
+    case JSON_VALUE_TYPE_STRING:
+      {
+        json_string *string = &value->value.string;
+
+        if (string->len > 0xFFFFFFFF)
+          return JSON_ERROR_ENCODING;
+
+        json_msgpack_put_header (out, len, 0xA0, 0x1F, 0xDA, string->len);
+        json_bin_put (out, len, string->str, string->len);
+        break;
+      }
+    case JSON_VALUE_TYPE_BOOL:
+      tag = value->value.bool ? 0xC3 : 0xC2;
+      json_bin_put (out, len, &tag, 1);
+      break;
+    case JSON_VALUE_TYPE_NULL:
+      tag = 0xC0;
+      json_bin_put (out, len, &tag, 1);
+      break;
+    default:
+      return JSON_ERROR_INTERNAL;
+    }
+
+  return JSON_ERROR_NONE;
+}
+
+json_error
+json_msgpack_encode_ext (json_allocator *allocator, json_value *value,
+                         char **out_buf, jusize *out_size)
+{
+  jusize len = 0;
+  json_error error;
+  ju8 *out;
+
+  if ((error = json_msgpack_put_value (NULL, &len, value)) != JSON_ERROR_NONE)
+    return error;
+
+  if (!(out = allocator->json_malloc (len ? len : 1, allocator->ctx)))
+    return JSON_ERROR_NOMEM;
+
+  len = 0;
+  json_msgpack_put_value (out, &len, value);
+
+  *out_buf  = (char *) out;
+  *out_size = len;
+
+  return JSON_ERROR_NONE;
+}
+
+json_error
+json_msgpack_encode (json_value *value, char **out_buf, jusize *out_size)
+{
+  return json_msgpack_encode_ext (&std_allocator, value, out_buf, out_size);
+}
+
+/**
+ * Reads the big-endian length that follows a str, array or map tag.
+ */
+
+static json_error
+json_msgpack_take_len (buffer *buf, jusize width, jusize *out_len)
+{
+  const ju8 *p = json_bin_take (buf, width);
+
+  if (!p)
+    return JSON_ERROR_EOF;
+
+  switch (width)
+    {
+    case 1:
+      *out_len = p[0];
+      break;
+    case 2:
+      *out_len = json_load_be16 (p);
+      break;
+    default:
+      *out_len = json_load_be32 (p);
+      break;
+    }
+
+  return JSON_ERROR_NONE;
+}
+
+static json_error
+json_msgpack_decode_str (json_decoder *decoder, json_string *string,
+                         buffer *buf, jusize len)
+{
+  const ju8 *p = json_bin_take (buf, len);
+
+  if (!p)
+    return JSON_ERROR_EOF;
+
+  return json_string_init_ext (decoder->allocator, string, (const char *) p,
+                               len);
+}
+
+static json_error json_msgpack_decode_value (json_decoder *decoder,
+                                             json_value *value, buffer *buf);
+
+static json_error
+json_msgpack_decode_array (json_decoder *decoder, json_value *value,
+                           buffer *buf, jusize size)
+{
+  json_array array = { 0 };
+  json_error error;
+
+  if (decoder->depth == decoder->max_depth)
+    return JSON_ERROR_TOO_DEEP;
+
+  // every element takes at least one byte
+  if (size > buf->size)
+    return JSON_ERROR_EOF;
+
+  if ((error = json_array_reserve_ext (decoder->allocator, &array, size))
+      != JSON_ERROR_NONE)
+    return error;
+
+  ++decoder->depth;
+
+  for (; array.size < size; ++array.size)
+    if ((error = json_msgpack_decode_value (decoder,
+                                            array.elements + array.size, buf))
+        != JSON_ERROR_NONE)
+      {
+        --decoder->depth;
+        json_array_dispose_ext (decoder->allocator, &array);
+        return error;
+      }
+
+  --decoder->depth;
+
+  value->type        = JSON_VALUE_TYPE_ARRAY;
+  value->value.array = array;
+
+  return JSON_ERROR_NONE;
+}
+
+static json_error
+json_msgpack_decode_object (json_decoder *decoder, json_value *value,
+                            buffer *buf, jusize size)
+{
+  json_object object = { 0 };
+  json_value tmpval;
+  json_error error;
+
+  if (decoder->depth == decoder->max_depth)
+    return JSON_ERROR_TOO_DEEP;
+
+  // every member takes at least two bytes
+  if (size > buf->size / 2)
+    return JSON_ERROR_EOF;
+
+  if ((error = json_object_reserve_ext (decoder->allocator, &object, size))
+      != JSON_ERROR_NONE)
+    return error;
+
+  ++decoder->depth;
+
+  for (jusize n = 0; n < size; ++n)
+    {
+      const ju8 *tag = json_bin_take (buf, 1);
+      json_string key;
+      jusize key_len, i;
+      ju32 hash;
+
+      if (!tag)
+        {
+          error = JSON_ERROR_EOF;
+          goto fail;
+        }
+
+      if (tag[0] >= 0xA0 && tag[0] <= 0xBF)
+        key_len = tag[0] & 0x1F;
+      else if (tag[0] >= 0xD9 && tag[0] <= 0xDB)
+        {
+          if ((error = json_msgpack_take_len (buf, 1u << (tag[0] - 0xD9),
+                                              &key_len))
+              != JSON_ERROR_NONE)
+            goto fail;
+        }
+      else
+        {
+          error = JSON_ERROR_BAD_KEY;
+          goto fail;
+        }
+
+      if ((error = json_msgpack_decode_str (decoder, &key, buf, key_len))
+          != JSON_ERROR_NONE)
+        goto fail;
+
+      hash = json_hash_key (key.str, key.len);
+      i    = json_object_find (&object, key.str, key.len, hash);
+
+      if (i < object.size && !(decoder->ext_flags & JSON_EXT_ALLOW_DUP_KEYS))
+        {
+          error = JSON_ERROR_DUP_KEY;
+          goto fail_key;
+        }
+
+      if ((error = json_msgpack_decode_value (decoder, &tmpval, buf))
+          != JSON_ERROR_NONE)
+        goto fail_key;
+
+      if (i < object.size)
+        {
+          json_value_dispose_ext (decoder->allocator,
+                                  &object.entries[i].value);
+          object.entries[i].value = tmpval;
+          decoder->allocator->json_free (key.str, decoder->allocator->ctx);
+        }
+      else
+        // cannot fail, the entries were reserved up front
+        json_object_append_ext (decoder->allocator, &object, key.str, key.len,
+                                hash, &tmpval);
+
+      continue;
+
+    fail_key:
+      decoder->allocator->json_free (key.str, decoder->allocator->ctx);
+      goto fail;
+    }
+
+  --decoder->depth;
+
+  value->type         = JSON_VALUE_TYPE_OBJECT;
+  value->value.object = object;
+
+  return JSON_ERROR_NONE;
+
+fail:
+  --decoder->depth;
+  json_object_dispose_ext (decoder->allocator, &object);
+  return error;
+}
+
+static json_error
+json_msgpack_decode_value (json_decoder *decoder, json_value *value,
+                           buffer *buf)
+{
+  const ju8 *p = json_bin_take (buf, 1);
+  json_error error;
+  jusize len;
+  ju8 tag;
+
+  if (!p)
+    return JSON_ERROR_EOF;
+
+  tag = p[0];
+
+  if (tag <= 0x7F || tag >= 0xE0)
+    {
+      value->type         = JSON_VALUE_TYPE_NUMBER;
+      value->value.number = (j8) tag;
+      return JSON_ERROR_NONE;
+    }
+
+  if (tag <= 0x8F)
+    return json_msgpack_decode_object (decoder, value, buf, tag & 0x0F);
+
+  if (tag <= 0x9F)
+    return json_msgpack_decode_array (decoder, value, buf, tag & 0x0F);
+
+  if (tag <= 0xBF)
+    {
+      len = tag & 0x1F;
+      goto decode_str;
+    }
+
+  switch (tag)
+    {
+    case 0xC0:
+      value->type = JSON_VALUE_TYPE_NULL;
+      return JSON_ERROR_NONE;
+    case 0xC2:
+    case 0xC3:
+      value->type       = JSON_VALUE_TYPE_BOOL;
+      value->value.bool = tag == 0xC3;
+      return JSON_ERROR_NONE;
+    case 0xCA:
+      {
+        union
+        {
+          float f;
+          ju32 u;
+        } bits;
+
+        if (!(p = json_bin_take (buf, 4)))
+          return JSON_ERROR_EOF;
+
+        bits.u              = json_load_be32 (p);
+        value->type         = JSON_VALUE_TYPE_NUMBER;
+        value->value.number = bits.f;
+        return JSON_ERROR_NONE;
+      }
+    case 0xCB:
+      {
+        union
+        {
+          json_number n;
+          ju64 u;
+        } bits;
+
+        if (!(p = json_bin_take (buf, 8)))
+          return JSON_ERROR_EOF;
+
+        bits.u              = json_load_be64 (p);
+        value->type         = JSON_VALUE_TYPE_NUMBER;
+        value->value.number = bits.n;
+        return JSON_ERROR_NONE;
+      }
+    case 0xCC:
+    case 0xCD:
+    case 0xCE:
+    case 0xCF:
+    case 0xD0:
+    case 0xD1:
+    case 0xD2:
+    case 0xD3:
+      {
+        jusize width = (jusize) 1 << (tag & 0x03);
+        ju64 v;
+
+        if (!(p = json_bin_take (buf, width)))
+          return JSON_ERROR_EOF;
+
+        switch (width)
+          {
+          case 1:
+            v = p[0];
+            break;
+          case 2:
+            v = json_load_be16 (p);
+            break;
+          case 4:
+            v = json_load_be32 (p);
+            break;
+          default:
+            v = json_load_be64 (p);
+            break;
+          }
+
+        value->type = JSON_VALUE_TYPE_NUMBER;
+
+        if (tag <= 0xCF)
+          value->value.number = (json_number) v;
+        else
+          {
+            // sign extend from the width of the encoding
+            jusize shift        = 64 - width * 8;
+            value->value.number = (json_number) ((j64) (v << shift) >> shift);
+          }
+
+        return JSON_ERROR_NONE;
+      }
+    case 0xD9:
+    case 0xDA:
+    case 0xDB:
+      if ((error = json_msgpack_take_len (buf, 1u << (tag - 0xD9), &len))
+          != JSON_ERROR_NONE)
+        return error;
+      goto decode_str;
+    case 0xDC:
+    case 0xDD:
+      if ((error = json_msgpack_take_len (buf, tag == 0xDC ? 2 : 4, &len))
+          != JSON_ERROR_NONE)
+        return error;
+      return json_msgpack_decode_array (decoder, value, buf, len);
+    case 0xDE:
+    case 0xDF:
+      if ((error = json_msgpack_take_len (buf, tag == 0xDE ? 2 : 4, &len))
+          != JSON_ERROR_NONE)
+        return error;
+      return json_msgpack_decode_object (decoder, value, buf, len);
+    default:
+      // bin and ext types have no JSON equivalent
+      return JSON_ERROR_DECODING;
+    }
+
+decode_str:
+  if ((error = json_msgpack_decode_str (decoder, &value->value.string, buf,
+                                        len))
+      != JSON_ERROR_NONE)
+    return error;
+
+  value->type = JSON_VALUE_TYPE_STRING;
+  return JSON_ERROR_NONE;
+}
+
+json_value *
+json_msgpack_decode (const json_decoder_opts *decoder_opts, const char *_buf,
+                     size_t size, json_decode_error *decode_error)
+{
+  json_decoder decoder;
+  json_decoder_init (&decoder, decoder_opts);
+
+  buffer buf = { .data = _buf, .size = size, .row = 0, .col = 0 };
+
+  json_error error;
+  json_value value;
+  json_value *value_a;
+
+  if ((error = json_msgpack_decode_value (&decoder, &value, &buf))
+      != JSON_ERROR_NONE)
+    {
+      EMIT_DECODE_ERROR (error, buf.row, buf.col);
+      return NULL;
+    }
+
+  if (buf.size)
+    {
+      json_value_dispose_ext (decoder.allocator, &value);
+      EMIT_DECODE_ERROR (JSON_ERROR_TRAILING_DATA, buf.row, buf.col);
+      return NULL;
+    }
+
+  if (!(value_a = decoder.allocator->json_malloc (sizeof (json_value),
+                                                  decoder.allocator->ctx)))
+    {
+      json_value_dispose_ext (decoder.allocator, &value);
+      EMIT_DECODE_ERROR (JSON_ERROR_NOMEM, buf.row, buf.col);
+      return NULL;
+    }
+
+  *value_a = value;
+
+  return value_a;
+}
@@ -20,10 +20,24 @@
  * IN THE SOFTWARE.
  */
 
-#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
 
 #include "_internal.h"
 
+// significant digits that fit in a ju64 without overflowing
+#define JSON_NUMBER_MANT_DIGITS 19
+
+// significant digits kept by the slow path; enough to round any double
+#ifndef JSON_NUMBER_MAX_DIGITS
+#define JSON_NUMBER_MAX_DIGITS 800
+#endif
+
+// exponents saturate here; anything larger is already zero or infinity
+#define JSON_NUMBER_MAX_EXP 100000
+
+#define JSON_NUMBER_MAX_EXACT (1ull << 53)
+
 static inline json_error
 json_decode_octal (json_value *value, buffer *buf, char ch, json_bool is_neg)
 {
@@ -44,6 +58,8 @@ read_octal:
   if (!buf->size)
     goto end_number;
 
+  ch = buf->data[0];
+
   if (is_digit (ch))
     goto read_octal;
 
@@ -54,21 +70,6 @@ end_number:
   return JSON_ERROR_NONE;
 }
 
-static inline int
-get_hex_digit (char ch)
-{
-  if (ch >= 0x30 && ch <= 0x39)
-    return ch - 0x30;
-
-  if (ch >= 0x41 && ch <= 0x46)
-    return (ch - 0x41) + 10;
-
-  if (ch >= 0x61 && ch <= 0x66)
-    return (ch - 0x61) + 10;
-
-  return -1;
-}
-
 static inline json_error
 json_decode_hex (json_value *value, buffer *buf, char ch, json_bool is_neg)
 {
@@ -111,14 +112,123 @@ end_number:
   return JSON_ERROR_NONE;
 }
 
-json_error
-json_decode_number (json_decoder *decoder, json_value *value, buffer *buf,
-                    char ch)
+/**
+ * Slow path for numbers whose digits do not fit the exact fast path. The
+ * digits are gathered without the decimal point so strtod does not depend on
+ * the locale's radix character.
+ */
+
+static json_number
+json_number_from_text (const char *text, const char *end)
 {
-  ju8 is_neg = 0, num_has_frac = 0, num_has_exp = 0, is_exp_neg = 0;
-  ju64 num_int = 0, num_frac = 0;
-  j32 num_exp         = 0;
-  ju32 num_int_digits = 0, num_frac_digits = 0;
+  char tmp[JSON_NUMBER_MAX_DIGITS + 32];
+  jusize len = 0, num_digits = 0;
+  j64 exp10 = 0, num_exp = 0;
+  json_bool in_frac = 0, truncated = 0, is_exp_neg = 0;
+
+  if (*text == 0x2D)
+    tmp[len++] = *text++;
+
+  for (; text < end && (is_digit (*text) || *text == 0x2E); ++text)
+    {
+      if (*text == 0x2E)
+        {
+          in_frac = 1;
+          continue;
+        }
+
+      if (num_digits == JSON_NUMBER_MAX_DIGITS)
+        {
+          exp10 += !in_frac;
+          truncated |= *text != 0x30;
+          continue;
+        }
+
+      exp10 -= in_frac;
+
+      if (!num_digits && *text == 0x30)
+        continue;
+
+      tmp[len++] = *text;
+      ++num_digits;
+    }
+
+  if (!num_digits)
+    tmp[len++] = 0x30;
+
+  // a sticky digit keeps the rounding direction of the dropped digits
+  if (truncated)
+    {
+      tmp[len++] = 0x31;
+      --exp10;
+    }
+
+  if (text < end)
+    {
+      ++text;
+
+      if (*text == 0x2B || *text == 0x2D)
+        is_exp_neg = *text++ == 0x2D;
+
+      for (; text < end; ++text)
+        if (num_exp < JSON_NUMBER_MAX_EXP)
+          num_exp = num_exp * 10 + (*text - 0x30);
+    }
+
+  exp10 += is_exp_neg ? -num_exp : num_exp;
+
+  if (exp10 > JSON_NUMBER_MAX_EXP)
+    exp10 = JSON_NUMBER_MAX_EXP;
+  else if (exp10 < -JSON_NUMBER_MAX_EXP)
+    exp10 = -JSON_NUMBER_MAX_EXP;
+
+  snprintf (tmp + len, sizeof (tmp) - len, "e%ld", (long) exp10);
+
+  return strtod (tmp, NULL);
+}
+
+/**
+ * Skips a run of digits with the position in locals, for digits that only
+ * the conversion would need.
+ */
+
+static inline void
+json_skip_digits (buffer *buf)
+{
+  const char *p = buf->data, *end = buf->data + buf->size;
+  jusize n;
+
+  while (p < end && is_digit (*p))
+    ++p;
+
+  n = (jusize) (p - buf->data);
+
+  buf->data = p;
+  buf->size -= n;
+  buf->col += n;
+}
+
+/**
+ * With lazy set, the digits are still validated but the value keeps only its
+ * text, and the conversion below compiles out.
+ */
+
+static JSON_ALWAYS_INLINE json_error
+json_decode_number_impl (json_decoder *decoder, json_value *value,
+                         buffer *buf, char ch, json_bool strict,
+                         json_bool lazy)
+{
+  static const json_number pow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+  };
+
+  const char *start = buf->data;
+  ju8 is_neg = 0, is_exp_neg = 0, truncated = 0, trailing = 0;
+  ju64 mant = 0;
+  j64 exp10       = 0;
+  j32 num_exp     = 0;
+  ju32 num_digits = 0, num_int_digits = 0;
   json_number number;
 
   if (ch == 0x2D)
@@ -139,19 +249,31 @@ json_decode_number (json_decoder *decoder, json_value *value, buffer *buf,
 read_int:
   ++num_int_digits;
 
-  if (num_int_digits == 2 && !num_int)
+  if (num_int_digits == 2 && !mant)
     {
-      if (decoder->ext_flags & JSON_EXT_OCTAL_LITERALS)
+      if (!strict && (decoder->ext_flags & JSON_EXT_OCTAL_LITERALS))
         return json_decode_octal (value, buf, ch, is_neg);
 
       return JSON_ERROR_LEADING_ZERO;
     }
 
-  num_int *= 10;
-  num_int += ch - 0x30;
+  if (num_digits < JSON_NUMBER_MANT_DIGITS)
+    {
+      mant = mant * 10 + (ch - 0x30);
+      num_digits += mant != 0;
+    }
+  else
+    {
+      ++exp10;
+      truncated |= ch != 0x30;
+    }
 
   BUF_ADVANCE_COL (buf);
 
+  // past a nonzero first digit, only the conversion reads the digits
+  if (lazy && mant)
+    json_skip_digits (buf);
+
   if (!buf->size)
     goto end_number;
 
@@ -162,7 +284,8 @@ read_int:
 
   if (ch != 0x2E)
     {
-      if (num_int_digits == 1 && num_int == 0 && (ch == 0x58 || ch == 0x78)
+      if (!strict && num_int_digits == 1 && mant == 0
+          && (ch == 0x58 || ch == 0x78)
           && (decoder->ext_flags & JSON_EXT_HEX_LITERALS))
         return json_decode_hex (value, buf, ch, is_neg);
 
@@ -173,8 +296,11 @@ read_int:
 
   if (!buf->size)
     {
-      if (decoder->ext_flags & JSON_EXT_TRAILING_DECIMAL)
-        goto end_number;
+      if (!strict && (decoder->ext_flags & JSON_EXT_TRAILING_DECIMAL))
+        {
+          trailing = 1;
+          goto end_number;
+        }
 
       return JSON_ERROR_BAD_FRAC;
     }
@@ -183,22 +309,30 @@ read_int:
 
   if (!is_digit (ch))
     {
-      if (decoder->ext_flags & JSON_EXT_TRAILING_DECIMAL)
-        goto end_number;
+      if (!strict && (decoder->ext_flags & JSON_EXT_TRAILING_DECIMAL))
+        {
+          trailing = 1;
+          goto end_number;
+        }
 
       return JSON_ERROR_BAD_FRAC;
     }
 
-  num_has_frac = 1;
-
 read_frac:
-  ++num_frac_digits;
-
-  num_frac *= 10;
-  num_frac += ch - 0x30;
+  if (num_digits < JSON_NUMBER_MANT_DIGITS)
+    {
+      mant = mant * 10 + (ch - 0x30);
+      num_digits += mant != 0;
+      --exp10;
+    }
+  else
+    truncated |= ch != 0x30;
 
   BUF_ADVANCE_COL (buf);
 
+  if (lazy)
+    json_skip_digits (buf);
+
   if (!buf->size)
     goto end_number;
 
@@ -233,14 +367,15 @@ check_exp:
   if (!is_digit (ch))
     return JSON_ERROR_BAD_EXP;
 
-  num_has_exp = 1;
-
 read_exp:
-  num_exp *= 10;
-  num_exp += ch - 0x30;
+  if (num_exp < JSON_NUMBER_MAX_EXP)
+    num_exp = num_exp * 10 + (ch - 0x30);
 
   BUF_ADVANCE_COL (buf);
 
+  if (lazy)
+    json_skip_digits (buf);
+
   if (!buf->size)
     goto end_number;
 
@@ -250,20 +385,79 @@ read_exp:
     goto read_exp;
 
 end_number:
-  // FIXME: handle precision and underflow/overflow issues!!!
-  number = (double) num_int;
+  // a trailing decimal point is not valid JSON to keep as text, so it is
+  // converted here like hex and octal literals are
+  if (lazy && !trailing && (jusize) (buf->data - start) <= (ju32) -1)
+    {
+      value->type             = JSON_VALUE_TYPE_RAW_NUMBER;
+      value->value.raw.number = 0;
+      value->value.raw.text   = start;
+      value->value.raw.len    = (ju32) (buf->data - start);
+      value->value.raw.ready  = JSON_FALSE;
+      return JSON_ERROR_NONE;
+    }
 
-  if (num_has_frac)
-    number += (double) num_frac / pow (10.0, num_frac_digits);
+  exp10 += is_exp_neg ? -num_exp : num_exp;
 
-  if (num_has_exp)
-    number *= pow (10.0, (double) (is_exp_neg ? -num_exp : num_exp));
+  // both operands are exact below 2^53 and 10^22, so a single multiply or
+  // divide is correctly rounded; lazy decoding skipped digits, so mant is
+  // only complete without it
+  if (!lazy && !truncated && mant <= JSON_NUMBER_MAX_EXACT
+      && (!mant || (exp10 >= -22 && exp10 <= 22)))
+    {
+      number = (json_number) mant;
+
+      if (mant)
+        number = exp10 < 0 ? number / pow10[-exp10] : number * pow10[exp10];
 
-  if (is_neg)
-    number = -number;
+      if (is_neg)
+        number = -number;
+    }
+  else
+    number = json_number_from_text (start, buf->data);
 
   value->type         = JSON_VALUE_TYPE_NUMBER;
   value->value.number = number;
 
   return JSON_ERROR_NONE;
 }
+
+json_error
+json_decode_number (json_decoder *decoder, json_value *value, buffer *buf,
+                    char ch)
+{
+  if (decoder->lazy_numbers)
+    return json_decode_number_impl (decoder, value, buf, ch, JSON_FALSE,
+                                    JSON_TRUE);
+
+  return json_decode_number_impl (decoder, value, buf, ch, JSON_FALSE,
+                                  JSON_FALSE);
+}
+
+json_error
+json_decode_number_strict (json_decoder *decoder, json_value *value,
+                           buffer *buf, char ch)
+{
+  if (decoder->lazy_numbers)
+    return json_decode_number_impl (decoder, value, buf, ch, JSON_TRUE,
+                                    JSON_TRUE);
+
+  return json_decode_number_impl (decoder, value, buf, ch, JSON_TRUE,
+                                  JSON_FALSE);
+}
+
+json_number
+json_number_parse (const char *text, jusize len)
+{
+  json_decoder decoder = { .ext_flags = JSON_EXT_TRAILING_DECIMAL };
+  buffer buf           = { .data = text, .size = len, .row = 1, .col = 1 };
+  json_value value      = { 0 };
+
+  if (!len
+      || json_decode_number_impl (&decoder, &value, &buf, text[0], JSON_FALSE,
+                                  JSON_FALSE)
+             != JSON_ERROR_NONE)
+    return 0;
+
+  return value.value.number;
+}
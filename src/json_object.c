@@ -20,4 +20,621 @@
  * IN THE SOFTWARE.
  */
 
+#include <string.h>
+
 #include "_internal.h"
+#include "json_types.h"
+
+#ifndef JSON_OBJECT_INIT_CAP
+#define JSON_OBJECT_INIT_CAP 4
+#endif
+
+#ifndef JSON_OBJECT_GROWTH_FACTOR
+#define JSON_OBJECT_GROWTH_FACTOR 2
+#endif
+
+/**
+ * Block-owned objects are exactly full, so their index follows size entries.
+ */
+
+static inline jusize
+json_object_slots (json_object *object)
+{
+  return object->cap ? object->cap : object->size;
+}
+
+static inline ju32 *
+json_object_index (json_object *object)
+{
+  return (ju32 *) (object->entries + json_object_slots (object));
+}
+
+static void
+json_object_index_insert (ju32 *index, jusize index_cap, ju32 hash, jusize i)
+{
+  jusize slot = hash & (index_cap - 1);
+
+  while (index[slot])
+    slot = (slot + 1) & (index_cap - 1);
+
+  // slots store the entry position plus one so that zero marks an empty slot
+  index[slot] = (ju32) (i + 1);
+}
+
+void
+json_object_reindex (json_object *object)
+{
+  jusize index_cap = json_object_index_cap (json_object_slots (object));
+  ju32 *index      = json_object_index (object);
+
+  if (!index_cap)
+    return;
+
+  memset (index, 0, index_cap * sizeof (ju32));
+
+  for (jusize i = 0; i < object->size; ++i)
+    json_object_index_insert (index, index_cap, object->entries[i].hash, i);
+}
+
+jusize
+json_object_find (json_object *object, const char *key, jusize key_len,
+                  ju32 hash)
+{
+  jusize index_cap = json_object_index_cap (json_object_slots (object));
+  json_entry *entry;
+
+  if (!index_cap)
+    {
+      for (jusize i = 0; i < object->size; ++i)
+        {
+          entry = object->entries + i;
+
+          if (entry->hash == hash && entry->key_len == key_len
+              && memcmp (entry->key, key, key_len) == 0)
+            return i;
+        }
+
+      return object->size;
+    }
+
+  ju32 *index = json_object_index (object);
+  jusize slot = hash & (index_cap - 1);
+
+  while (index[slot])
+    {
+      entry = object->entries + (index[slot] - 1);
+
+      if (entry->hash == hash && entry->key_len == key_len
+          && memcmp (entry->key, key, key_len) == 0)
+        return index[slot] - 1;
+
+      slot = (slot + 1) & (index_cap - 1);
+    }
+
+  return object->size;
+}
+
+json_error
+json_object_reserve_ext (json_allocator *allocator, json_object *object,
+                         jusize size)
+{
+  jusize cap = object->cap;
+  json_entry *entries;
+
+  if (cap >= size)
+    return JSON_ERROR_NONE;
+
+  if (!cap)
+    cap = JSON_OBJECT_INIT_CAP;
+
+  while (cap < size)
+    cap *= JSON_OBJECT_GROWTH_FACTOR;
+
+  if (cap > (ju32) -1)
+    return JSON_ERROR_NOMEM;
+
+  jusize size_bytes
+      = cap * sizeof (json_entry) + json_object_index_cap (cap) * sizeof (ju32);
+
+  if (!json_is_block_owned (object->entries, object->cap))
+    entries = allocator->json_realloc (object->entries, size_bytes,
+                                       allocator->ctx);
+  else if ((entries = allocator->json_malloc (size_bytes, allocator->ctx)))
+    {
+      // keys are copied out of the block too, so they can be freed on removal
+      for (jusize i = 0; i < object->size; ++i)
+        {
+          json_entry *entry = object->entries + i;
+          char *key = allocator->json_malloc (entry->key_len + 1,
+                                              allocator->ctx);
+
+          if (!key)
+            {
+              while (i--)
+                allocator->json_free (entries[i].key, allocator->ctx);
+
+              allocator->json_free (entries, allocator->ctx);
+              return JSON_ERROR_NOMEM;
+            }
+
+          memcpy (key, entry->key, entry->key_len + 1);
+
+          entries[i]     = *entry;
+          entries[i].key = key;
+        }
+    }
+
+  if (!entries)
+    return JSON_ERROR_NOMEM;
+
+  object->entries = entries;
+  object->cap     = cap;
+
+  json_object_reindex (object);
+
+  return JSON_ERROR_NONE;
+}
+
+json_error
+json_object_append_ext (json_allocator *allocator, json_object *object,
+                        char *key, jusize key_len, ju32 hash,
+                        json_value *value)
+{
+  json_error error;
+  json_entry *entry;
+
+  if ((error = json_object_reserve_ext (allocator, object, object->size + 1))
+      != JSON_ERROR_NONE)
+    return error;
+
+  entry          = object->entries + object->size;
+  entry->key     = key;
+  entry->key_len = key_len;
+  entry->hash    = hash;
+  entry->value   = *value;
+
+  if (object->cap >= JSON_OBJECT_INDEX_MIN_CAP)
+    json_object_index_insert (json_object_index (object),
+                              json_object_index_cap (object->cap), hash,
+                              object->size);
+
+  ++object->size;
+
+  return JSON_ERROR_NONE;
+}
+
+json_value *
+json_object_get (json_object *object, const char *key)
+{
+  jusize key_len = strlen (key);
+  jusize i
+      = json_object_find (object, key, key_len, json_hash_key (key, key_len));
+
+  if (i == object->size)
+    return NULL;
+
+  return &object->entries[i].value;
+}
+
+json_key
+json_key_make (const char *key)
+{
+  json_key handle = { .key = key, .len = strlen (key) };
+
+  handle.hash = json_hash_key (key, handle.len);
+
+  return handle;
+}
+
+// a racing lookup may store another position, which is still a valid hint
+#if defined(__GNUC__)
+#define JSON_SLOT_LOAD(P)     __atomic_load_n (&(P), __ATOMIC_RELAXED)
+#define JSON_SLOT_STORE(P, V) __atomic_store_n (&(P), (V), __ATOMIC_RELAXED)
+#else
+#define JSON_SLOT_LOAD(P)     (P)
+#define JSON_SLOT_STORE(P, V) ((P) = (V))
+#endif
+
+json_value *
+json_object_get_key (json_object *object, json_key *key)
+{
+  jusize i = JSON_SLOT_LOAD (key->slot);
+  json_entry *entry;
+
+  if (i < object->size)
+    {
+      entry = object->entries + i;
+
+      if (entry->hash == key->hash && entry->key_len == key->len
+          && memcmp (entry->key, key->key, key->len) == 0)
+        return &entry->value;
+    }
+
+  if ((i = json_object_find (object, key->key, key->len, key->hash))
+      == object->size)
+    return NULL;
+
+  JSON_SLOT_STORE (key->slot, (ju32) i);
+
+  return &object->entries[i].value;
+}
+
+json_error
+json_object_remove_at_ext (json_allocator *allocator, json_object *object,
+                           jusize i, json_value *out_value, char **out_key)
+{
+  json_entry *entry;
+  json_error error;
+
+  if (json_is_block_owned (object->entries, object->cap)
+      && (error = json_object_reserve_ext (allocator, object, object->size))
+             != JSON_ERROR_NONE)
+    return error;
+
+  entry      = object->entries + i;
+  *out_value = entry->value;
+  *out_key   = entry->key;
+
+  memmove (entry, entry + 1, (object->size - i - 1) * sizeof (json_entry));
+  --object->size;
+
+  json_object_reindex (object);
+
+  return JSON_ERROR_NONE;
+}
+
+json_error
+json_object_insert_ext (json_allocator *allocator, json_object *object,
+                        jusize i, char *key, jusize key_len, ju32 hash,
+                        json_value *value)
+{
+  json_error error;
+  json_entry entry;
+
+  if ((error = json_object_append_ext (allocator, object, key, key_len, hash,
+                                       value))
+      != JSON_ERROR_NONE)
+    return error;
+
+  entry = object->entries[object->size - 1];
+
+  memmove (object->entries + i + 1, object->entries + i,
+           (object->size - 1 - i) * sizeof (json_entry));
+  object->entries[i] = entry;
+
+  json_object_reindex (object);
+
+  return JSON_ERROR_NONE;
+}
+
+json_bool
+json_object_remove_ext (json_allocator *allocator, json_object *object,
+                        const char *key, json_value **removed_value)
+{
+  jusize key_len = strlen (key);
+  jusize i
+      = json_object_find (object, key, key_len, json_hash_key (key, key_len));
+  json_value *tmp = NULL, value;
+  char *entry_key;
+
+  if (i == object->size)
+    return JSON_FALSE;
+
+  if (removed_value
+      && !(tmp = allocator->json_malloc (sizeof (json_value), allocator->ctx)))
+    {
+      *removed_value = NULL;
+      return JSON_FALSE;
+    }
+
+  if (json_object_remove_at_ext (allocator, object, i, &value, &entry_key)
+      != JSON_ERROR_NONE)
+    {
+      allocator->json_free (tmp, allocator->ctx);
+      return JSON_FALSE;
+    }
+
+  allocator->json_free (entry_key, allocator->ctx);
+
+  if (removed_value)
+    {
+      *tmp           = value;
+      *removed_value = tmp;
+    }
+  else
+    json_value_dispose_ext (allocator, &value);
+
+  return JSON_TRUE;
+}
+
+json_bool
+json_object_remove (json_object *object, const char *key)
+{
+  return json_object_remove_ext (&std_allocator, object, key, NULL);
+}
+
+json_error
+json_object_put_ext (json_allocator *allocator, json_object *object,
+                     char *key, json_value *value, json_bool copy_key,
+                     json_value **old_value)
+{
+  jusize key_len = strlen (key);
+  ju32 hash      = json_hash_key (key, key_len);
+  jusize i       = json_object_find (object, key, key_len, hash);
+  json_error error;
+
+  if (i < object->size)
+    {
+      json_entry *entry = object->entries + i;
+
+      if (old_value)
+        {
+          json_value *tmp
+              = allocator->json_malloc (sizeof (json_value), allocator->ctx);
+
+          if (!tmp)
+            return JSON_ERROR_NOMEM;
+
+          *tmp       = entry->value;
+          *old_value = tmp;
+        }
+      else
+        json_value_dispose_ext (allocator, &entry->value);
+
+      entry->value = *value;
+
+      if (!copy_key)
+        allocator->json_free (key, allocator->ctx);
+
+      return JSON_ERROR_NONE;
+    }
+
+  if (old_value)
+    *old_value = NULL;
+
+  if (copy_key)
+    {
+      char *tmp = allocator->json_malloc (key_len + 1, allocator->ctx);
+
+      if (!tmp)
+        return JSON_ERROR_NOMEM;
+
+      memcpy (tmp, key, key_len + 1);
+      key = tmp;
+    }
+
+  if ((error = json_object_append_ext (allocator, object, key, key_len, hash,
+                                       value))
+      != JSON_ERROR_NONE)
+    {
+      if (copy_key)
+        allocator->json_free (key, allocator->ctx);
+
+      return error;
+    }
+
+  return JSON_ERROR_NONE;
+}
+
+json_error
+json_object_put (json_object *object, const char *key, json_value *value)
+{
+  return json_object_put_ext (&std_allocator, object, (char *) key, value,
+                              JSON_TRUE, NULL);
+}
+
+void
+json_object_dispose_ext (json_allocator *allocator, json_object *object)
+{
+  json_bool block = json_is_block_owned (object->entries, object->cap);
+
+  for (jusize i = 0; i < object->size; ++i)
+    {
+      if (!block)
+        allocator->json_free (object->entries[i].key, allocator->ctx);
+
+      json_value_dispose_ext (allocator, &object->entries[i].value);
+    }
+
+  json_storage_free (allocator, object->entries, object->cap);
+  memset (object, 0, sizeof (json_object));
+}
+
+static JSON_ALWAYS_INLINE json_error
+json_decode_object_impl (json_decoder *decoder, json_value *value,
+                         buffer *buf, json_bool strict, json_bool validate)
+{
+  json_object object = { 0 };
+  json_value tmpval;
+  json_error error;
+
+  BUF_ADVANCE_COL (buf);
+
+  JSON_CONSUME_WHITESPACE (strict, decoder, buf);
+
+  if (!buf->size)
+    return JSON_ERROR_UNCLOSED_OBJ;
+
+  if (buf->data[0] == 0x7D)
+    {
+      BUF_ADVANCE_COL (buf);
+      goto end_object;
+    }
+
+  while (1)
+    {
+      json_string key;
+      jusize i;
+      ju32 hash;
+
+      if (!buf->size)
+        {
+          error = JSON_ERROR_UNCLOSED_OBJ;
+          goto fail;
+        }
+
+      if (buf->data[0] != 0x22)
+        {
+          error = JSON_ERROR_BAD_KEY;
+          goto fail;
+        }
+
+      JSON_PROFILE_ENTER (decoder, JSON_DECODE_PHASE_STRING, buf->data);
+      error = validate ? json_scan_string (decoder, buf)
+                       : json_decode_string (decoder, &tmpval, buf);
+      JSON_PROFILE_LEAVE (decoder, buf->data);
+
+      if (error != JSON_ERROR_NONE)
+        goto fail;
+
+      // nothing is kept to find duplicate keys in
+      if (validate)
+        goto colon;
+
+      key = tmpval.value.string;
+
+      // the empty key is never allocated by the string decoder
+      if (!key.str
+          && (key.str = decoder->allocator->json_malloc (
+                  1, decoder->allocator->ctx)))
+        key.str[0] = '\0';
+
+      if (!key.str)
+        {
+          error = JSON_ERROR_NOMEM;
+          goto fail;
+        }
+
+      hash = json_hash_key (key.str, key.len);
+      i    = json_object_find (&object, key.str, key.len, hash);
+
+      if (i < object.size && !(decoder->ext_flags & JSON_EXT_ALLOW_DUP_KEYS))
+        {
+          error = JSON_ERROR_DUP_KEY;
+          goto fail_key;
+        }
+
+    colon:
+      JSON_CONSUME_WHITESPACE (strict, decoder, buf);
+
+      if (!buf->size)
+        {
+          error = JSON_ERROR_UNCLOSED_OBJ;
+          goto fail_key;
+        }
+
+      if (buf->data[0] != 0x3A)
+        {
+          error = JSON_ERROR_BAD_MEMBER;
+          goto fail_key;
+        }
+
+      BUF_ADVANCE_COL (buf);
+      JSON_CONSUME_WHITESPACE (strict, decoder, buf);
+
+      error = json_decode_value_variant (decoder, &tmpval, buf, strict,
+                                         validate);
+
+      if (error != JSON_ERROR_NONE)
+        {
+          if (error == JSON_ERROR_EOF)
+            error = JSON_ERROR_UNCLOSED_OBJ;
+
+          goto fail_key;
+        }
+
+      if (validate)
+        goto next;
+
+      tmpval.start -= value->start;
+
+      if (i < object.size)
+        {
+          // the last duplicate wins but keeps the position of the first
+          json_value_dispose_ext (decoder->allocator,
+                                  &object.entries[i].value);
+          object.entries[i].value = tmpval;
+          decoder->allocator->json_free (key.str, decoder->allocator->ctx);
+        }
+      else if ((error = json_object_append_ext (decoder->allocator, &object,
+                                                key.str, key.len, hash,
+                                                &tmpval))
+               != JSON_ERROR_NONE)
+        {
+          json_value_dispose_ext (decoder->allocator, &tmpval);
+          goto fail_key;
+        }
+
+    next:
+      JSON_CONSUME_WHITESPACE (strict, decoder, buf);
+
+      if (!buf->size)
+        {
+          error = JSON_ERROR_UNCLOSED_OBJ;
+          goto fail;
+        }
+
+      if (buf->data[0] == 0x2C)
+        {
+          BUF_ADVANCE_COL (buf);
+          JSON_CONSUME_WHITESPACE (strict, decoder, buf);
+        }
+      else if (buf->data[0] == 0x7D)
+        {
+          BUF_ADVANCE_COL (buf);
+          goto end_object;
+        }
+      else
+        {
+          error = JSON_ERROR_BAD_OBJECT;
+          goto fail;
+        }
+
+      continue;
+
+    fail_key:
+      if (!validate)
+        decoder->allocator->json_free (key.str, decoder->allocator->ctx);
+
+      goto fail;
+    }
+
+end_object:
+  value->type         = JSON_VALUE_TYPE_OBJECT;
+  value->value.object = object;
+
+  return JSON_ERROR_NONE;
+
+fail:
+  if (!validate)
+    json_object_dispose_ext (decoder->allocator, &object);
+
+  return error;
+}
+
+json_error
+json_decode_object (json_decoder *decoder, json_value *value, buffer *buf)
+{
+  return json_decode_object_impl (decoder, value, buf, JSON_FALSE,
+                                  JSON_FALSE);
+}
+
+json_error
+json_decode_object_strict (json_decoder *decoder, json_value *value,
+                           buffer *buf)
+{
+  return json_decode_object_impl (decoder, value, buf, JSON_TRUE, JSON_FALSE);
+}
+
+json_error
+json_validate_object (json_decoder *decoder, json_value *value, buffer *buf)
+{
+  return json_decode_object_impl (decoder, value, buf, JSON_FALSE, JSON_TRUE);
+}
+
+json_error
+json_validate_object_strict (json_decoder *decoder, json_value *value,
+                             buffer *buf)
+{
+  return json_decode_object_impl (decoder, value, buf, JSON_TRUE, JSON_TRUE);
+}
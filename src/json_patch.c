@@ -0,0 +1,950 @@
+/*
+ * Copyright (c) 2025 Zachary Lamb
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "_internal.h"
+
+/**
+ * JSON Patch (RFC 6902) and JSON Merge Patch (RFC 7396).
+ *
+ * Every operation resolves its pointers once and mutates the document in
+ * place. In atomic mode each mutation first pushes an undo record holding a
+ * concrete path to the mutated location and whatever value or key it
+ * displaced. On failure the records are replayed in reverse, re-resolving
+ * their paths against the document as it was right after each mutation.
+ * Containers never shrink, displaced keys are kept and the pointer scratch
+ * buffer is reserved up front, so rolling back never allocates.
+ */
+
+typedef enum json_patch_undo_kind
+{
+  JSON_PATCH_UNDO_REMOVE,  // a value was added at path
+  JSON_PATCH_UNDO_RESTORE, // the value at path was replaced by another
+  JSON_PATCH_UNDO_INSERT,  // the value at path was removed
+} json_patch_undo_kind;
+
+typedef struct json_patch_undo
+{
+  ju8 kind;
+
+  // keep: the value displaced by the undo is moved into the carry register
+  // take: the value restored by the undo is taken from the carry register
+  json_bool keep, take;
+
+  char *path;
+  jusize path_len;
+
+  // position and key of a removed object member
+  jusize index;
+  char *key;
+  jusize key_len;
+  ju32 hash;
+
+  json_value value;
+} json_patch_undo;
+
+typedef struct json_patch_ref
+{
+  json_value *parent; // NULL for the root
+  json_value *target; // NULL if nothing is at the location yet
+
+  // the array index or the position of the member, if it exists
+  jusize index;
+
+  // the last reference token, unescaped, for object parents
+  const char *key;
+  jusize key_len;
+  ju32 hash;
+
+  // the pointer itself and the length of its parent's pointer
+  const char *path;
+  jusize path_len, prefix_len;
+} json_patch_ref;
+
+typedef struct json_patch_ctx
+{
+  json_allocator *allocator;
+  json_value *doc;
+  json_bool atomic;
+
+  char *scratch;
+  jusize scratch_cap;
+
+  // paths of merge patch members
+  char *path;
+  jusize path_len, path_cap;
+
+  json_patch_undo *log;
+  jusize log_size, log_cap;
+
+  json_value carry;
+} json_patch_ctx;
+
+static json_error
+json_patch_grow (json_allocator *allocator, char **buf, jusize *cap,
+                 jusize size)
+{
+  char *tmp;
+
+  if (*cap >= size)
+    return JSON_ERROR_NONE;
+
+  if (!(tmp = allocator->json_realloc (*buf, size, allocator->ctx)))
+    return JSON_ERROR_NOMEM;
+
+  *buf = tmp;
+  *cap = size;
+
+  return JSON_ERROR_NONE;
+}
+
+/**
+ * Parses an array index token: either "-" for the end of the array or a
+ * decimal number without leading zeros.
+ */
+
+static json_bool
+json_pointer_index (const char *token, jusize len, jusize size,
+                    jusize *out_index)
+{
+  jusize index = 0;
+
+  if (len == 1 && token[0] == 0x2D)
+    {
+      *out_index = size;
+      return JSON_TRUE;
+    }
+
+  if (!len || (token[0] == 0x30 && len > 1))
+    return JSON_FALSE;
+
+  for (jusize i = 0; i < len; ++i)
+    {
+      if (!is_digit (token[i]) || index > ((jusize) -1 - 9) / 10)
+        return JSON_FALSE;
+
+      index = index * 10 + (token[i] - 0x30);
+    }
+
+  *out_index = index;
+
+  return JSON_TRUE;
+}
+
+/**
+ * Resolves an RFC 6901 pointer to its location in doc. Every token but the
+ * last must exist. The last one may name a missing member or the end of an
+ * array.
+ */
+
+static json_error
+json_pointer_resolve (json_patch_ctx *ctx, const char *ptr, jusize len,
+                      json_patch_ref *ref)
+{
+  json_value *cur = ctx->doc;
+  json_error error;
+  jusize i = 0;
+
+  *ref = (json_patch_ref) {
+    .target = cur, .path = ptr, .path_len = len, .prefix_len = 0
+  };
+
+  if (!len)
+    return JSON_ERROR_NONE;
+
+  if (ptr[0] != 0x2F)
+    return JSON_ERROR_BAD_POINTER;
+
+  if ((error = json_patch_grow (ctx->allocator, &ctx->scratch,
+                                &ctx->scratch_cap, len))
+      != JSON_ERROR_NONE)
+    return error;
+
+  while (i < len)
+    {
+      jusize token_len = 0, start = i++;
+
+      for (; i < len && ptr[i] != 0x2F; ++i)
+        {
+          char ch = ptr[i];
+
+          if (ch == 0x7E)
+            {
+              if (++i == len || (ptr[i] != 0x30 && ptr[i] != 0x31))
+                return JSON_ERROR_BAD_POINTER;
+
+              ch = ptr[i] == 0x30 ? 0x7E : 0x2F;
+            }
+
+          ctx->scratch[token_len++] = ch;
+        }
+
+      if (!cur)
+        return JSON_ERROR_BAD_POINTER;
+
+      ref->parent     = cur;
+      ref->prefix_len = start;
+
+      switch (cur->type)
+        {
+        case JSON_VALUE_TYPE_OBJECT:
+          {
+            json_object *object = &cur->value.object;
+
+            ref->key     = ctx->scratch;
+            ref->key_len = token_len;
+            ref->hash    = json_hash_key (ctx->scratch, token_len);
+            ref->index
+                = json_object_find (object, ref->key, token_len, ref->hash);
+
+            cur = ref->index < object->size
+                      ? &object->entries[ref->index].value
+                      : NULL;
+            break;
+          }
+        case JSON_VALUE_TYPE_ARRAY:
+          {
+            json_array *array = &cur->value.array;
+
+            if (!json_pointer_index (ctx->scratch, token_len, array->size,
+                                     &ref->index)
+                || ref->index > array->size)
+              return JSON_ERROR_BAD_POINTER;
+
+            // the target may be edited or moved through its pointer
+            if ((error = json_array_unpack (ctx->allocator, array))
+                != JSON_ERROR_NONE)
+              return error;
+
+            cur = ref->index < array->size ? array->elements + ref->index
+                                           : NULL;
+            break;
+          }
+        default:
+          return JSON_ERROR_BAD_POINTER;
+        }
+    }
+
+  ref->target = cur;
+
+  return JSON_ERROR_NONE;
+}
+
+/**
+ * Pushes an undo record for a mutation of the location at ref, with a path
+ * that names array elements by their concrete index. In non-atomic mode no
+ * record is kept and out_undo is set to NULL.
+ */
+
+static json_error
+json_patch_log_push (json_patch_ctx *ctx, json_patch_ref *ref, ju8 kind,
+                     json_patch_undo **out_undo)
+{
+  json_allocator *allocator = ctx->allocator;
+  json_patch_undo *undo;
+  json_error error;
+  char digits[24];
+  jusize n_digits = 0, path_len = ref->path_len;
+  char *path;
+
+  *out_undo = NULL;
+
+  if (!ctx->atomic)
+    return JSON_ERROR_NONE;
+
+  if (ref->parent && ref->parent->type == JSON_VALUE_TYPE_ARRAY)
+    {
+      jusize index = ref->index;
+
+      do
+        digits[sizeof (digits) - ++n_digits] = (char) (0x30 + index % 10);
+      while (index /= 10);
+
+      path_len = ref->prefix_len + 1 + n_digits;
+    }
+
+  if ((error = json_patch_grow (allocator, &ctx->scratch, &ctx->scratch_cap,
+                                path_len))
+      != JSON_ERROR_NONE)
+    return error;
+
+  if (ctx->log_size == ctx->log_cap)
+    {
+      jusize cap = ctx->log_cap ? ctx->log_cap * 2 : 8;
+      json_patch_undo *log = allocator->json_realloc (
+          ctx->log, cap * sizeof (json_patch_undo), allocator->ctx);
+
+      if (!log)
+        return JSON_ERROR_NOMEM;
+
+      ctx->log     = log;
+      ctx->log_cap = cap;
+    }
+
+  if (!(path = allocator->json_malloc (path_len + 1, allocator->ctx)))
+    return JSON_ERROR_NOMEM;
+
+  if (n_digits)
+    {
+      memcpy (path, ref->path, ref->prefix_len);
+      path[ref->prefix_len] = 0x2F;
+      memcpy (path + ref->prefix_len + 1,
+              digits + sizeof (digits) - n_digits, n_digits);
+    }
+  else if (path_len)
+    memcpy (path, ref->path, path_len);
+
+  path[path_len] = '\0';
+
+  undo  = ctx->log + ctx->log_size++;
+  *undo = (json_patch_undo) {
+    .kind = kind, .path = path, .path_len = path_len
+  };
+
+  *out_undo = undo;
+
+  return JSON_ERROR_NONE;
+}
+
+static void
+json_patch_log_pop (json_patch_ctx *ctx, json_patch_undo *undo)
+{
+  if (!undo)
+    return;
+
+  ctx->allocator->json_free (undo->path, ctx->allocator->ctx);
+  --ctx->log_size;
+}
+
+/**
+ * Replaces the existing value at ref with value. With keep, the old value is
+ * moved to the carry register when the replacement is undone.
+ */
+
+static json_error
+json_patch_set (json_patch_ctx *ctx, json_patch_ref *ref, json_value *value,
+                json_bool keep)
+{
+  json_patch_undo *undo;
+  json_error error;
+
+  if ((error = json_patch_log_push (ctx, ref, JSON_PATCH_UNDO_RESTORE, &undo))
+      != JSON_ERROR_NONE)
+    return error;
+
+  if (undo)
+    {
+      undo->keep  = keep;
+      undo->value = *ref->target;
+    }
+  else
+    json_value_dispose_ext (ctx->allocator, ref->target);
+
+  *ref->target = *value;
+
+  return JSON_ERROR_NONE;
+}
+
+/**
+ * Adds value at ref, taking ownership of it only on success. Existing object
+ * members and the root are replaced.
+ */
+
+static json_error
+json_patch_add (json_patch_ctx *ctx, json_patch_ref *ref, json_value *value,
+                json_bool keep)
+{
+  json_allocator *allocator = ctx->allocator;
+  json_patch_undo *undo;
+  json_error error;
+  char *key;
+
+  if (!ref->parent
+      || (ref->parent->type == JSON_VALUE_TYPE_OBJECT && ref->target))
+    return json_patch_set (ctx, ref, value, keep);
+
+  if ((error = json_patch_log_push (ctx, ref, JSON_PATCH_UNDO_REMOVE, &undo))
+      != JSON_ERROR_NONE)
+    return error;
+
+  if (ref->parent->type == JSON_VALUE_TYPE_ARRAY)
+    error = json_array_insert_ext (allocator, &ref->parent->value.array,
+                                   ref->index, value);
+  else if (!(key = allocator->json_malloc (ref->key_len + 1, allocator->ctx)))
+    error = JSON_ERROR_NOMEM;
+  else
+    {
+      memcpy (key, ref->key, ref->key_len);
+      key[ref->key_len] = '\0';
+
+      if ((error = json_object_append_ext (allocator,
+                                           &ref->parent->value.object, key,
+                                           ref->key_len, ref->hash, value))
+          != JSON_ERROR_NONE)
+        allocator->json_free (key, allocator->ctx);
+    }
+
+  if (error != JSON_ERROR_NONE)
+    {
+      json_patch_log_pop (ctx, undo);
+      return error;
+    }
+
+  if (undo)
+    undo->keep = keep;
+
+  return JSON_ERROR_NONE;
+}
+
+/**
+ * Removes the existing value at ref. If out_value is not NULL the value is
+ * moved there and taken back from the carry register on undo.
+ */
+
+static json_error
+json_patch_remove (json_patch_ctx *ctx, json_patch_ref *ref,
+                   json_value *out_value)
+{
+  json_allocator *allocator = ctx->allocator;
+  json_patch_undo *undo;
+  json_error error;
+  json_value value;
+  char *key = NULL;
+
+  if (!ref->parent)
+    return JSON_ERROR_BAD_POINTER;
+
+  if ((error = json_patch_log_push (ctx, ref, JSON_PATCH_UNDO_INSERT, &undo))
+      != JSON_ERROR_NONE)
+    return error;
+
+  if (ref->parent->type == JSON_VALUE_TYPE_OBJECT)
+    error = json_object_remove_at_ext (allocator, &ref->parent->value.object,
+                                       ref->index, &value, &key);
+  else
+    {
+      json_array *array = &ref->parent->value.array;
+
+      // copy out of a clone block now, so the undo can reinsert in place
+      error = json_array_reserve_ext (allocator, array, array->size);
+
+      if (error == JSON_ERROR_NONE)
+        json_array_remove_at (array, ref->index, &value);
+    }
+
+  if (error != JSON_ERROR_NONE)
+    {
+      json_patch_log_pop (ctx, undo);
+      return error;
+    }
+
+  if (undo)
+    {
+      undo->index   = ref->index;
+      undo->key     = key;
+      undo->key_len = ref->key_len;
+      undo->hash    = ref->hash;
+      undo->take    = out_value != NULL;
+
+      if (!out_value)
+        undo->value = value;
+    }
+  else
+    {
+      allocator->json_free (key, allocator->ctx);
+
+      if (!out_value)
+        json_value_dispose_ext (allocator, &value);
+    }
+
+  if (out_value)
+    *out_value = value;
+
+  return JSON_ERROR_NONE;
+}
+
+/**
+ * Undoes every logged mutation, newest first.
+ */
+
+static void
+json_patch_rollback (json_patch_ctx *ctx)
+{
+  json_allocator *allocator = ctx->allocator;
+
+  while (ctx->log_size)
+    {
+      json_patch_undo *undo = ctx->log + --ctx->log_size;
+      json_value displaced, value;
+      json_patch_ref ref;
+      char *key;
+
+      // the scratch buffer was reserved for every logged path
+      json_pointer_resolve (ctx, undo->path, undo->path_len, &ref);
+
+      switch (undo->kind)
+        {
+        case JSON_PATCH_UNDO_REMOVE:
+          if (ref.parent->type == JSON_VALUE_TYPE_OBJECT)
+            {
+              json_object_remove_at_ext (allocator,
+                                         &ref.parent->value.object, ref.index,
+                                         &displaced, &key);
+              allocator->json_free (key, allocator->ctx);
+            }
+          else
+            json_array_remove_at (&ref.parent->value.array, ref.index,
+                                  &displaced);
+          break;
+        case JSON_PATCH_UNDO_RESTORE:
+          displaced    = *ref.target;
+          *ref.target = undo->value;
+          break;
+        case JSON_PATCH_UNDO_INSERT:
+          value = undo->take ? ctx->carry : undo->value;
+
+          // capacity left behind by the removal makes these infallible
+          if (ref.parent->type == JSON_VALUE_TYPE_OBJECT)
+            json_object_insert_ext (allocator, &ref.parent->value.object,
+                                    undo->index, undo->key, undo->key_len,
+                                    undo->hash, &value);
+          else
+            json_array_insert_ext (allocator, &ref.parent->value.array,
+                                   ref.index, &value);
+          break;
+        }
+
+      if (undo->kind != JSON_PATCH_UNDO_INSERT)
+        {
+          if (undo->keep)
+            ctx->carry = displaced;
+          else
+            json_value_dispose_ext (allocator, &displaced);
+        }
+
+      allocator->json_free (undo->path, allocator->ctx);
+    }
+}
+
+/**
+ * Releases the undo log after a successful patch, along with the values and
+ * keys it displaced.
+ */
+
+static void
+json_patch_commit (json_patch_ctx *ctx)
+{
+  json_allocator *allocator = ctx->allocator;
+
+  for (jusize i = 0; i < ctx->log_size; ++i)
+    {
+      json_patch_undo *undo = ctx->log + i;
+
+      if (undo->kind == JSON_PATCH_UNDO_INSERT)
+        allocator->json_free (undo->key, allocator->ctx);
+
+      if (undo->kind != JSON_PATCH_UNDO_REMOVE && !undo->take)
+        json_value_dispose_ext (allocator, &undo->value);
+
+      allocator->json_free (undo->path, allocator->ctx);
+    }
+
+  ctx->log_size = 0;
+}
+
+static void
+json_patch_ctx_dispose (json_patch_ctx *ctx)
+{
+  json_allocator *allocator = ctx->allocator;
+
+  allocator->json_free (ctx->scratch, allocator->ctx);
+  allocator->json_free (ctx->path, allocator->ctx);
+  allocator->json_free (ctx->log, allocator->ctx);
+}
+
+static json_bool
+json_patch_member (json_object *op, const char *key, json_value **out_value)
+{
+  return (*out_value = json_object_get (op, key)) != NULL;
+}
+
+static json_bool
+json_patch_member_string (json_object *op, const char *key,
+                          json_string **out_str)
+{
+  json_value *value;
+
+  return json_patch_member (op, key, &value)
+         && json_value_get_string (value, out_str);
+}
+
+static json_error
+json_patch_apply_op (json_patch_ctx *ctx, json_value *op_value)
+{
+  json_allocator *allocator = ctx->allocator;
+  json_string *op, *path, *from;
+  json_patch_ref ref, from_ref;
+  json_value *arg, value;
+  json_object *object;
+  json_error error;
+
+  if (!json_value_get_object (op_value, &object)
+      || !json_patch_member_string (object, "op", &op)
+      || !json_patch_member_string (object, "path", &path))
+    return JSON_ERROR_BAD_PATCH;
+
+#define JSON_PATCH_OP_IS(NAME)                                                \
+  (op->len == sizeof (NAME) - 1 && memcmp (op->str, NAME, op->len) == 0)
+
+  if (JSON_PATCH_OP_IS ("add") || JSON_PATCH_OP_IS ("replace")
+      || JSON_PATCH_OP_IS ("test"))
+    {
+      if (!json_patch_member (object, "value", &arg))
+        return JSON_ERROR_BAD_PATCH;
+
+      if ((error = json_pointer_resolve (ctx, path->str, path->len, &ref))
+          != JSON_ERROR_NONE)
+        return error;
+
+      if (JSON_PATCH_OP_IS ("test"))
+        return ref.target && json_value_equals (ref.target, arg)
+                   ? JSON_ERROR_NONE
+                   : JSON_ERROR_TEST_FAILED;
+
+      if (JSON_PATCH_OP_IS ("replace") && !ref.target)
+        return JSON_ERROR_BAD_POINTER;
+
+      if ((error = json_value_copy_ext (allocator, &value, arg))
+          != JSON_ERROR_NONE)
+        return error;
+
+      if (JSON_PATCH_OP_IS ("replace"))
+        error = json_patch_set (ctx, &ref, &value, JSON_FALSE);
+      else
+        error = json_patch_add (ctx, &ref, &value, JSON_FALSE);
+
+      if (error != JSON_ERROR_NONE)
+        json_value_dispose_ext (allocator, &value);
+
+      return error;
+    }
+
+  if (JSON_PATCH_OP_IS ("remove"))
+    {
+      if ((error = json_pointer_resolve (ctx, path->str, path->len, &ref))
+          != JSON_ERROR_NONE)
+        return error;
+
+      if (!ref.target)
+        return JSON_ERROR_BAD_POINTER;
+
+      return json_patch_remove (ctx, &ref, NULL);
+    }
+
+  if (JSON_PATCH_OP_IS ("move") || JSON_PATCH_OP_IS ("copy"))
+    {
+      if (!json_patch_member_string (object, "from", &from))
+        return JSON_ERROR_BAD_PATCH;
+
+      if ((error = json_pointer_resolve (ctx, from->str, from->len, &from_ref))
+          != JSON_ERROR_NONE)
+        return error;
+
+      if (!from_ref.target)
+        return JSON_ERROR_BAD_POINTER;
+
+      if (JSON_PATCH_OP_IS ("copy"))
+        {
+          if ((error = json_value_copy_ext (allocator, &value,
+                                            from_ref.target))
+              != JSON_ERROR_NONE)
+            return error;
+
+          if ((error = json_pointer_resolve (ctx, path->str, path->len, &ref))
+                  != JSON_ERROR_NONE
+              || (error = json_patch_add (ctx, &ref, &value, JSON_FALSE))
+                     != JSON_ERROR_NONE)
+            json_value_dispose_ext (allocator, &value);
+
+          return error;
+        }
+
+      if (from->len == path->len
+          && memcmp (from->str, path->str, from->len) == 0)
+        return JSON_ERROR_NONE;
+
+      // a value cannot be moved into one of its own children
+      if (from->len < path->len && path->str[from->len] == 0x2F
+          && memcmp (from->str, path->str, from->len) == 0)
+        return JSON_ERROR_BAD_PATCH;
+
+      if ((error = json_patch_remove (ctx, &from_ref, &value))
+          != JSON_ERROR_NONE)
+        return error;
+
+      // the removal may have shifted the destination, so resolve it after
+      if ((error = json_pointer_resolve (ctx, path->str, path->len, &ref))
+              != JSON_ERROR_NONE
+          || (error = json_patch_add (ctx, &ref, &value, JSON_TRUE))
+                 != JSON_ERROR_NONE)
+        {
+          // the removal's undo record takes the value back from the carry
+          if (ctx->atomic)
+            ctx->carry = value;
+          else
+            json_value_dispose_ext (allocator, &value);
+        }
+
+      return error;
+    }
+
+#undef JSON_PATCH_OP_IS
+
+  return JSON_ERROR_BAD_PATCH;
+}
+
+json_error
+json_patch_apply_ext (json_allocator *allocator, json_value *doc,
+                      json_value *patch, json_bool atomic)
+{
+  json_patch_ctx ctx
+      = { .allocator = allocator, .doc = doc, .atomic = atomic };
+  json_error error = JSON_ERROR_NONE;
+  json_array *ops;
+
+  if (!json_value_get_array (patch, &ops))
+    return JSON_ERROR_BAD_PATCH;
+
+  for (jusize i = 0; i < ops->size && error == JSON_ERROR_NONE; ++i)
+    error = json_patch_apply_op (&ctx, ops->elements + i);
+
+  if (error != JSON_ERROR_NONE)
+    json_patch_rollback (&ctx);
+  else
+    json_patch_commit (&ctx);
+
+  json_patch_ctx_dispose (&ctx);
+
+  return error;
+}
+
+json_error
+json_patch_apply (json_value *doc, json_value *patch, json_bool atomic)
+{
+  return json_patch_apply_ext (&std_allocator, doc, patch, atomic);
+}
+
+/**
+ * Builds the value a merge patch produces from a missing or non-object
+ * target: a copy of patch with null members removed.
+ */
+
+static json_error
+json_merge_patch_build (json_allocator *allocator, json_value *dst,
+                        json_value *patch)
+{
+  json_object *from, *to;
+  json_error error;
+
+  if (patch->type != JSON_VALUE_TYPE_OBJECT)
+    return json_value_copy_ext (allocator, dst, patch);
+
+  from      = &patch->value.object;
+  to        = &dst->value.object;
+  dst->type = JSON_VALUE_TYPE_OBJECT;
+  *to       = (json_object) { 0 };
+
+  for (jusize i = 0; i < from->size; ++i)
+    {
+      json_entry *entry = from->entries + i;
+      json_value value;
+      char *key;
+
+      if (entry->value.type == JSON_VALUE_TYPE_NULL)
+        continue;
+
+      if (!(key = allocator->json_malloc (entry->key_len + 1, allocator->ctx)))
+        {
+          error = JSON_ERROR_NOMEM;
+          goto fail;
+        }
+
+      memcpy (key, entry->key, entry->key_len + 1);
+
+      if ((error = json_merge_patch_build (allocator, &value, &entry->value))
+          != JSON_ERROR_NONE)
+        {
+          allocator->json_free (key, allocator->ctx);
+          goto fail;
+        }
+
+      if ((error = json_object_append_ext (allocator, to, key, entry->key_len,
+                                           entry->hash, &value))
+          != JSON_ERROR_NONE)
+        {
+          allocator->json_free (key, allocator->ctx);
+          json_value_dispose_ext (allocator, &value);
+          goto fail;
+        }
+    }
+
+  return JSON_ERROR_NONE;
+
+fail:
+  json_value_dispose_ext (allocator, dst);
+  return error;
+}
+
+/**
+ * Appends "/" and the escaped key to the path of the current member.
+ */
+
+static json_error
+json_merge_patch_push_key (json_patch_ctx *ctx, const char *key,
+                           jusize key_len)
+{
+  jusize len = ctx->path_len + 1 + key_len;
+  json_error error;
+
+  for (jusize i = 0; i < key_len; ++i)
+    len += key[i] == 0x7E || key[i] == 0x2F;
+
+  if ((error = json_patch_grow (ctx->allocator, &ctx->path, &ctx->path_cap,
+                                len))
+      != JSON_ERROR_NONE)
+    return error;
+
+  ctx->path[ctx->path_len++] = 0x2F;
+
+  for (jusize i = 0; i < key_len; ++i)
+    {
+      if (key[i] == 0x7E || key[i] == 0x2F)
+        {
+          ctx->path[ctx->path_len++] = 0x7E;
+          ctx->path[ctx->path_len++] = key[i] == 0x7E ? 0x30 : 0x31;
+        }
+      else
+        ctx->path[ctx->path_len++] = key[i];
+    }
+
+  return JSON_ERROR_NONE;
+}
+
+/**
+ * Merges patch into the existing value at ref.
+ */
+
+static json_error
+json_merge_patch_merge (json_patch_ctx *ctx, json_patch_ref *ref,
+                        json_value *patch)
+{
+  json_allocator *allocator = ctx->allocator;
+  json_value *target        = ref->target;
+  json_object *object, *from;
+  json_error error;
+  json_value value;
+
+  if (patch->type != JSON_VALUE_TYPE_OBJECT
+      || target->type != JSON_VALUE_TYPE_OBJECT)
+    {
+      if ((error = json_merge_patch_build (allocator, &value, patch))
+          != JSON_ERROR_NONE)
+        return error;
+
+      if ((error = json_patch_set (ctx, ref, &value, JSON_FALSE))
+          != JSON_ERROR_NONE)
+        json_value_dispose_ext (allocator, &value);
+
+      return error;
+    }
+
+  object = &target->value.object;
+  from   = &patch->value.object;
+
+  for (jusize i = 0; i < from->size; ++i)
+    {
+      json_entry *entry = from->entries + i;
+      jusize path_len   = ctx->path_len;
+      json_patch_ref child;
+
+      if ((error = json_merge_patch_push_key (ctx, entry->key, entry->key_len))
+          != JSON_ERROR_NONE)
+        return error;
+
+      child = (json_patch_ref) {
+        .parent   = target,
+        .index    = json_object_find (object, entry->key, entry->key_len,
+                                      entry->hash),
+        .key      = entry->key,
+        .key_len  = entry->key_len,
+        .hash     = entry->hash,
+        .path     = ctx->path,
+        .path_len = ctx->path_len,
+      };
+
+      if (child.index < object->size)
+        child.target = &object->entries[child.index].value;
+
+      if (entry->value.type == JSON_VALUE_TYPE_NULL)
+        error = child.target ? json_patch_remove (ctx, &child, NULL)
+                             : JSON_ERROR_NONE;
+      else if (child.target)
+        error = json_merge_patch_merge (ctx, &child, &entry->value);
+      else if ((error = json_merge_patch_build (allocator, &value,
+                                                &entry->value))
+                   == JSON_ERROR_NONE
+               && (error = json_patch_add (ctx, &child, &value, JSON_FALSE))
+                      != JSON_ERROR_NONE)
+        json_value_dispose_ext (allocator, &value);
+
+      if (error != JSON_ERROR_NONE)
+        return error;
+
+      ctx->path_len = path_len;
+    }
+
+  return JSON_ERROR_NONE;
+}
+
+json_error
+json_merge_patch_apply_ext (json_allocator *allocator, json_value *doc,
+                            json_value *patch, json_bool atomic)
+{
+  json_patch_ctx ctx
+      = { .allocator = allocator, .doc = doc, .atomic = atomic };
+  json_patch_ref ref = { .target = doc, .path = "" };
+  json_error error   = json_merge_patch_merge (&ctx, &ref, patch);
+
+  if (error != JSON_ERROR_NONE)
+    json_patch_rollback (&ctx);
+  else
+    json_patch_commit (&ctx);
+
+  json_patch_ctx_dispose (&ctx);
+
+  return error;
+}
+
+json_error
+json_merge_patch_apply (json_value *doc, json_value *patch, json_bool atomic)
+{
+  return json_merge_patch_apply_ext (&std_allocator, doc, patch, atomic);
+}
@@ -0,0 +1,582 @@
+/*
+ * Copyright (c) 2025 Zachary Lamb
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "_internal.h"
+
+/**
+ * A reader thread reads the input into one buffer while the calling thread
+ * decodes it. As it reads, the reader follows strings and nesting to find
+ * where each element of a root array ends, and publishes the offset past the
+ * last complete one. The decoder takes root array elements up to that offset
+ * and then waits for more, so it never sees part of an element. Any other
+ * root, and text the scan cannot follow, is decoded once it is all read.
+ *
+ * The decoder only holds pointers into the buffer while it is marked busy,
+ * and the reader only moves the buffer to grow it while it is not.
+ *
+ * Unless the input is a regular file, the reader waits for it with poll,
+ * together with a pipe that the decoder closes once it is finished, so that a
+ * failed decode need not wait for the writer of a pipe to close it.
+ */
+
+// the most the reader reads at a time, so that decoding starts early
+#ifndef JSON_PIPELINE_CHUNK
+#define JSON_PIPELINE_CHUNK (256 * 1024)
+#endif
+
+// what the decoder waits for
+#define JSON_PIPELINE_BYTES    0
+#define JSON_PIPELINE_ELEMENTS 1
+#define JSON_PIPELINE_ALL      2
+
+// where the decoder is in the root array
+#define JSON_PIPELINE_FIRST 0
+#define JSON_PIPELINE_VALUE 1
+#define JSON_PIPELINE_SEP   2
+
+typedef struct json_pipeline
+{
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+
+  json_allocator *allocator;
+  int fd;
+
+  // the read end of the pipe the decoder closes to stop the reader, or -1
+  int wake;
+
+  char *data;
+  jusize cap, filled;
+
+  // the end of the last complete root array element, or of the input once
+  // it is all read
+  jusize safe;
+
+  json_bool busy, eof, stop;
+  json_error error;
+
+  // the scan state, which only the reader uses
+  jusize scanned, depth;
+  json_bool in_string, escape, closed;
+} json_pipeline;
+
+/**
+ * Scans newly read bytes for the ends of root array elements.
+ *
+ * @return - the offset past the last element that ends in them, or safe if
+ * none does
+ */
+
+static jusize
+json_pipeline_scan (json_pipeline *pipeline, jusize end, jusize safe)
+{
+  const char *data = pipeline->data;
+
+  for (jusize i = pipeline->scanned; i < end && !pipeline->closed; ++i)
+    {
+      char ch = data[i];
+
+      if (pipeline->in_string)
+        {
+          if (pipeline->escape)
+            pipeline->escape = JSON_FALSE;
+          else if (ch == 0x5C)
+            pipeline->escape = JSON_TRUE;
+          else if (ch == 0x22)
+            pipeline->in_string = JSON_FALSE;
+
+          continue;
+        }
+
+      switch (ch)
+        {
+        case 0x22:
+          pipeline->in_string = JSON_TRUE;
+          break;
+        case 0x5B:
+        case 0x7B:
+          ++pipeline->depth;
+          break;
+        case 0x5D:
+        case 0x7D:
+          // past the root, only the whole input is left to decode
+          if (pipeline->depth <= 1)
+            {
+              pipeline->closed = JSON_TRUE;
+              safe             = i + 1;
+            }
+          else
+            --pipeline->depth;
+
+          break;
+        case 0x2C:
+          if (pipeline->depth == 1)
+            safe = i + 1;
+
+          break;
+        }
+    }
+
+  pipeline->scanned = end;
+
+  return safe;
+}
+
+static void *
+json_pipeline_read (void *arg)
+{
+  json_pipeline *pipeline   = arg;
+  json_allocator *allocator = pipeline->allocator;
+  json_error error          = JSON_ERROR_NONE;
+  json_bool stop            = JSON_FALSE;
+  jusize safe               = 0;
+
+  while (!stop)
+    {
+      jusize room;
+      ssize_t n;
+
+      if (pipeline->filled == pipeline->cap)
+        {
+          jusize cap = pipeline->cap * 2;
+          char *data = NULL;
+
+          pthread_mutex_lock (&pipeline->lock);
+
+          while (pipeline->busy)
+            pthread_cond_wait (&pipeline->cond, &pipeline->lock);
+
+          if (cap > pipeline->cap
+              && (data = allocator->json_realloc (pipeline->data, cap,
+                                                  allocator->ctx)))
+            {
+              pipeline->data = data;
+              pipeline->cap  = cap;
+            }
+
+          pthread_mutex_unlock (&pipeline->lock);
+
+          if (!data)
+            {
+              error = JSON_ERROR_NOMEM;
+              break;
+            }
+        }
+
+      room = pipeline->cap - pipeline->filled;
+
+      if (room > JSON_PIPELINE_CHUNK)
+        room = JSON_PIPELINE_CHUNK;
+
+      if (pipeline->wake >= 0)
+        {
+          struct pollfd fds[2] = {
+            { .fd = pipeline->fd, .events = POLLIN },
+            { .fd = pipeline->wake, .events = POLLIN },
+          };
+
+          if (poll (fds, 2, -1) < 0)
+            {
+              if (errno == EINTR)
+                continue;
+
+              error = JSON_ERROR_IO;
+              break;
+            }
+
+          // the decoder is finished and needs nothing more
+          if (fds[1].revents)
+            break;
+        }
+
+      if ((n = read (pipeline->fd, pipeline->data + pipeline->filled, room))
+          < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          error = JSON_ERROR_IO;
+          break;
+        }
+
+      if (!n)
+        break;
+
+      safe = json_pipeline_scan (pipeline, pipeline->filled + (jusize) n,
+                                 safe);
+
+      pthread_mutex_lock (&pipeline->lock);
+
+      pipeline->filled += (jusize) n;
+      pipeline->safe = safe;
+      stop           = pipeline->stop;
+
+      pthread_cond_broadcast (&pipeline->cond);
+      pthread_mutex_unlock (&pipeline->lock);
+    }
+
+  pthread_mutex_lock (&pipeline->lock);
+
+  pipeline->eof   = JSON_TRUE;
+  pipeline->error = error;
+  pipeline->safe  = pipeline->filled;
+
+  pthread_cond_broadcast (&pipeline->cond);
+  pthread_mutex_unlock (&pipeline->lock);
+
+  return NULL;
+}
+
+/**
+ * Releases the buffer to the reader until it has read past used, published
+ * an element that ends past used or, for JSON_PIPELINE_ALL, read everything.
+ * The buffer is then held again until the next wait.
+ *
+ * @param [out] limit - the offset the decoder may read up to
+ * @param [out] done  - set to JSON_TRUE once everything is read
+ *
+ * @return - the error the reader stopped with, if any
+ */
+
+static json_error
+json_pipeline_wait (json_pipeline *pipeline, ju8 want, jusize used,
+                    jusize *limit, json_bool *done)
+{
+  json_error error;
+
+  pthread_mutex_lock (&pipeline->lock);
+
+  pipeline->busy = JSON_FALSE;
+  pthread_cond_broadcast (&pipeline->cond);
+
+  while (1)
+    {
+      *limit = want == JSON_PIPELINE_BYTES ? pipeline->filled : pipeline->safe;
+
+      if (pipeline->eof || (want != JSON_PIPELINE_ALL && *limit > used))
+        break;
+
+      pthread_cond_wait (&pipeline->cond, &pipeline->lock);
+    }
+
+  pipeline->busy = JSON_TRUE;
+  *done          = pipeline->eof;
+  error          = pipeline->error;
+
+  pthread_mutex_unlock (&pipeline->lock);
+
+  return error;
+}
+
+static json_error
+json_pipeline_decode (json_pipeline *pipeline, json_decoder *decoder,
+                      json_value *value, json_decode_error *decode_error)
+{
+  json_allocator *allocator = decoder->allocator;
+  json_bool strict = !(decoder->ext_flags & JSON_EXT_SYNTAX), done = 0;
+  buffer buf       = { .row = 1, .col = 1 };
+  json_value tmpval = { 0 };
+  json_array array  = { 0 };
+  ju8 state         = JSON_PIPELINE_FIRST;
+  jusize limit = 0, pos, bom;
+  const char *data;
+  json_error error;
+
+  // the encoding is told by the first four bytes
+  while (limit < 4 && !done)
+    if ((error = json_pipeline_wait (pipeline, JSON_PIPELINE_BYTES, limit,
+                                     &limit, &done))
+        != JSON_ERROR_NONE)
+      goto fail;
+
+  data = pipeline->data;
+
+  // comments could hide brackets and quotes from the scan
+  if (json_detect_encoding (data, limit, decoder->ext_flags, &bom)
+          != JSON_ENCODING_UTF8
+      || (decoder->ext_flags & JSON_EXT_COMMENTS))
+    goto whole;
+
+  pos = bom;
+
+  while (1)
+    {
+      buf.data = data + pos;
+      buf.size = limit - pos;
+
+      json_consume_whitespace (decoder, &buf);
+      pos = (jusize) (buf.data - data);
+
+      if (buf.size || done)
+        break;
+
+      if ((error = json_pipeline_wait (pipeline, JSON_PIPELINE_BYTES, pos,
+                                       &limit, &done))
+          != JSON_ERROR_NONE)
+        goto fail;
+
+      data = pipeline->data;
+    }
+
+  if (!buf.size || buf.data[0] != 0x5B)
+    goto whole;
+
+  value->start   = (ju32) pos;
+  decoder->depth = 1;
+  BUF_ADVANCE_COL (&buf);
+  ++pos;
+
+  // the bytes read so far may end inside the first element
+  if (!done)
+    limit = pos;
+
+  while (1)
+    {
+      decoder->base = data;
+
+      buf.data = data + pos;
+      buf.size = limit > pos ? limit - pos : 0;
+
+      JSON_CONSUME_WHITESPACE (strict, decoder, &buf);
+
+      if (!buf.size)
+        {
+          if (done)
+            {
+              error = JSON_ERROR_UNCLOSED_ARR;
+              goto fail;
+            }
+
+          pos = (jusize) (buf.data - data);
+
+          if ((error = json_pipeline_wait (pipeline, JSON_PIPELINE_ELEMENTS,
+                                           pos, &limit, &done))
+              != JSON_ERROR_NONE)
+            goto fail;
+
+          data = pipeline->data;
+          continue;
+        }
+
+      if (state == JSON_PIPELINE_FIRST && buf.data[0] == 0x5D)
+        {
+          BUF_ADVANCE_COL (&buf);
+          break;
+        }
+
+      if (state != JSON_PIPELINE_SEP)
+        {
+          if ((error = json_decode_value_any (decoder, &tmpval, &buf))
+              != JSON_ERROR_NONE)
+            {
+              if (error == JSON_ERROR_EOF)
+                error = JSON_ERROR_UNCLOSED_ARR;
+
+              goto fail;
+            }
+
+          tmpval.start -= value->start;
+
+          if (!array.size && decoder->pack_arrays)
+            {
+              if (tmpval.type == JSON_VALUE_TYPE_NUMBER)
+                array.kind = JSON_ARRAY_NUMBERS;
+              else if (tmpval.type == JSON_VALUE_TYPE_BOOL)
+                array.kind = JSON_ARRAY_BOOLS;
+            }
+
+          if ((error = json_array_append_ext (allocator, &array, &tmpval))
+              != JSON_ERROR_NONE)
+            {
+              json_value_dispose_ext (allocator, &tmpval);
+              goto fail;
+            }
+
+          state = JSON_PIPELINE_SEP;
+        }
+      else if (buf.data[0] == 0x2C)
+        {
+          BUF_ADVANCE_COL (&buf);
+          state = JSON_PIPELINE_VALUE;
+        }
+      else if (buf.data[0] == 0x5D)
+        {
+          BUF_ADVANCE_COL (&buf);
+          break;
+        }
+      else
+        {
+          error = JSON_ERROR_BAD_ARRAY;
+          goto fail;
+        }
+
+      pos = (jusize) (buf.data - data);
+    }
+
+  value->type        = JSON_VALUE_TYPE_ARRAY;
+  value->value.array = array;
+
+  if (decoder->stats)
+    ++decoder->stats->values[JSON_VALUE_TYPE_ARRAY];
+
+  pos = (jusize) (buf.data - data);
+
+  while (!done)
+    if ((error = json_pipeline_wait (pipeline, JSON_PIPELINE_ALL, pos, &limit,
+                                     &done))
+        != JSON_ERROR_NONE)
+      {
+        json_value_dispose_ext (allocator, value);
+        goto fail_io;
+      }
+
+  data     = pipeline->data;
+  buf.data = data + pos;
+  buf.size = limit - pos;
+
+  json_consume_whitespace (decoder, &buf);
+
+  if (buf.size != 0 && (buf.size != 1 || buf.data[0] != 0))
+    {
+      json_value_dispose_ext (allocator, value);
+      error = JSON_ERROR_TRAILING_DATA;
+      goto fail_io;
+    }
+
+  return JSON_ERROR_NONE;
+
+whole:
+  while (!done)
+    if ((error = json_pipeline_wait (pipeline, JSON_PIPELINE_ALL, limit,
+                                     &limit, &done))
+        != JSON_ERROR_NONE)
+      goto fail;
+
+  return json_decode_text (decoder, pipeline->data, limit, value,
+                           decode_error);
+
+fail:
+  json_array_dispose_ext (allocator, &array);
+
+fail_io:
+  EMIT_DECODE_ERROR (error, buf.row, buf.col);
+  return error;
+}
+
+json_value *
+json_decode_fd_pipelined (const json_decoder_opts *decoder_opts, int fd,
+                          json_decode_error *decode_error)
+{
+  json_pipeline pipeline = { .fd = fd, .cap = JSON_PIPELINE_CHUNK };
+  json_value value, *value_a = NULL;
+  int wake[2] = { -1, -1 };
+  json_decoder decoder;
+  json_bool threaded, regular;
+  pthread_t reader;
+  json_error error;
+  struct stat st;
+
+  json_decoder_init (&decoder, decoder_opts);
+
+  // the buffer is freed below and may move while it is read, so no number
+  // can point into it
+  decoder.lazy_numbers = JSON_FALSE;
+
+  // a file is read into a buffer of its size, with room to see its end
+  regular = fstat (fd, &st) == 0 && S_ISREG (st.st_mode);
+
+  if (regular && st.st_size > 0
+      && (unsigned long long) st.st_size < (jusize) -1)
+    pipeline.cap = (jusize) st.st_size + 1;
+
+  pipeline.allocator = decoder.allocator;
+
+  if (!(pipeline.data = pipeline.allocator->json_malloc (
+            pipeline.cap, pipeline.allocator->ctx)))
+    {
+      EMIT_DECODE_ERROR (JSON_ERROR_NOMEM, 0, 0);
+      return NULL;
+    }
+
+  // reading a regular file does not wait on a writer; anything else might,
+  // and without the pipe only its input stops the reader
+  if (!regular && pipe (wake) != 0)
+    wake[0] = wake[1] = -1;
+
+  pipeline.wake = wake[0];
+
+  pthread_mutex_init (&pipeline.lock, NULL);
+  pthread_cond_init (&pipeline.cond, NULL);
+
+  // without a thread, the input is all read before it is decoded
+  if (!(threaded = !pthread_create (&reader, NULL, json_pipeline_read,
+                                    &pipeline)))
+    json_pipeline_read (&pipeline);
+
+  error = json_pipeline_decode (&pipeline, &decoder, &value, decode_error);
+
+  pthread_mutex_lock (&pipeline.lock);
+
+  pipeline.busy = JSON_FALSE;
+  pipeline.stop = JSON_TRUE;
+
+  pthread_cond_broadcast (&pipeline.cond);
+  pthread_mutex_unlock (&pipeline.lock);
+
+  if (wake[1] >= 0)
+    close (wake[1]);
+
+  if (threaded)
+    pthread_join (reader, NULL);
+
+  if (wake[0] >= 0)
+    close (wake[0]);
+
+  pthread_mutex_destroy (&pipeline.lock);
+  pthread_cond_destroy (&pipeline.cond);
+
+  pipeline.allocator->json_free (pipeline.data, pipeline.allocator->ctx);
+  json_decoder_release (&decoder);
+
+  if (error != JSON_ERROR_NONE)
+    return NULL;
+
+  if (!(value_a = pipeline.allocator->json_malloc (sizeof (json_value),
+                                                   pipeline.allocator->ctx)))
+    {
+      json_value_dispose_ext (pipeline.allocator, &value);
+      EMIT_DECODE_ERROR (JSON_ERROR_NOMEM, 0, 0);
+      return NULL;
+    }
+
+  *value_a = value;
+
+  return value_a;
+}
@@ -0,0 +1,366 @@
+/*
+ * Copyright (c) 2025 Zachary Lamb
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "_internal.h"
+
+/**
+ * A batch is split evenly between the workers up front. Each worker decodes
+ * its own range a chunk at a time from the front and, once it runs dry,
+ * steals the back half of another worker's range. A range is a single 64-bit
+ * word of two 32-bit indices, so taking and stealing are both one
+ * compare-and-swap. The calling thread works as worker 0.
+ */
+
+// the number of inputs a worker takes from its range at a time
+#ifndef JSON_POOL_CHUNK
+#define JSON_POOL_CHUNK 16
+#endif
+
+typedef struct json_pool_worker
+{
+  json_pool *pool;
+  pthread_t thread;
+
+  // decoder state and scratch memory are set up once and reused for every
+  // batch
+  json_decoder decoder;
+
+  ju64 range;
+} json_pool_worker;
+
+struct json_pool
+{
+  pthread_mutex_t lock;
+  pthread_cond_t work, done;
+  jusize n_workers, active, generation;
+  json_bool stop;
+
+  // the batch being decoded
+  const json_input *inputs;
+  json_value **outputs;
+  json_decode_error *errors;
+
+  json_pool_worker workers[];
+};
+
+#define JSON_POOL_RANGE(LO, HI) (((ju64) (LO) << 32) | (ju32) (HI))
+#define JSON_POOL_LO(RANGE)     ((ju32) ((RANGE) >> 32))
+#define JSON_POOL_HI(RANGE)     ((ju32) (RANGE))
+
+static void
+json_pool_decode (json_pool_worker *worker, jusize i)
+{
+  json_pool *pool           = worker->pool;
+  json_allocator *allocator = worker->decoder.allocator;
+  json_decode_error *error  = pool->errors ? pool->errors + i : NULL;
+  json_value *value = allocator->json_malloc (sizeof (json_value),
+                                             allocator->ctx);
+
+  if (error)
+    *error = (json_decode_error) { JSON_ERROR_NONE, 0, 0 };
+
+  if (!value)
+    {
+      if (error)
+        error->error = JSON_ERROR_NOMEM;
+    }
+  else if (json_decode_text (&worker->decoder, pool->inputs[i].buf,
+                             pool->inputs[i].size, value, error)
+           != JSON_ERROR_NONE)
+    {
+      allocator->json_free (value, allocator->ctx);
+      value = NULL;
+    }
+
+  pool->outputs[i] = value;
+}
+
+/**
+ * Takes up to JSON_POOL_CHUNK inputs from the front of a worker's own range.
+ *
+ * @return - JSON_FALSE if the range is empty
+ */
+
+static json_bool
+json_pool_take (json_pool_worker *worker, ju32 *lo, ju32 *hi)
+{
+  ju64 range = __atomic_load_n (&worker->range, __ATOMIC_ACQUIRE);
+
+  do
+    {
+      *lo = JSON_POOL_LO (range);
+      *hi = JSON_POOL_HI (range);
+
+      if (*lo >= *hi)
+        return JSON_FALSE;
+
+      if (*hi - *lo > JSON_POOL_CHUNK)
+        *hi = *lo + JSON_POOL_CHUNK;
+    }
+  while (!__atomic_compare_exchange_n (&worker->range, &range,
+                                       JSON_POOL_RANGE (*hi,
+                                                        JSON_POOL_HI (range)),
+                                       JSON_FALSE, __ATOMIC_ACQ_REL,
+                                       __ATOMIC_ACQUIRE));
+
+  return JSON_TRUE;
+}
+
+/**
+ * Moves the back half of another worker's range into the worker's own.
+ *
+ * @return - JSON_FALSE if every other range is empty
+ */
+
+static json_bool
+json_pool_steal (json_pool_worker *worker)
+{
+  json_pool *pool = worker->pool;
+  jusize self     = worker - pool->workers;
+
+  for (jusize i = 1; i < pool->n_workers; ++i)
+    {
+      json_pool_worker *victim = pool->workers + (self + i) % pool->n_workers;
+      ju64 range = __atomic_load_n (&victim->range, __ATOMIC_ACQUIRE);
+      ju32 lo, hi, mid;
+
+      do
+        {
+          lo = JSON_POOL_LO (range);
+          hi = JSON_POOL_HI (range);
+
+          if (lo >= hi)
+            break;
+
+          mid = lo + (hi - lo) / 2;
+        }
+      while (!__atomic_compare_exchange_n (
+          &victim->range, &range, JSON_POOL_RANGE (lo, mid), JSON_FALSE,
+          __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+      if (lo < hi)
+        {
+          __atomic_store_n (&worker->range, JSON_POOL_RANGE (mid, hi),
+                            __ATOMIC_RELEASE);
+          return JSON_TRUE;
+        }
+    }
+
+  return JSON_FALSE;
+}
+
+static void
+json_pool_run (json_pool_worker *worker)
+{
+  ju32 lo, hi;
+
+  do
+    while (json_pool_take (worker, &lo, &hi))
+      for (; lo < hi; ++lo)
+        json_pool_decode (worker, lo);
+  while (json_pool_steal (worker));
+}
+
+static void *
+json_pool_thread (void *arg)
+{
+  json_pool_worker *worker = arg;
+  json_pool *pool          = worker->pool;
+  jusize generation        = 0;
+
+  while (1)
+    {
+      pthread_mutex_lock (&pool->lock);
+
+      while (pool->generation == generation && !pool->stop)
+        pthread_cond_wait (&pool->work, &pool->lock);
+
+      generation = pool->generation;
+
+      if (pool->stop)
+        {
+          pthread_mutex_unlock (&pool->lock);
+          return NULL;
+        }
+
+      pthread_mutex_unlock (&pool->lock);
+
+      json_pool_run (worker);
+
+      pthread_mutex_lock (&pool->lock);
+
+      if (!--pool->active)
+        pthread_cond_signal (&pool->done);
+
+      pthread_mutex_unlock (&pool->lock);
+    }
+}
+
+/**
+ * Stops and joins the first n_threads worker threads.
+ */
+
+static void
+json_pool_join (json_pool *pool, jusize n_threads)
+{
+  pthread_mutex_lock (&pool->lock);
+  pool->stop = JSON_TRUE;
+  pthread_cond_broadcast (&pool->work);
+  pthread_mutex_unlock (&pool->lock);
+
+  for (jusize i = 1; i <= n_threads; ++i)
+    pthread_join (pool->workers[i].thread, NULL);
+}
+
+static void
+json_pool_free (json_pool *pool)
+{
+  pthread_mutex_destroy (&pool->lock);
+  pthread_cond_destroy (&pool->work);
+  pthread_cond_destroy (&pool->done);
+
+  std_allocator.json_free (pool, std_allocator.ctx);
+}
+
+json_pool *
+json_pool_create (const json_decoder_opts *decoder_opts, jusize n_threads)
+{
+  json_pool *pool;
+
+  if (!n_threads)
+    {
+      long n_cpus = sysconf (_SC_NPROCESSORS_ONLN);
+      n_threads   = n_cpus > 0 ? (jusize) n_cpus : 1;
+    }
+
+  pool = std_allocator.json_malloc (
+      sizeof (json_pool) + n_threads * sizeof (json_pool_worker),
+      std_allocator.ctx);
+
+  if (!pool)
+    return NULL;
+
+  pool->n_workers  = n_threads;
+  pool->active     = 0;
+  pool->generation = 0;
+  pool->stop       = JSON_FALSE;
+
+  pthread_mutex_init (&pool->lock, NULL);
+  pthread_cond_init (&pool->work, NULL);
+  pthread_cond_init (&pool->done, NULL);
+
+  for (jusize i = 0; i < n_threads; ++i)
+    {
+      json_pool_worker *worker = pool->workers + i;
+
+      worker->pool  = pool;
+      worker->range = 0;
+      json_decoder_init (&worker->decoder, decoder_opts);
+
+      // workers would race on shared stats and profile structs
+      worker->decoder.stats = NULL;
+#if JSON_PROFILING
+      worker->decoder.profile = NULL;
+#endif
+
+      if (i
+          && pthread_create (&worker->thread, NULL, json_pool_thread, worker))
+        {
+          json_pool_join (pool, i - 1);
+          json_pool_free (pool);
+          return NULL;
+        }
+    }
+
+  return pool;
+}
+
+void
+json_pool_destroy (json_pool *pool)
+{
+  json_pool_join (pool, pool->n_workers - 1);
+
+  for (jusize i = 0; i < pool->n_workers; ++i)
+    json_decoder_release (&pool->workers[i].decoder);
+
+  json_pool_free (pool);
+}
+
+json_error
+json_decode_batch (json_pool *pool, const json_input inputs[], jusize n,
+                   json_value *outputs[], json_decode_error errors[])
+{
+  jusize n_workers = pool->n_workers;
+  json_error first = JSON_ERROR_NONE, error;
+
+  // ranges hold 32-bit indices, so larger batches go in slices
+  while (n > (ju32) -1)
+    {
+      jusize slice = (ju32) -1;
+
+      error = json_decode_batch (pool, inputs, slice, outputs, errors);
+
+      if (first == JSON_ERROR_NONE)
+        first = error;
+
+      inputs += slice;
+      outputs += slice;
+      errors = errors ? errors + slice : NULL;
+      n -= slice;
+    }
+
+  pool->inputs  = inputs;
+  pool->outputs = outputs;
+  pool->errors  = errors;
+
+  for (jusize i = 0; i < n_workers; ++i)
+    __atomic_store_n (&pool->workers[i].range,
+                      JSON_POOL_RANGE (n * i / n_workers,
+                                       n * (i + 1) / n_workers),
+                      __ATOMIC_RELAXED);
+
+  pthread_mutex_lock (&pool->lock);
+  pool->active = n_workers - 1;
+  ++pool->generation;
+  pthread_cond_broadcast (&pool->work);
+  pthread_mutex_unlock (&pool->lock);
+
+  json_pool_run (pool->workers);
+
+  pthread_mutex_lock (&pool->lock);
+
+  while (pool->active)
+    pthread_cond_wait (&pool->done, &pool->lock);
+
+  pthread_mutex_unlock (&pool->lock);
+
+  for (jusize i = 0; i < n && first == JSON_ERROR_NONE; ++i)
+    if (!outputs[i])
+      first = errors ? errors[i].error : JSON_ERROR_DECODING;
+
+  return first;
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2025 Zachary Lamb
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <time.h>
+
+#include "_internal.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+/**
+ * Only built with -Dprofiling=true, which also defines JSON_PROFILING for
+ * every source so that the decoder calls in here at each phase switch.
+ */
+
+static ju64
+json_profile_tick (void)
+{
+#if defined(__GNUC__) && defined(__x86_64__)
+  return __rdtsc ();
+#else
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (ju64) ts.tv_sec * 1000000000 + (ju64) ts.tv_nsec;
+#endif
+}
+
+void
+json_profile_begin (json_decoder *decoder, const char *pos)
+{
+  decoder->phase = JSON_DECODE_PHASE_OTHER;
+
+  if (!decoder->profile)
+    return;
+
+  decoder->tick = json_profile_tick ();
+  decoder->pos  = pos;
+}
+
+void
+json_profile_end (json_decoder *decoder, const char *pos)
+{
+  json_profile_switch (decoder, JSON_DECODE_PHASE_OTHER, pos, JSON_FALSE);
+
+  decoder->pos = NULL;
+}
+
+void
+json_profile_switch (json_decoder *decoder, ju8 phase, const char *pos,
+                     json_bool enter)
+{
+  json_decode_profile *profile = decoder->profile;
+  ju64 tick;
+
+  // decoders outside of json_decode_text, such as the formatter's, still
+  // track the phase but charge nothing
+  if (!profile || !decoder->pos)
+    {
+      decoder->phase = phase;
+      return;
+    }
+
+  tick = json_profile_tick ();
+
+  profile->ticks[decoder->phase] += tick - decoder->tick;
+  profile->bytes[decoder->phase] += (ju64) (pos - decoder->pos);
+
+  if (enter)
+    ++profile->calls[phase];
+
+  decoder->phase = phase;
+  decoder->tick  = tick;
+  decoder->pos   = pos;
+}
@@ -0,0 +1,957 @@
+/*
+ * Copyright (c) 2025 Zachary Lamb
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "_internal.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define JSON_SIMD_X86 1
+#include <immintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__)
+#define JSON_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+/**
+ * Non-zero for every byte that cannot appear unescaped in a JSON string:
+ * '"', '\' and the control characters below 0x20.
+ */
+
+static const ju8 escape_table[256] = {
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+static jusize
+json_find_escape_scalar (const char *data, jusize size)
+{
+  const ju8 *p = (const ju8 *) data;
+  jusize i     = 0;
+
+  for (; i + 4 <= size; i += 4)
+    {
+      if (escape_table[p[i]])
+        return i;
+      if (escape_table[p[i + 1]])
+        return i + 1;
+      if (escape_table[p[i + 2]])
+        return i + 2;
+      if (escape_table[p[i + 3]])
+        return i + 3;
+    }
+
+  for (; i < size; ++i)
+    if (escape_table[p[i]])
+      return i;
+
+  return size;
+}
+
+/**
+ * Bytes that interrupt a run of comment text: line breaks and tabs, which
+ * move the row or column, and for block comments (bit 1) the '*' that may
+ * close them.
+ */
+
+static const ju8 comment_table[256] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 3, 0, 0, 3, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+static jusize
+json_find_comment_stop_scalar (const char *data, jusize size, json_bool block)
+{
+  const ju8 *p = (const ju8 *) data;
+  ju8 mask     = block ? 3 : 1;
+
+  for (jusize i = 0; i < size; ++i)
+    if (comment_table[p[i]] & mask)
+      return i;
+
+  return size;
+}
+
+/**
+ * @return - the length of the well-formed UTF-8 sequence at the start of the
+ * size bytes at p, which must start with a non-ASCII byte, or zero if there
+ * is none
+ */
+
+static inline ju8
+json_utf8_seq_len (const ju8 *p, jusize size)
+{
+  ju8 lo = 0x80, hi = 0xBF;
+
+  if (p[0] < 0xC2 || p[0] > 0xF4)
+    return 0;
+
+  if (p[0] < 0xE0)
+    return size >= 2 && (p[1] & 0xC0) == 0x80 ? 2 : 0;
+
+  if (p[0] == 0xE0)
+    lo = 0xA0;
+  else if (p[0] == 0xED)
+    hi = 0x9F;
+  else if (p[0] == 0xF0)
+    lo = 0x90;
+  else if (p[0] == 0xF4)
+    hi = 0x8F;
+
+  if (p[0] < 0xF0)
+    return size >= 3 && p[1] >= lo && p[1] <= hi && (p[2] & 0xC0) == 0x80
+               ? 3
+               : 0;
+
+  return size >= 4 && p[1] >= lo && p[1] <= hi && (p[2] & 0xC0) == 0x80
+                 && (p[3] & 0xC0) == 0x80
+             ? 4
+             : 0;
+}
+
+static jusize
+json_utf8_valid_prefix_scalar (const char *data, jusize size)
+{
+  const ju8 *p = (const ju8 *) data;
+  jusize i     = 0;
+
+  while (i < size)
+    {
+      ju64 word;
+      ju8 len;
+
+      if (i + 8 <= size)
+        {
+          memcpy (&word, p + i, 8);
+
+          if (!(word & 0x8080808080808080ULL))
+            {
+              i += 8;
+              continue;
+            }
+        }
+
+      if (p[i] < 0x80)
+        {
+          ++i;
+          continue;
+        }
+
+      if (!(len = json_utf8_seq_len (p + i, size - i)))
+        return i;
+
+      i += len;
+    }
+
+  return size;
+}
+
+/**
+ * Finishes validation with the scalar decoder once the vector loop has found
+ * an error or run out of whole vectors at i. Everything before i is valid
+ * but for a sequence that may be cut off at i, so the scalar decoder starts
+ * again from its lead byte.
+ */
+
+static jusize
+json_utf8_finish (const char *data, jusize size, jusize i)
+{
+  jusize start = i;
+
+  for (jusize k = 1; k <= 3 && k <= i; ++k)
+    {
+      ju8 c = (ju8) data[i - k];
+
+      if ((c & 0xC0) != 0x80)
+        {
+          if (c >= 0xC0)
+            start = i - k;
+          break;
+        }
+    }
+
+  return start + json_utf8_valid_prefix_scalar (data + start, size - start);
+}
+
+static jusize
+json_narrow_ascii_scalar (char *dst, const char *src, jusize units, ju8 width,
+                          json_bool big_endian)
+{
+  const ju8 *p = (const ju8 *) src;
+  ju8 low      = big_endian ? width - 1 : 0;
+
+  for (jusize i = 0; i < units; ++i, p += width)
+    {
+      ju8 rest = 0;
+
+      for (ju8 k = 0; k < width; ++k)
+        if (k != low)
+          rest |= p[k];
+
+      if (rest || p[low] >= 0x80)
+        return i;
+
+      dst[i] = (char) p[low];
+    }
+
+  return units;
+}
+
+#if defined(JSON_SIMD_X86)
+
+static jusize
+json_find_escape_sse2 (const char *data, jusize size)
+{
+  const __m128i quote = _mm_set1_epi8 (0x22);
+  const __m128i slash = _mm_set1_epi8 (0x5C);
+  const __m128i ctrl  = _mm_set1_epi8 (0x1F);
+  jusize i            = 0;
+
+  for (; i + 16 <= size; i += 16)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) (data + i));
+
+      // v <= 0x1F as unsigned bytes iff max (v, 0x1F) == 0x1F
+      __m128i m = _mm_or_si128 (
+          _mm_or_si128 (_mm_cmpeq_epi8 (v, quote), _mm_cmpeq_epi8 (v, slash)),
+          _mm_cmpeq_epi8 (_mm_max_epu8 (v, ctrl), ctrl));
+
+      int mask = _mm_movemask_epi8 (m);
+
+      if (mask)
+        return i + __builtin_ctz (mask);
+    }
+
+  return i + json_find_escape_scalar (data + i, size - i);
+}
+
+__attribute__ ((target ("avx2"))) static jusize
+json_find_escape_avx2 (const char *data, jusize size)
+{
+  const __m256i quote = _mm256_set1_epi8 (0x22);
+  const __m256i slash = _mm256_set1_epi8 (0x5C);
+  const __m256i ctrl  = _mm256_set1_epi8 (0x1F);
+  jusize i            = 0;
+
+  for (; i + 64 <= size; i += 64)
+    {
+      __m256i v0 = _mm256_loadu_si256 ((const __m256i *) (data + i));
+      __m256i v1 = _mm256_loadu_si256 ((const __m256i *) (data + i + 32));
+
+      __m256i m0 = _mm256_or_si256 (
+          _mm256_or_si256 (_mm256_cmpeq_epi8 (v0, quote),
+                           _mm256_cmpeq_epi8 (v0, slash)),
+          _mm256_cmpeq_epi8 (_mm256_max_epu8 (v0, ctrl), ctrl));
+      __m256i m1 = _mm256_or_si256 (
+          _mm256_or_si256 (_mm256_cmpeq_epi8 (v1, quote),
+                           _mm256_cmpeq_epi8 (v1, slash)),
+          _mm256_cmpeq_epi8 (_mm256_max_epu8 (v1, ctrl), ctrl));
+
+      ju64 mask = (ju32) _mm256_movemask_epi8 (m0)
+                  | ((ju64) (ju32) _mm256_movemask_epi8 (m1) << 32);
+
+      if (mask)
+        return i + __builtin_ctzll (mask);
+    }
+
+  return i + json_find_escape_sse2 (data + i, size - i);
+}
+
+static jusize
+json_find_comment_stop_sse2 (const char *data, jusize size, json_bool block)
+{
+  // line comments look for a second line feed instead of '*'
+  const __m128i lf   = _mm_set1_epi8 (0x0A);
+  const __m128i cr   = _mm_set1_epi8 (0x0D);
+  const __m128i tab  = _mm_set1_epi8 (0x09);
+  const __m128i star = _mm_set1_epi8 (block ? 0x2A : 0x0A);
+  jusize i           = 0;
+
+  for (; i + 16 <= size; i += 16)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) (data + i));
+      __m128i m = _mm_or_si128 (
+          _mm_or_si128 (_mm_cmpeq_epi8 (v, lf), _mm_cmpeq_epi8 (v, cr)),
+          _mm_or_si128 (_mm_cmpeq_epi8 (v, tab), _mm_cmpeq_epi8 (v, star)));
+
+      int mask = _mm_movemask_epi8 (m);
+
+      if (mask)
+        return i + __builtin_ctz (mask);
+    }
+
+  return i + json_find_comment_stop_scalar (data + i, size - i, block);
+}
+
+__attribute__ ((target ("avx2"))) static jusize
+json_find_comment_stop_avx2 (const char *data, jusize size, json_bool block)
+{
+  const __m256i lf   = _mm256_set1_epi8 (0x0A);
+  const __m256i cr   = _mm256_set1_epi8 (0x0D);
+  const __m256i tab  = _mm256_set1_epi8 (0x09);
+  const __m256i star = _mm256_set1_epi8 (block ? 0x2A : 0x0A);
+  jusize i           = 0;
+
+  for (; i + 32 <= size; i += 32)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i *) (data + i));
+      __m256i m = _mm256_or_si256 (
+          _mm256_or_si256 (_mm256_cmpeq_epi8 (v, lf),
+                           _mm256_cmpeq_epi8 (v, cr)),
+          _mm256_or_si256 (_mm256_cmpeq_epi8 (v, tab),
+                           _mm256_cmpeq_epi8 (v, star)));
+
+      ju32 mask = (ju32) _mm256_movemask_epi8 (m);
+
+      if (mask)
+        return i + __builtin_ctz (mask);
+    }
+
+  return i + json_find_comment_stop_sse2 (data + i, size - i, block);
+}
+
+static jusize
+json_utf8_valid_prefix_sse2 (const char *data, jusize size)
+{
+  jusize i = 0;
+
+  // only ASCII is skipped a vector at a time; see the AVX2 kernel
+  for (; i + 16 <= size; i += 16)
+    if (_mm_movemask_epi8 (_mm_loadu_si128 ((const __m128i *) (data + i))))
+      break;
+
+  return json_utf8_finish (data, size, i);
+}
+
+/**
+ * UTF-8 validation by table lookup, after Keiser and Lemire, "Validating
+ * UTF-8 in less than one instruction per byte". Each byte and the one before
+ * it are classified by three nibble lookups whose intersection is non-zero
+ * for any invalid pair; third and fourth continuation bytes are checked
+ * against the lead two and three bytes back.
+ */
+
+#define UTF8_TOO_SHORT  0x01
+#define UTF8_TOO_LONG   0x02
+#define UTF8_OVERLONG_3 0x04
+#define UTF8_TOO_LARGE  0x08
+#define UTF8_SURROGATE  0x10
+#define UTF8_OVERLONG_2 0x20
+#define UTF8_TOO_LARGE2 0x40
+#define UTF8_OVERLONG_4 0x40
+#define UTF8_TWO_CONTS  0x80
+#define UTF8_CARRY      (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+// indexed by the high nibble of the previous byte
+static const ju8 utf8_byte_1_high[16] = {
+  UTF8_TOO_LONG,
+  UTF8_TOO_LONG,
+  UTF8_TOO_LONG,
+  UTF8_TOO_LONG,
+  UTF8_TOO_LONG,
+  UTF8_TOO_LONG,
+  UTF8_TOO_LONG,
+  UTF8_TOO_LONG,
+  UTF8_TWO_CONTS,
+  UTF8_TWO_CONTS,
+  UTF8_TWO_CONTS,
+  UTF8_TWO_CONTS,
+  UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+  UTF8_TOO_SHORT,
+  UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+  UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE2 | UTF8_OVERLONG_4,
+};
+
+// indexed by the low nibble of the previous byte
+static const ju8 utf8_byte_1_low[16] = {
+  UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+  UTF8_CARRY | UTF8_OVERLONG_2,
+  UTF8_CARRY,
+  UTF8_CARRY,
+  UTF8_CARRY | UTF8_TOO_LARGE,
+  UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE2,
+  UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE2,
+  UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE2,
+  UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE2,
+  UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE2,
+  UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE2,
+  UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE2,
+  UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE2,
+  UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE2 | UTF8_SURROGATE,
+  UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE2,
+  UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE2,
+};
+
+// indexed by the high nibble of the current byte
+static const ju8 utf8_byte_2_high[16] = {
+  UTF8_TOO_SHORT,
+  UTF8_TOO_SHORT,
+  UTF8_TOO_SHORT,
+  UTF8_TOO_SHORT,
+  UTF8_TOO_SHORT,
+  UTF8_TOO_SHORT,
+  UTF8_TOO_SHORT,
+  UTF8_TOO_SHORT,
+  UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3
+      | UTF8_TOO_LARGE2 | UTF8_OVERLONG_4,
+  UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3
+      | UTF8_TOO_LARGE,
+  UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE
+      | UTF8_TOO_LARGE,
+  UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE
+      | UTF8_TOO_LARGE,
+  UTF8_TOO_SHORT,
+  UTF8_TOO_SHORT,
+  UTF8_TOO_SHORT,
+  UTF8_TOO_SHORT,
+};
+
+__attribute__ ((target ("avx2"))) static inline __m256i
+json_utf8_table_avx2 (const ju8 table[16])
+{
+  return _mm256_broadcastsi128_si256 (
+      _mm_loadu_si128 ((const __m128i *) table));
+}
+
+__attribute__ ((target ("avx2"))) static inline __m256i
+json_utf8_prev_avx2 (__m256i input, __m256i prev_input, int n)
+{
+  __m256i joined = _mm256_permute2x128_si256 (prev_input, input, 0x21);
+
+  switch (n)
+    {
+    case 1:
+      return _mm256_alignr_epi8 (input, joined, 15);
+    case 2:
+      return _mm256_alignr_epi8 (input, joined, 14);
+    default:
+      return _mm256_alignr_epi8 (input, joined, 13);
+    }
+}
+
+__attribute__ ((target ("avx2"))) static inline __m256i
+json_utf8_check_avx2 (__m256i input, __m256i prev_input)
+{
+  const __m256i nibble = _mm256_set1_epi8 (0x0F);
+
+  __m256i prev1 = json_utf8_prev_avx2 (input, prev_input, 1);
+  __m256i prev2 = json_utf8_prev_avx2 (input, prev_input, 2);
+  __m256i prev3 = json_utf8_prev_avx2 (input, prev_input, 3);
+
+  __m256i special = _mm256_and_si256 (
+      _mm256_and_si256 (
+          _mm256_shuffle_epi8 (
+              json_utf8_table_avx2 (utf8_byte_1_high),
+              _mm256_and_si256 (_mm256_srli_epi16 (prev1, 4), nibble)),
+          _mm256_shuffle_epi8 (json_utf8_table_avx2 (utf8_byte_1_low),
+                               _mm256_and_si256 (prev1, nibble))),
+      _mm256_shuffle_epi8 (
+          json_utf8_table_avx2 (utf8_byte_2_high),
+          _mm256_and_si256 (_mm256_srli_epi16 (input, 4), nibble)));
+
+  // the top bit is set where a third or fourth byte must be a continuation
+  __m256i must23 = _mm256_or_si256 (
+      _mm256_subs_epu8 (prev2, _mm256_set1_epi8 ((char) (0xE0 - 0x80))),
+      _mm256_subs_epu8 (prev3, _mm256_set1_epi8 ((char) (0xF0 - 0x80))));
+
+  return _mm256_xor_si256 (
+      _mm256_and_si256 (must23, _mm256_set1_epi8 ((char) 0x80)), special);
+}
+
+/**
+ * @return - whether the last three bytes of v hold the start of a sequence
+ * that runs past the end of v
+ */
+
+__attribute__ ((target ("avx2"))) static inline int
+json_utf8_incomplete_avx2 (__m256i v)
+{
+  __m256i over = _mm256_subs_epu8 (
+      v, _mm256_setr_epi8 (-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                           -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                           -1, -1, -1, -1, -1, (char) (0xF0 - 1),
+                           (char) (0xE0 - 1), (char) (0xC0 - 1)));
+
+  return !_mm256_testz_si256 (over, over);
+}
+
+__attribute__ ((target ("avx2"))) static jusize
+json_utf8_valid_prefix_avx2 (const char *data, jusize size)
+{
+  __m256i prev = _mm256_setzero_si256 ();
+  jusize i     = 0;
+
+  for (; i + 32 <= size; i += 32)
+    {
+      __m256i input = _mm256_loadu_si256 ((const __m256i *) (data + i));
+
+      // an ASCII vector needs no lookups unless the previous one ended
+      // inside a sequence
+      if (!_mm256_movemask_epi8 (input))
+        {
+          if (json_utf8_incomplete_avx2 (prev))
+            break;
+
+          prev = input;
+          continue;
+        }
+
+      __m256i error = json_utf8_check_avx2 (input, prev);
+
+      if (!_mm256_testz_si256 (error, error))
+        break;
+
+      prev = input;
+    }
+
+  // GCC leaves the upper halves dirty across this call, which makes every
+  // SSE instruction until the next vzeroupper pay a transition penalty
+  _mm256_zeroupper ();
+
+  return json_utf8_finish (data, size, i);
+}
+
+/**
+ * Finds the next escape and validates the UTF-8 before it in one pass. Lookup
+ * errors past the escape are masked off; a sequence the escape cuts short
+ * is left to json_utf8_finish.
+ */
+
+__attribute__ ((target ("avx2"))) static jusize
+json_find_escape_utf8_avx2 (const char *data, jusize size,
+                            jusize *out_valid)
+{
+  const __m256i quote = _mm256_set1_epi8 (0x22);
+  const __m256i slash = _mm256_set1_epi8 (0x5C);
+  const __m256i ctrl  = _mm256_set1_epi8 (0x1F);
+  __m256i prev        = _mm256_setzero_si256 ();
+  jusize i            = 0;
+  jusize run;
+
+  for (; i + 32 <= size; i += 32)
+    {
+      __m256i input = _mm256_loadu_si256 ((const __m256i *) (data + i));
+      __m256i esc   = _mm256_or_si256 (
+          _mm256_or_si256 (_mm256_cmpeq_epi8 (input, quote),
+                           _mm256_cmpeq_epi8 (input, slash)),
+          _mm256_cmpeq_epi8 (_mm256_max_epu8 (input, ctrl), ctrl));
+      ju32 mask = (ju32) _mm256_movemask_epi8 (esc);
+      ju32 live = mask ? (mask & -mask) - 1 : 0xFFFFFFFF;
+
+      if ((_mm256_movemask_epi8 (input) & live)
+          || json_utf8_incomplete_avx2 (prev))
+        {
+          __m256i error = json_utf8_check_avx2 (input, prev);
+          ju32 bad      = ~(ju32) _mm256_movemask_epi8 (
+              _mm256_cmpeq_epi8 (error, _mm256_setzero_si256 ()));
+
+          if (bad & live)
+            {
+              _mm256_zeroupper ();
+
+              run = mask ? i + __builtin_ctz (mask)
+                         : i + json_find_escape_avx2 (data + i, size - i);
+              *out_valid = json_utf8_finish (data, run, i);
+              return run;
+            }
+        }
+
+      if (mask)
+        {
+          _mm256_zeroupper ();
+
+          run        = i + __builtin_ctz (mask);
+          *out_valid = json_utf8_finish (data, run, run);
+          return run;
+        }
+
+      prev = input;
+    }
+
+  _mm256_zeroupper ();
+
+  run        = i + json_find_escape_sse2 (data + i, size - i);
+  *out_valid = json_utf8_finish (data, run, i);
+
+  return run;
+}
+
+static jusize
+json_narrow_ascii_sse2 (char *dst, const char *src, jusize units, ju8 width,
+                        json_bool big_endian)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  jusize i           = 0;
+
+  // each unit must hold an ASCII byte in its low byte and zeroes elsewhere;
+  // big-endian units are shifted down to put that byte at the bottom
+  if (width == 2)
+    {
+      const __m128i mask = _mm_set1_epi16 (
+          (short) (big_endian ? 0x80FF : 0xFF80));
+
+      for (; i + 16 <= units; i += 16)
+        {
+          __m128i v0 = _mm_loadu_si128 ((const __m128i *) (src + 2 * i));
+          __m128i v1
+              = _mm_loadu_si128 ((const __m128i *) (src + 2 * i + 16));
+          __m128i bad = _mm_and_si128 (_mm_or_si128 (v0, v1), mask);
+
+          if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (bad, zero)) != 0xFFFF)
+            break;
+
+          if (big_endian)
+            {
+              v0 = _mm_srli_epi16 (v0, 8);
+              v1 = _mm_srli_epi16 (v1, 8);
+            }
+
+          _mm_storeu_si128 ((__m128i *) (dst + i), _mm_packus_epi16 (v0, v1));
+        }
+    }
+  else
+    {
+      const __m128i mask
+          = _mm_set1_epi32 ((int) (big_endian ? 0x80FFFFFFU : 0xFFFFFF80U));
+
+      for (; i + 16 <= units; i += 16)
+        {
+          const __m128i *p = (const __m128i *) (src + 4 * i);
+          __m128i v0       = _mm_loadu_si128 (p);
+          __m128i v1       = _mm_loadu_si128 (p + 1);
+          __m128i v2       = _mm_loadu_si128 (p + 2);
+          __m128i v3       = _mm_loadu_si128 (p + 3);
+          __m128i bad      = _mm_and_si128 (
+              _mm_or_si128 (_mm_or_si128 (v0, v1), _mm_or_si128 (v2, v3)),
+              mask);
+
+          if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (bad, zero)) != 0xFFFF)
+            break;
+
+          if (big_endian)
+            {
+              v0 = _mm_srli_epi32 (v0, 24);
+              v1 = _mm_srli_epi32 (v1, 24);
+              v2 = _mm_srli_epi32 (v2, 24);
+              v3 = _mm_srli_epi32 (v3, 24);
+            }
+
+          _mm_storeu_si128 ((__m128i *) (dst + i),
+                            _mm_packus_epi16 (_mm_packs_epi32 (v0, v1),
+                                              _mm_packs_epi32 (v2, v3)));
+        }
+    }
+
+  return i
+         + json_narrow_ascii_scalar (dst + i, src + i * width, units - i,
+                                     width, big_endian);
+}
+
+#elif defined(JSON_SIMD_NEON)
+
+static jusize
+json_find_escape_neon (const char *data, jusize size)
+{
+  const uint8x16_t quote = vdupq_n_u8 (0x22);
+  const uint8x16_t slash = vdupq_n_u8 (0x5C);
+  const uint8x16_t ctrl  = vdupq_n_u8 (0x1F);
+  jusize i               = 0;
+
+  for (; i + 16 <= size; i += 16)
+    {
+      uint8x16_t v = vld1q_u8 ((const ju8 *) data + i);
+      uint8x16_t m = vorrq_u8 (vorrq_u8 (vceqq_u8 (v, quote),
+                                         vceqq_u8 (v, slash)),
+                               vcleq_u8 (v, ctrl));
+
+      // narrow each byte of the mask to a nibble to get a 64-bit bitmap
+      ju64 mask = vget_lane_u64 (
+          vreinterpret_u64_u8 (vshrn_n_u16 (vreinterpretq_u16_u8 (m), 4)),
+          0);
+
+      if (mask)
+        return i + (__builtin_ctzll (mask) >> 2);
+    }
+
+  return i + json_find_escape_scalar (data + i, size - i);
+}
+
+static jusize
+json_find_comment_stop_neon (const char *data, jusize size, json_bool block)
+{
+  const uint8x16_t lf   = vdupq_n_u8 (0x0A);
+  const uint8x16_t cr   = vdupq_n_u8 (0x0D);
+  const uint8x16_t tab  = vdupq_n_u8 (0x09);
+  const uint8x16_t star = vdupq_n_u8 (block ? 0x2A : 0x0A);
+  jusize i              = 0;
+
+  for (; i + 16 <= size; i += 16)
+    {
+      uint8x16_t v = vld1q_u8 ((const ju8 *) data + i);
+      uint8x16_t m = vorrq_u8 (vorrq_u8 (vceqq_u8 (v, lf), vceqq_u8 (v, cr)),
+                               vorrq_u8 (vceqq_u8 (v, tab),
+                                         vceqq_u8 (v, star)));
+
+      ju64 mask = vget_lane_u64 (
+          vreinterpret_u64_u8 (vshrn_n_u16 (vreinterpretq_u16_u8 (m), 4)),
+          0);
+
+      if (mask)
+        return i + (__builtin_ctzll (mask) >> 2);
+    }
+
+  return i + json_find_comment_stop_scalar (data + i, size - i, block);
+}
+
+static jusize
+json_utf8_valid_prefix_neon (const char *data, jusize size)
+{
+  jusize i = 0;
+
+  // only ASCII is skipped a vector at a time
+  for (; i + 16 <= size; i += 16)
+    if (vmaxvq_u8 (vld1q_u8 ((const ju8 *) data + i)) >= 0x80)
+      break;
+
+  return json_utf8_finish (data, size, i);
+}
+
+
+static jusize
+json_narrow_ascii_neon (char *dst, const char *src, jusize units, ju8 width,
+                        json_bool big_endian)
+{
+  const ju8 *p = (const ju8 *) src;
+  jusize i     = 0;
+
+  // the structured loads split each unit into its bytes, one vector per
+  // byte position
+  if (width == 2)
+    for (; i + 16 <= units; i += 16)
+      {
+        uint8x16x2_t v = vld2q_u8 (p + 2 * i);
+        uint8x16_t lo  = v.val[big_endian ? 1 : 0];
+        uint8x16_t hi  = v.val[big_endian ? 0 : 1];
+
+        if (vmaxvq_u8 (hi) || vmaxvq_u8 (lo) >= 0x80)
+          break;
+
+        vst1q_u8 ((ju8 *) dst + i, lo);
+      }
+  else
+    for (; i + 16 <= units; i += 16)
+      {
+        uint8x16x4_t v = vld4q_u8 (p + 4 * i);
+        uint8x16_t lo  = v.val[big_endian ? 3 : 0];
+        uint8x16_t hi  = vorrq_u8 (v.val[1], v.val[2]);
+
+        hi = vorrq_u8 (hi, v.val[big_endian ? 0 : 3]);
+
+        if (vmaxvq_u8 (hi) || vmaxvq_u8 (lo) >= 0x80)
+          break;
+
+        vst1q_u8 ((ju8 *) dst + i, lo);
+      }
+
+  return i
+         + json_narrow_ascii_scalar (dst + i, src + i * width, units - i,
+                                     width, big_endian);
+}
+
+#endif
+
+static jusize json_find_escape_init (const char *data, jusize size);
+static jusize json_find_comment_stop_init (const char *data, jusize size,
+                                           json_bool block);
+static jusize json_utf8_valid_prefix_init (const char *data, jusize size);
+static jusize json_find_escape_utf8_init (const char *data, jusize size,
+                                          jusize *out_valid);
+static jusize json_find_escape_utf8_split (const char *data, jusize size,
+                                           jusize *out_valid);
+
+typedef jusize (*json_find_escape_fn) (const char *, jusize);
+typedef jusize (*json_find_comment_stop_fn) (const char *, jusize, json_bool);
+typedef jusize (*json_utf8_valid_prefix_fn) (const char *, jusize);
+typedef jusize (*json_find_escape_utf8_fn) (const char *, jusize, jusize *);
+
+static json_find_escape_fn find_escape_impl = json_find_escape_init;
+static json_find_comment_stop_fn find_comment_stop_impl
+    = json_find_comment_stop_init;
+static json_utf8_valid_prefix_fn utf8_valid_prefix_impl
+    = json_utf8_valid_prefix_init;
+static json_find_escape_utf8_fn find_escape_utf8_impl
+    = json_find_escape_utf8_init;
+
+// the kernels are picked by whichever thread first calls one; every thread
+// picks the same ones, so relaxed ordering is enough
+#if defined(__GNUC__)
+#define JSON_IMPL_LOAD(P)     __atomic_load_n (&(P), __ATOMIC_RELAXED)
+#define JSON_IMPL_STORE(P, V) __atomic_store_n (&(P), (V), __ATOMIC_RELAXED)
+#else
+#define JSON_IMPL_LOAD(P)     (P)
+#define JSON_IMPL_STORE(P, V) ((P) = (V))
+#endif
+
+static void
+json_simd_init (void)
+{
+#if defined(JSON_SIMD_X86)
+  __builtin_cpu_init ();
+
+  if (__builtin_cpu_supports ("avx2"))
+    {
+      JSON_IMPL_STORE (find_escape_impl, json_find_escape_avx2);
+      JSON_IMPL_STORE (find_comment_stop_impl, json_find_comment_stop_avx2);
+      JSON_IMPL_STORE (utf8_valid_prefix_impl, json_utf8_valid_prefix_avx2);
+      JSON_IMPL_STORE (find_escape_utf8_impl, json_find_escape_utf8_avx2);
+    }
+  else
+    {
+      JSON_IMPL_STORE (find_escape_impl, json_find_escape_sse2);
+      JSON_IMPL_STORE (find_comment_stop_impl, json_find_comment_stop_sse2);
+      JSON_IMPL_STORE (utf8_valid_prefix_impl, json_utf8_valid_prefix_sse2);
+      JSON_IMPL_STORE (find_escape_utf8_impl, json_find_escape_utf8_split);
+    }
+#elif defined(JSON_SIMD_NEON)
+  JSON_IMPL_STORE (find_escape_impl, json_find_escape_neon);
+  JSON_IMPL_STORE (find_comment_stop_impl, json_find_comment_stop_neon);
+  JSON_IMPL_STORE (utf8_valid_prefix_impl, json_utf8_valid_prefix_neon);
+  JSON_IMPL_STORE (find_escape_utf8_impl, json_find_escape_utf8_split);
+#else
+  JSON_IMPL_STORE (find_escape_impl, json_find_escape_scalar);
+  JSON_IMPL_STORE (find_comment_stop_impl, json_find_comment_stop_scalar);
+  JSON_IMPL_STORE (utf8_valid_prefix_impl, json_utf8_valid_prefix_scalar);
+  JSON_IMPL_STORE (find_escape_utf8_impl, json_find_escape_utf8_split);
+#endif
+}
+
+static jusize
+json_find_escape_init (const char *data, jusize size)
+{
+  json_simd_init ();
+
+  return JSON_IMPL_LOAD (find_escape_impl) (data, size);
+}
+
+static jusize
+json_find_comment_stop_init (const char *data, jusize size, json_bool block)
+{
+  json_simd_init ();
+
+  return JSON_IMPL_LOAD (find_comment_stop_impl) (data, size, block);
+}
+
+static jusize
+json_utf8_valid_prefix_init (const char *data, jusize size)
+{
+  json_simd_init ();
+
+  return JSON_IMPL_LOAD (utf8_valid_prefix_impl) (data, size);
+}
+
+static jusize
+json_find_escape_utf8_init (const char *data, jusize size, jusize *out_valid)
+{
+  json_simd_init ();
+
+  return JSON_IMPL_LOAD (find_escape_utf8_impl) (data, size, out_valid);
+}
+
+/**
+ * Used where the UTF-8 validator only skips ASCII a vector at a time, so
+ * there is nothing to gain from fusing it with the escape search.
+ */
+
+static jusize
+json_find_escape_utf8_split (const char *data, jusize size, jusize *out_valid)
+{
+  jusize run = JSON_IMPL_LOAD (find_escape_impl) (data, size);
+
+  *out_valid = JSON_IMPL_LOAD (utf8_valid_prefix_impl) (data, run);
+
+  return run;
+}
+
+jusize
+json_find_escape (const char *data, jusize size)
+{
+  return JSON_IMPL_LOAD (find_escape_impl) (data, size);
+}
+
+jusize
+json_find_comment_stop (const char *data, jusize size, json_bool block)
+{
+  return JSON_IMPL_LOAD (find_comment_stop_impl) (data, size, block);
+}
+
+jusize
+json_utf8_valid_prefix (const char *data, jusize size)
+{
+  return JSON_IMPL_LOAD (utf8_valid_prefix_impl) (data, size);
+}
+
+jusize
+json_find_escape_utf8 (const char *data, jusize size, jusize *out_valid)
+{
+  return JSON_IMPL_LOAD (find_escape_utf8_impl) (data, size, out_valid);
+}
+
+jusize
+json_narrow_ascii (char *dst, const char *src, jusize units, ju8 width,
+                   json_bool big_endian)
+{
+  // SSE2 and NEON are always there, and wider vectors would rarely fill up
+  // between the non-ASCII units of text that is not already UTF-8
+#if defined(JSON_SIMD_X86)
+  return json_narrow_ascii_sse2 (dst, src, units, width, big_endian);
+#elif defined(JSON_SIMD_NEON)
+  return json_narrow_ascii_neon (dst, src, units, width, big_endian);
+#else
+  return json_narrow_ascii_scalar (dst, src, units, width, big_endian);
+#endif
+}
@@ -0,0 +1,728 @@
+/*
+ * Copyright (c) 2025 Zachary Lamb
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "_internal.h"
+#include "json_types.h"
+
+#define JSON_SNAPSHOT_MAGIC      "JSNP"
+#define JSON_SNAPSHOT_VERSION    1
+#define JSON_SNAPSHOT_BYTE_ORDER 0x01020304
+
+#ifndef JSON_SNAPSHOT_BUF_SIZE
+#define JSON_SNAPSHOT_BUF_SIZE (1024 * 64)
+#endif
+
+#define JSON_SNAPSHOT_ALIGN(N) (((N) + 7) & ~(ju64) 7)
+
+/**
+ * Every reference in a snapshot is an offset relative to the address of the
+ * node or entry holding it, so a mapped image is usable wherever it lands.
+ * Numbers are stored in the byte order of the writer.
+ */
+
+struct json_snapshot_value
+{
+  ju8 type;
+  ju8 bool;
+  ju16 reserved;
+
+  // string length, or number of elements or members
+  ju32 len;
+
+  union
+  {
+    j64 offset;
+    json_number number;
+  } payload;
+};
+
+/**
+ * Object members are laid out like json_entry, followed by the same hash
+ * index for objects of at least JSON_OBJECT_INDEX_MIN_CAP members.
+ */
+
+typedef struct json_snapshot_entry
+{
+  j64 key;
+  ju32 key_len, hash;
+  json_snapshot_value value;
+} json_snapshot_entry;
+
+typedef struct json_snapshot_header
+{
+  char magic[4];
+  ju32 version, byte_order, reserved;
+  ju64 size;
+  json_snapshot_value root;
+} json_snapshot_header;
+
+struct json_snapshot
+{
+  json_allocator *allocator;
+  void *base;
+  jusize size;
+};
+
+#define JSON_SNAPSHOT_ITEM_STRING 0
+#define JSON_SNAPSHOT_ITEM_ARRAY  1
+#define JSON_SNAPSHOT_ITEM_OBJECT 2
+
+typedef struct json_snapshot_item
+{
+  ju8 kind;
+  const void *ptr;
+  jusize len;
+} json_snapshot_item;
+
+/**
+ * Blocks are reserved in the order their nodes are written and filled in
+ * the same order from a queue, so the image is written strictly front to
+ * back.
+ */
+
+typedef struct json_snapshot_writer
+{
+  json_allocator *allocator;
+  int fd;
+  ju64 pos, next;
+
+  json_snapshot_item *queue;
+  jusize head, tail, cap;
+
+  jusize len;
+  char buf[JSON_SNAPSHOT_BUF_SIZE];
+} json_snapshot_writer;
+
+static json_error
+json_snapshot_measure (json_value *value, ju64 *size)
+{
+  json_error error;
+
+  switch (value->type)
+    {
+    case JSON_VALUE_TYPE_OBJECT:
+      {
+        json_object *object = &value->value.object;
+
+        if (object->size > 0xFFFFFFFF)
+          return JSON_ERROR_ENCODING;
+
+        *size += object->size * sizeof (json_snapshot_entry)
+                 + json_object_index_cap (object->size) * sizeof (ju32);
+
+        for (jusize i = 0; i < object->size; ++i)
+          {
+            json_entry *entry = object->entries + i;
+
+            if (entry->key_len > 0xFFFFFFFF)
+              return JSON_ERROR_ENCODING;
+
+            *size += JSON_SNAPSHOT_ALIGN (entry->key_len + 1);
+
+            if ((error = json_snapshot_measure (&entry->value, size))
+                != JSON_ERROR_NONE)
+              return error;
+
+            // the value node itself is part of the entry
+            *size -= sizeof (json_snapshot_value);
+          }
+
+        break;
+      }
+    case JSON_VALUE_TYPE_ARRAY:
+      {
+        json_array *array = &value->value.array;
+        json_value tmp;
+
+        if (array->size > 0xFFFFFFFF)
+          return JSON_ERROR_ENCODING;
+
+        for (jusize i = 0; i < array->size; ++i)
+          if ((error = json_snapshot_measure (json_array_at (array, i, &tmp),
+                                              size))
+              != JSON_ERROR_NONE)
+            return error;
+
+        break;
+      }
+    case JSON_VALUE_TYPE_STRING:
+      if (value->value.string.len > 0xFFFFFFFF)
+        return JSON_ERROR_ENCODING;
+
+      *size += JSON_SNAPSHOT_ALIGN (value->value.string.len + 1);
+      break;
+    }
+
+  *size += sizeof (json_snapshot_value);
+
+  return JSON_ERROR_NONE;
+}
+
+static json_error
+json_snapshot_flush (json_snapshot_writer *writer)
+{
+  const char *p = writer->buf;
+  jusize len    = writer->len;
+
+  while (len)
+    {
+      ssize_t n = write (writer->fd, p, len);
+
+      if (n < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          return JSON_ERROR_IO;
+        }
+
+      p += n;
+      len -= n;
+    }
+
+  writer->len = 0;
+
+  return JSON_ERROR_NONE;
+}
+
+static json_error
+json_snapshot_put (json_snapshot_writer *writer, const void *data, jusize size)
+{
+  const char *p = data;
+  json_error error;
+
+  writer->pos += size;
+
+  while (size)
+    {
+      jusize n = JSON_SNAPSHOT_BUF_SIZE - writer->len;
+
+      if (n > size)
+        n = size;
+
+      memcpy (writer->buf + writer->len, p, n);
+      writer->len += n;
+      p += n;
+      size -= n;
+
+      if (writer->len == JSON_SNAPSHOT_BUF_SIZE
+          && (error = json_snapshot_flush (writer)) != JSON_ERROR_NONE)
+        return error;
+    }
+
+  return JSON_ERROR_NONE;
+}
+
+static json_error
+json_snapshot_pad (json_snapshot_writer *writer)
+{
+  static const char zeros[8] = { 0 };
+
+  return json_snapshot_put (writer, zeros,
+                            JSON_SNAPSHOT_ALIGN (writer->pos) - writer->pos);
+}
+
+/**
+ * Reserves a block of size bytes after every block reserved so far.
+ *
+ * @return - the offset of the block from the referencing node at pos
+ */
+
+static json_error
+json_snapshot_reserve (json_snapshot_writer *writer, ju8 kind,
+                       const void *ptr, jusize len, ju64 size, j64 *offset)
+{
+  if (writer->tail == writer->cap)
+    {
+      // compacting is only worth it once half of the queue is consumed
+      if (writer->head && writer->head >= writer->cap / 2)
+        {
+          memmove (writer->queue, writer->queue + writer->head,
+                   (writer->tail - writer->head)
+                       * sizeof (json_snapshot_item));
+          writer->tail -= writer->head;
+          writer->head = 0;
+        }
+
+      if (writer->tail == writer->cap)
+        {
+          jusize cap = writer->cap ? writer->cap * 2 : 64;
+          json_snapshot_item *queue = writer->allocator->json_realloc (
+              writer->queue, cap * sizeof (json_snapshot_item),
+              writer->allocator->ctx);
+
+          if (!queue)
+            return JSON_ERROR_NOMEM;
+
+          writer->queue = queue;
+          writer->cap   = cap;
+        }
+    }
+
+  writer->queue[writer->tail++]
+      = (json_snapshot_item) { .kind = kind, .ptr = ptr, .len = len };
+
+  *offset = (j64) (writer->next - writer->pos);
+  writer->next += JSON_SNAPSHOT_ALIGN (size);
+
+  return JSON_ERROR_NONE;
+}
+
+static json_error
+json_snapshot_put_node (json_snapshot_writer *writer, json_value *value)
+{
+  json_snapshot_value node = { .type = json_value_type_of (value) };
+  json_error error         = JSON_ERROR_NONE;
+
+  switch (value->type)
+    {
+    case JSON_VALUE_TYPE_OBJECT:
+      {
+        json_object *object = &value->value.object;
+
+        node.len = (ju32) object->size;
+
+        if (object->size)
+          error = json_snapshot_reserve (
+              writer, JSON_SNAPSHOT_ITEM_OBJECT, object, 0,
+              object->size * sizeof (json_snapshot_entry)
+                  + json_object_index_cap (object->size) * sizeof (ju32),
+              &node.payload.offset);
+        break;
+      }
+    case JSON_VALUE_TYPE_ARRAY:
+      {
+        json_array *array = &value->value.array;
+
+        node.len = (ju32) array->size;
+
+        if (array->size)
+          error = json_snapshot_reserve (
+              writer, JSON_SNAPSHOT_ITEM_ARRAY, array, 0,
+              array->size * sizeof (json_snapshot_value),
+              &node.payload.offset);
+        break;
+      }
+    case JSON_VALUE_TYPE_NUMBER:
+    case JSON_VALUE_TYPE_RAW_NUMBER:
+      node.payload.number = json_value_to_number (value);
+      break;
+    case JSON_VALUE_TYPE_STRING:
+      {
+        json_string *string = &value->value.string;
+
+        node.len = (ju32) string->len;
+        error    = json_snapshot_reserve (writer, JSON_SNAPSHOT_ITEM_STRING,
+                                          string->str, string->len,
+                                          string->len + 1,
+                                          &node.payload.offset);
+        break;
+      }
+    case JSON_VALUE_TYPE_BOOL:
+      node.bool = value->value.bool;
+      break;
+    }
+
+  if (error != JSON_ERROR_NONE)
+    return error;
+
+  return json_snapshot_put (writer, &node, sizeof (node));
+}
+
+static json_error
+json_snapshot_put_object (json_snapshot_writer *writer, json_object *object)
+{
+  jusize index_cap = json_object_index_cap (object->size);
+  json_error error;
+  ju32 *index;
+
+  for (jusize i = 0; i < object->size; ++i)
+    {
+      json_entry *entry              = object->entries + i;
+      json_snapshot_entry header     = { .key_len = (ju32) entry->key_len,
+                                         .hash    = entry->hash };
+
+      if ((error = json_snapshot_reserve (writer, JSON_SNAPSHOT_ITEM_STRING,
+                                          entry->key, entry->key_len,
+                                          entry->key_len + 1, &header.key))
+          != JSON_ERROR_NONE)
+        return error;
+
+      if ((error = json_snapshot_put (writer, &header,
+                                      offsetof (json_snapshot_entry, value)))
+              != JSON_ERROR_NONE
+          || (error = json_snapshot_put_node (writer, &entry->value))
+                 != JSON_ERROR_NONE)
+        return error;
+    }
+
+  if (!index_cap)
+    return JSON_ERROR_NONE;
+
+  if (!(index = writer->allocator->json_malloc (index_cap * sizeof (ju32),
+                                                writer->allocator->ctx)))
+    return JSON_ERROR_NOMEM;
+
+  memset (index, 0, index_cap * sizeof (ju32));
+
+  for (jusize i = 0; i < object->size; ++i)
+    {
+      jusize slot = object->entries[i].hash & (index_cap - 1);
+
+      while (index[slot])
+        slot = (slot + 1) & (index_cap - 1);
+
+      index[slot] = (ju32) (i + 1);
+    }
+
+  error = json_snapshot_put (writer, index, index_cap * sizeof (ju32));
+  writer->allocator->json_free (index, writer->allocator->ctx);
+
+  return error;
+}
+
+static json_error
+json_snapshot_put_item (json_snapshot_writer *writer, json_snapshot_item *item)
+{
+  json_error error;
+
+  switch (item->kind)
+    {
+    case JSON_SNAPSHOT_ITEM_STRING:
+      // the empty string may not be allocated
+      if ((error = json_snapshot_put (writer, item->len ? item->ptr : "",
+                                      item->len))
+              != JSON_ERROR_NONE
+          || (error = json_snapshot_put (writer, "", 1)) != JSON_ERROR_NONE)
+        return error;
+      break;
+    case JSON_SNAPSHOT_ITEM_ARRAY:
+      {
+        const json_array *array = item->ptr;
+        json_value tmp;
+
+        for (jusize i = 0; i < array->size; ++i)
+          if ((error = json_snapshot_put_node (writer,
+                                               json_array_at (array, i, &tmp)))
+              != JSON_ERROR_NONE)
+            return error;
+        break;
+      }
+    default:
+      if ((error = json_snapshot_put_object (writer, (json_object *) item->ptr))
+          != JSON_ERROR_NONE)
+        return error;
+      break;
+    }
+
+  return json_snapshot_pad (writer);
+}
+
+json_error
+json_snapshot_write_ext (json_allocator *allocator, json_value *value, int fd)
+{
+  json_snapshot_header header = {
+    .magic      = JSON_SNAPSHOT_MAGIC,
+    .version    = JSON_SNAPSHOT_VERSION,
+    .byte_order = JSON_SNAPSHOT_BYTE_ORDER,
+    .size       = offsetof (json_snapshot_header, root),
+  };
+  json_snapshot_writer *writer;
+  json_error error;
+
+  if ((error = json_snapshot_measure (value, &header.size)) != JSON_ERROR_NONE)
+    return error;
+
+  if (!(writer = allocator->json_malloc (sizeof (json_snapshot_writer),
+                                         allocator->ctx)))
+    return JSON_ERROR_NOMEM;
+
+  writer->allocator = allocator;
+  writer->fd        = fd;
+  writer->pos   = 0;
+  writer->next  = sizeof (json_snapshot_header);
+  writer->queue = NULL;
+  writer->head = writer->tail = writer->cap = 0;
+  writer->len                                = 0;
+
+  if ((error = json_snapshot_put (writer, &header,
+                                  offsetof (json_snapshot_header, root)))
+          != JSON_ERROR_NONE
+      || (error = json_snapshot_put_node (writer, value)) != JSON_ERROR_NONE)
+    goto end;
+
+  while (writer->head < writer->tail)
+    {
+      json_snapshot_item item = writer->queue[writer->head++];
+
+      if ((error = json_snapshot_put_item (writer, &item)) != JSON_ERROR_NONE)
+        goto end;
+    }
+
+  if (writer->pos != header.size)
+    {
+      error = JSON_ERROR_INTERNAL;
+      goto end;
+    }
+
+  error = json_snapshot_flush (writer);
+
+end:
+  if (writer->queue)
+    allocator->json_free (writer->queue, allocator->ctx);
+
+  allocator->json_free (writer, allocator->ctx);
+
+  return error;
+}
+
+json_error
+json_snapshot_write (json_value *value, int fd)
+{
+  return json_snapshot_write_ext (&std_allocator, value, fd);
+}
+
+json_error
+json_snapshot_open_ext (json_allocator *allocator, const char *path,
+                        json_snapshot **out_snapshot)
+{
+  const json_snapshot_header *header;
+  json_snapshot *snapshot;
+  struct stat st;
+  void *base;
+  int fd;
+
+  if ((fd = open (path, O_RDONLY)) < 0)
+    return JSON_ERROR_IO;
+
+  if (fstat (fd, &st) != 0)
+    {
+      close (fd);
+      return JSON_ERROR_IO;
+    }
+
+  if ((jusize) st.st_size < sizeof (json_snapshot_header))
+    {
+      close (fd);
+      return JSON_ERROR_BAD_SNAPSHOT;
+    }
+
+  base = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+
+  if (base == MAP_FAILED)
+    return JSON_ERROR_IO;
+
+  header = base;
+
+  if (memcmp (header->magic, JSON_SNAPSHOT_MAGIC, 4) != 0
+      || header->version != JSON_SNAPSHOT_VERSION
+      || header->byte_order != JSON_SNAPSHOT_BYTE_ORDER
+      || header->size != (ju64) st.st_size)
+    {
+      munmap (base, st.st_size);
+      return JSON_ERROR_BAD_SNAPSHOT;
+    }
+
+  if (!(snapshot = allocator->json_malloc (sizeof (json_snapshot),
+                                           allocator->ctx)))
+    {
+      munmap (base, st.st_size);
+      return JSON_ERROR_NOMEM;
+    }
+
+  snapshot->allocator = allocator;
+  snapshot->base      = base;
+  snapshot->size      = st.st_size;
+  *out_snapshot       = snapshot;
+
+  return JSON_ERROR_NONE;
+}
+
+json_error
+json_snapshot_open (const char *path, json_snapshot **out_snapshot)
+{
+  return json_snapshot_open_ext (&std_allocator, path, out_snapshot);
+}
+
+void
+json_snapshot_close (json_snapshot *snapshot)
+{
+  munmap (snapshot->base, snapshot->size);
+  snapshot->allocator->json_free (snapshot, snapshot->allocator->ctx);
+}
+
+const json_snapshot_value *
+json_snapshot_root (json_snapshot *snapshot)
+{
+  return &((const json_snapshot_header *) snapshot->base)->root;
+}
+
+static inline const void *
+json_snapshot_deref (const void *base, j64 offset)
+{
+  return (const char *) base + offset;
+}
+
+json_value_type
+json_snapshot_get_type (const json_snapshot_value *value)
+{
+  return value->type;
+}
+
+json_bool
+json_snapshot_get_number (const json_snapshot_value *value, json_number *n)
+{
+  if (value->type != JSON_VALUE_TYPE_NUMBER)
+    return JSON_FALSE;
+
+  *n = value->payload.number;
+  return JSON_TRUE;
+}
+
+json_bool
+json_snapshot_get_bool (const json_snapshot_value *value, json_bool *b)
+{
+  if (value->type != JSON_VALUE_TYPE_BOOL)
+    return JSON_FALSE;
+
+  *b = value->bool;
+  return JSON_TRUE;
+}
+
+json_bool
+json_snapshot_is_null (const json_snapshot_value *value)
+{
+  return value->type == JSON_VALUE_TYPE_NULL;
+}
+
+json_bool
+json_snapshot_get_string (const json_snapshot_value *value, const char **str,
+                          jusize *len)
+{
+  if (value->type != JSON_VALUE_TYPE_STRING)
+    return JSON_FALSE;
+
+  *str = json_snapshot_deref (value, value->payload.offset);
+
+  if (len)
+    *len = value->len;
+
+  return JSON_TRUE;
+}
+
+jusize
+json_snapshot_size (const json_snapshot_value *value)
+{
+  if (value->type != JSON_VALUE_TYPE_OBJECT
+      && value->type != JSON_VALUE_TYPE_ARRAY)
+    return 0;
+
+  return value->len;
+}
+
+const json_snapshot_value *
+json_snapshot_array_get (const json_snapshot_value *array, jusize index)
+{
+  if (array->type != JSON_VALUE_TYPE_ARRAY || index >= array->len)
+    return NULL;
+
+  return (const json_snapshot_value *) json_snapshot_deref (
+             array, array->payload.offset)
+         + index;
+}
+
+const json_snapshot_value *
+json_snapshot_object_at (const json_snapshot_value *object, jusize index,
+                         const char **key, jusize *key_len)
+{
+  const json_snapshot_entry *entry;
+
+  if (object->type != JSON_VALUE_TYPE_OBJECT || index >= object->len)
+    return NULL;
+
+  entry = (const json_snapshot_entry *) json_snapshot_deref (
+              object, object->payload.offset)
+          + index;
+
+  if (key)
+    *key = json_snapshot_deref (entry, entry->key);
+
+  if (key_len)
+    *key_len = entry->key_len;
+
+  return &entry->value;
+}
+
+const json_snapshot_value *
+json_snapshot_object_get (const json_snapshot_value *object, const char *key)
+{
+  const json_snapshot_entry *entries, *entry;
+  jusize key_len, index_cap;
+  const ju32 *index;
+  ju32 hash;
+
+  if (object->type != JSON_VALUE_TYPE_OBJECT || !object->len)
+    return NULL;
+
+  entries   = json_snapshot_deref (object, object->payload.offset);
+  key_len   = strlen (key);
+  hash      = json_hash_key (key, key_len);
+  index_cap = json_object_index_cap (object->len);
+
+#define JSON_SNAPSHOT_ENTRY_MATCHES(ENTRY)                                    \
+  ((ENTRY)->hash == hash && (ENTRY)->key_len == key_len                       \
+   && memcmp (json_snapshot_deref ((ENTRY), (ENTRY)->key), key, key_len) == 0)
+
+  if (!index_cap)
+    {
+      for (jusize i = 0; i < object->len; ++i)
+        if (JSON_SNAPSHOT_ENTRY_MATCHES (entries + i))
+          return &entries[i].value;
+
+      return NULL;
+    }
+
+  index = (const ju32 *) (entries + object->len);
+
+  for (jusize slot = hash & (index_cap - 1); index[slot];
+       slot        = (slot + 1) & (index_cap - 1))
+    {
+      entry = entries + (index[slot] - 1);
+
+      if (JSON_SNAPSHOT_ENTRY_MATCHES (entry))
+        return &entry->value;
+    }
+
+#undef JSON_SNAPSHOT_ENTRY_MATCHES
+
+  return NULL;
+}
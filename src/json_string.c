@@ -20,4 +20,906 @@
  * IN THE SOFTWARE.
  */
 
+#include <string.h>
+
 #include "_internal.h"
+#include "json_types.h"
+
+#ifndef JSON_STRING_INIT_CAP
+#define JSON_STRING_INIT_CAP 16
+#endif
+
+#ifndef JSON_STRING_GROWTH_FACTOR
+#define JSON_STRING_GROWTH_FACTOR 2
+#endif
+
+json_error
+json_buf_encode_char32 (char *buf, jusize size, jchar32 cp, ju8 *out_len)
+{
+  ju8 len;
+
+  if (cp < 0x80)
+    len = 1;
+  else if (cp < 0x800)
+    len = 2;
+  else if (cp < 0x10000)
+    {
+      if (cp >= 0xD800 && cp <= 0xDFFF)
+        return JSON_ERROR_ENCODING;
+
+      len = 3;
+    }
+  else if (cp < 0x110000)
+    len = 4;
+  else
+    return JSON_ERROR_ENCODING;
+
+  if (size < len)
+    return JSON_ERROR_BUF_LEN;
+
+  switch (len)
+    {
+    case 1:
+      buf[0] = (char) cp;
+      break;
+    case 2:
+      buf[0] = (char) (0xC0 | (cp >> 6));
+      buf[1] = (char) (0x80 | (cp & 0x3F));
+      break;
+    case 3:
+      buf[0] = (char) (0xE0 | (cp >> 12));
+      buf[1] = (char) (0x80 | ((cp >> 6) & 0x3F));
+      buf[2] = (char) (0x80 | (cp & 0x3F));
+      break;
+    default:
+      buf[0] = (char) (0xF0 | (cp >> 18));
+      buf[1] = (char) (0x80 | ((cp >> 12) & 0x3F));
+      buf[2] = (char) (0x80 | ((cp >> 6) & 0x3F));
+      buf[3] = (char) (0x80 | (cp & 0x3F));
+      break;
+    }
+
+  if (out_len)
+    *out_len = len;
+
+  return JSON_ERROR_NONE;
+}
+
+json_error
+json_buf_decode_char32 (const char *buf, jusize size, jchar32 *out_cp,
+                        ju8 *out_len)
+{
+  const ju8 *p = (const ju8 *) buf;
+  ju8 len, lo = 0x80, hi = 0xBF, i = 1;
+  json_error error = JSON_ERROR_NONE;
+  jchar32 cp;
+
+  if (!size)
+    {
+      len   = 0;
+      error = JSON_ERROR_BUF_LEN;
+      goto end;
+    }
+
+  // the second byte range rules out overlong forms, surrogates and code
+  // points above U+10FFFF
+  if (p[0] < 0x80)
+    {
+      len = 1;
+      cp  = p[0];
+    }
+  else if (p[0] >= 0xC2 && p[0] <= 0xDF)
+    {
+      len = 2;
+      cp  = p[0] & 0x1F;
+    }
+  else if (p[0] >= 0xE0 && p[0] <= 0xEF)
+    {
+      len = 3;
+      cp  = p[0] & 0x0F;
+      lo  = p[0] == 0xE0 ? 0xA0 : 0x80;
+      hi  = p[0] == 0xED ? 0x9F : 0xBF;
+    }
+  else if (p[0] >= 0xF0 && p[0] <= 0xF4)
+    {
+      len = 4;
+      cp  = p[0] & 0x07;
+      lo  = p[0] == 0xF0 ? 0x90 : 0x80;
+      hi  = p[0] == 0xF4 ? 0x8F : 0xBF;
+    }
+  else
+    {
+      len   = 1;
+      error = JSON_ERROR_DECODING;
+      goto end;
+    }
+
+  for (; i < len; ++i)
+    {
+      if (i == size || p[i] < lo || p[i] > hi)
+        {
+          error = i == size ? JSON_ERROR_BUF_LEN : JSON_ERROR_DECODING;
+          len   = i;
+          goto end;
+        }
+
+      cp = (cp << 6) | (p[i] & 0x3F);
+      lo = 0x80;
+      hi = 0xBF;
+    }
+
+  if (out_cp)
+    *out_cp = cp;
+
+end:
+  if (out_len)
+    *out_len = len;
+
+  return error;
+}
+
+/**
+ * Ensures str can hold len bytes plus a NUL terminator.
+ */
+
+static json_error
+json_string_reserve_ext (json_allocator *allocator, json_string *str,
+                         jusize len)
+{
+  jusize cap = str->cap;
+  char *tmp;
+
+  if (cap > len)
+    return JSON_ERROR_NONE;
+
+  if (!cap)
+    cap = JSON_STRING_INIT_CAP;
+
+  while (cap <= len)
+    cap *= JSON_STRING_GROWTH_FACTOR;
+
+  tmp = json_storage_realloc (allocator, str->str, str->cap, str->len + 1,
+                              cap);
+
+  if (!tmp)
+    return JSON_ERROR_NOMEM;
+
+  str->str = tmp;
+  str->cap = cap;
+
+  return JSON_ERROR_NONE;
+}
+
+json_error
+json_string_init_ext (json_allocator *allocator, json_string *str,
+                      const char *buf, jusize size)
+{
+  char *tmp = allocator->json_malloc (size + 1, allocator->ctx);
+
+  if (!tmp)
+    return JSON_ERROR_NOMEM;
+
+  memcpy (tmp, buf, size);
+  tmp[size] = '\0';
+
+  str->len = size;
+  str->cap = size + 1;
+  str->str = tmp;
+
+  return JSON_ERROR_NONE;
+}
+
+json_string *
+json_string_create_ext (json_allocator *allocator)
+{
+  json_string *str
+      = allocator->json_malloc (sizeof (json_string), allocator->ctx);
+
+  if (!str)
+    return NULL;
+
+  str->len = 0;
+  str->cap = 0;
+  str->str = NULL;
+
+  return str;
+}
+
+json_string *
+json_string_create (void)
+{
+  return json_string_create_ext (&std_allocator);
+}
+
+json_error
+json_string_from_c_str_ext (json_allocator *allocator, const char *str,
+                            json_string **out_str)
+{
+  json_string *tmp = json_string_create_ext (allocator);
+  json_error error;
+
+  if (!tmp)
+    return JSON_ERROR_NOMEM;
+
+  if ((error = json_string_append_from_buf_ext (allocator, tmp, str,
+                                                strlen (str)))
+      != JSON_ERROR_NONE)
+    {
+      json_string_free_ext (allocator, tmp);
+      return error;
+    }
+
+  *out_str = tmp;
+  return JSON_ERROR_NONE;
+}
+
+json_error
+json_string_from_c_str (const char *str, json_string **out_str)
+{
+  return json_string_from_c_str_ext (&std_allocator, str, out_str);
+}
+
+jusize
+json_string_length (json_string *str)
+{
+  return str->len;
+}
+
+char *
+json_string_c_str (json_string *str)
+{
+  static char empty[1];
+  return str->str ? str->str : empty;
+}
+
+json_error
+json_string_clone_ext (json_allocator *allocator, json_string *str,
+                       json_string **out_str)
+{
+  json_string *tmp = json_string_create_ext (allocator);
+  json_error error;
+
+  if (!tmp)
+    return JSON_ERROR_NOMEM;
+
+  if ((error
+       = json_string_append_from_buf_ext (allocator, tmp, str->str, str->len))
+      != JSON_ERROR_NONE)
+    {
+      json_string_free_ext (allocator, tmp);
+      return error;
+    }
+
+  *out_str = tmp;
+  return JSON_ERROR_NONE;
+}
+
+json_error
+json_string_clone (json_string *str, json_string **out_str)
+{
+  return json_string_clone_ext (&std_allocator, str, out_str);
+}
+
+json_error
+json_string_append_ext (json_allocator *allocator, json_string *str,
+                        jchar32 cp)
+{
+  char tmp[4];
+  ju8 len;
+  json_error error;
+
+  if ((error = json_buf_encode_char32 (tmp, sizeof (tmp), cp, &len))
+      != JSON_ERROR_NONE)
+    return error;
+
+  return json_string_append_from_buf_ext (allocator, str, tmp, len);
+}
+
+json_error
+json_string_append (json_string *str, jchar32 cp)
+{
+  return json_string_append_ext (&std_allocator, str, cp);
+}
+
+json_error
+json_string_append_from_buf_ext (json_allocator *allocator, json_string *str,
+                                 const char *buf, jusize size)
+{
+  json_error error;
+
+  if ((error = json_string_reserve_ext (allocator, str, str->len + size))
+      != JSON_ERROR_NONE)
+    return error;
+
+  memcpy (str->str + str->len, buf, size);
+  str->len += size;
+  str->str[str->len] = '\0';
+
+  return JSON_ERROR_NONE;
+}
+
+json_error
+json_string_append_from_buf (json_string *str, const char *buf, jusize size)
+{
+  return json_string_append_from_buf_ext (&std_allocator, str, buf, size);
+}
+
+void
+json_string_clear_ext (json_allocator *allocator, json_string *string,
+                       json_bool deallocate)
+{
+  string->len = 0;
+
+  if (deallocate)
+    {
+      json_storage_free (allocator, string->str, string->cap);
+      string->str = NULL;
+      string->cap = 0;
+    }
+  else if (string->str)
+    string->str[0] = '\0';
+}
+
+void
+json_string_clear (json_string *string, json_bool deallocate)
+{
+  json_string_clear_ext (&std_allocator, string, deallocate);
+}
+
+void
+json_string_free_ext (json_allocator *allocator, json_string *str)
+{
+  json_string_clear_ext (allocator, str, JSON_TRUE);
+  allocator->json_free (str, allocator->ctx);
+}
+
+void
+json_string_free (json_string *str)
+{
+  json_string_free_ext (&std_allocator, str);
+}
+
+void
+json_escape_string (const char *str, jusize len, json_emit_fn emit, void *ctx)
+{
+  static const char hex_digits[] = "0123456789abcdef";
+
+  while (len)
+    {
+      jusize run = json_find_escape (str, len);
+      char tmp[6];
+      ju8 ch;
+
+      if (run)
+        {
+          emit (str, run, ctx);
+
+          str += run;
+          len -= run;
+
+          if (!len)
+            break;
+        }
+
+      ch = (ju8) str[0];
+
+      tmp[0] = 0x5C;
+      tmp[1] = 0x75;
+
+      switch (ch)
+        {
+        case 0x22:
+        case 0x5C:
+          tmp[1] = ch;
+          break;
+        case 0x08:
+          tmp[1] = 0x62;
+          break;
+        case 0x0C:
+          tmp[1] = 0x66;
+          break;
+        case 0x0A:
+          tmp[1] = 0x6E;
+          break;
+        case 0x0D:
+          tmp[1] = 0x72;
+          break;
+        case 0x09:
+          tmp[1] = 0x74;
+          break;
+        default:
+          tmp[2] = 0x30;
+          tmp[3] = 0x30;
+          tmp[4] = hex_digits[ch >> 4];
+          tmp[5] = hex_digits[ch & 0xF];
+          break;
+        }
+
+      emit (tmp, tmp[1] == 0x75 ? 6 : 2, ctx);
+
+      ++str;
+      --len;
+    }
+}
+
+static inline json_error
+json_decode_hex4 (buffer *buf, jchar32 *out_cp)
+{
+  jchar32 cp = 0;
+  int i, tmp;
+
+  for (i = 0; i < 4; ++i)
+    {
+      if (!buf->size || (tmp = get_hex_digit (buf->data[0])) < 0)
+        return JSON_ERROR_BAD_ESCAPE;
+
+      cp = cp * 16 + tmp;
+
+      BUF_ADVANCE_COL (buf);
+    }
+
+  *out_cp = cp;
+  return JSON_ERROR_NONE;
+}
+
+/**
+ * Decodes the code point of a \u escape, combining surrogate pairs. The
+ * buffer must point just past the 'u'. Lone surrogates become U+FFFD with
+ * JSON_EXT_UNICODE_REPLACEMENT and are an error otherwise.
+ */
+
+static json_error
+json_decode_escape_u (json_decoder *decoder, buffer *buf, jchar32 *out_cp)
+{
+  jchar32 cp, low;
+  json_error error;
+
+  if ((error = json_decode_hex4 (buf, &cp)) != JSON_ERROR_NONE)
+    return error;
+
+  if (cp >= 0xD800 && cp <= 0xDBFF && buf->size >= 2
+      && buf->data[0] == 0x5C && buf->data[1] == 0x75)
+    {
+      buffer tmp = *buf;
+
+      tmp.data += 2;
+      tmp.size -= 2;
+      tmp.col += 2;
+
+      if ((error = json_decode_hex4 (&tmp, &low)) != JSON_ERROR_NONE)
+        return error;
+
+      // a high surrogate followed by anything but a low surrogate leaves the
+      // second escape to be decoded on its own
+      if (low >= 0xDC00 && low <= 0xDFFF)
+        {
+          *buf    = tmp;
+          *out_cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+          return JSON_ERROR_NONE;
+        }
+    }
+
+  if (cp >= 0xD800 && cp <= 0xDFFF)
+    {
+      if (!(decoder->ext_flags & JSON_EXT_UNICODE_REPLACEMENT))
+        return JSON_ERROR_BAD_ESCAPE;
+
+      cp = 0xFFFD;
+    }
+
+  *out_cp = cp;
+  return JSON_ERROR_NONE;
+}
+
+/**
+ * Handles the invalid UTF-8 sequence at the start of the size bytes of buf,
+ * which must be the rest of a run without escapes. With
+ * JSON_EXT_UNICODE_REPLACEMENT the sequence is skipped and, if string is not
+ * NULL, U+FFFD is appended in its place.
+ *
+ * @return - JSON_ERROR_BAD_UTF8 if the extension is not enabled, leaving buf
+ * at the sequence
+ */
+
+static json_error
+json_replace_utf8 (json_decoder *decoder, json_string *string, buffer *buf,
+                   jusize size)
+{
+  json_error error;
+  ju8 len;
+
+  if (!(decoder->ext_flags & JSON_EXT_UNICODE_REPLACEMENT))
+    return JSON_ERROR_BAD_UTF8;
+
+  json_buf_decode_char32 (buf->data, size, NULL, &len);
+
+  if (string
+      && (error = json_string_append_ext (decoder->allocator, string, 0xFFFD))
+             != JSON_ERROR_NONE)
+    return error;
+
+  buf->data += len;
+  buf->size -= len;
+  buf->col += len;
+
+  return JSON_ERROR_NONE;
+}
+
+json_error
+json_scan_string (json_decoder *decoder, buffer *buf)
+{
+  json_error error;
+  jchar32 cp;
+
+  BUF_ADVANCE_COL (buf);
+
+  while (buf->size)
+    {
+      jusize valid;
+      jusize run = json_find_escape_utf8 (buf->data, buf->size, &valid);
+      ju8 ch;
+
+      buf->data += valid;
+      buf->size -= valid;
+      buf->col += valid;
+
+      if (valid < run)
+        {
+          if ((error = json_replace_utf8 (decoder, NULL, buf, run - valid))
+              != JSON_ERROR_NONE)
+            return error;
+
+          continue;
+        }
+
+      if (!buf->size)
+        break;
+
+      ch = buf->data[0];
+
+      if (ch == 0x22)
+        {
+          BUF_ADVANCE_COL (buf);
+          return JSON_ERROR_NONE;
+        }
+
+      if (ch != 0x5C)
+        return JSON_ERROR_BAD_STRING;
+
+      BUF_ADVANCE_COL (buf);
+
+      if (!buf->size)
+        break;
+
+      switch (buf->data[0])
+        {
+        case 0x22:
+        case 0x2F:
+        case 0x5C:
+        case 0x62:
+        case 0x66:
+        case 0x6E:
+        case 0x72:
+        case 0x74:
+          BUF_ADVANCE_COL (buf);
+          break;
+        case 0x75:
+          BUF_ADVANCE_COL (buf);
+
+          if ((error = json_decode_escape_u (decoder, buf, &cp))
+              != JSON_ERROR_NONE)
+            return error;
+
+          break;
+        default:
+          return JSON_ERROR_BAD_ESCAPE;
+        }
+    }
+
+  return JSON_ERROR_UNCLOSED_STR;
+}
+
+json_error
+json_decode_string (json_decoder *decoder, json_value *value, buffer *buf)
+{
+  json_string string = { 0 };
+  json_error error   = JSON_ERROR_UNCLOSED_STR;
+  jchar32 cp;
+
+  BUF_ADVANCE_COL (buf);
+
+  while (buf->size)
+    {
+      jusize valid;
+      jusize run = json_find_escape_utf8 (buf->data, buf->size, &valid);
+      ju8 ch;
+
+      if (run)
+        {
+          if (valid
+              && (error = json_string_append_from_buf_ext (
+                      decoder->allocator, &string, buf->data, valid))
+                     != JSON_ERROR_NONE)
+            goto fail;
+
+          buf->data += valid;
+          buf->size -= valid;
+          buf->col += valid;
+
+          if (valid < run)
+            {
+              if ((error = json_replace_utf8 (decoder, &string, buf,
+                                              run - valid))
+                  != JSON_ERROR_NONE)
+                goto fail;
+
+              error = JSON_ERROR_UNCLOSED_STR;
+              continue;
+            }
+
+          error = JSON_ERROR_UNCLOSED_STR;
+
+          if (!buf->size)
+            break;
+        }
+
+      ch = buf->data[0];
+
+      if (ch == 0x22)
+        {
+          BUF_ADVANCE_COL (buf);
+
+          value->type         = JSON_VALUE_TYPE_STRING;
+          value->value.string = string;
+
+          return JSON_ERROR_NONE;
+        }
+
+      if (ch != 0x5C)
+        {
+          error = JSON_ERROR_BAD_STRING;
+          goto fail;
+        }
+
+      BUF_ADVANCE_COL (buf);
+
+      if (!buf->size)
+        break;
+
+      switch (buf->data[0])
+        {
+        case 0x22:
+        case 0x2F:
+        case 0x5C:
+          cp = buf->data[0];
+          break;
+        case 0x62:
+          cp = 0x08;
+          break;
+        case 0x66:
+          cp = 0x0C;
+          break;
+        case 0x6E:
+          cp = 0x0A;
+          break;
+        case 0x72:
+          cp = 0x0D;
+          break;
+        case 0x74:
+          cp = 0x09;
+          break;
+        case 0x75:
+          BUF_ADVANCE_COL (buf);
+
+          if ((error = json_decode_escape_u (decoder, buf, &cp))
+              != JSON_ERROR_NONE)
+            goto fail;
+
+          goto append;
+        default:
+          error = JSON_ERROR_BAD_ESCAPE;
+          goto fail;
+        }
+
+      BUF_ADVANCE_COL (buf);
+
+    append:
+      if ((error = json_string_append_ext (decoder->allocator, &string, cp))
+          != JSON_ERROR_NONE)
+        goto fail;
+
+      error = JSON_ERROR_UNCLOSED_STR;
+    }
+
+fail:
+  json_string_clear_ext (decoder->allocator, &string, JSON_TRUE);
+  return error;
+}
+
+json_encoding
+json_detect_encoding (const char *data, jusize size, ju32 ext_flags,
+                      jusize *out_bom)
+{
+  const ju8 *p = (const ju8 *) data;
+
+  *out_bom = 0;
+
+  if (ext_flags & JSON_EXT_IGNORE_BOM)
+    {
+      // a UTF-32LE marker starts like a UTF-16LE one, but no JSON text
+      // starts with U+0000
+      if (size >= 4 && p[0] == 0xFF && p[1] == 0xFE && !p[2] && !p[3])
+        {
+          *out_bom = 4;
+          return JSON_ENCODING_UTF32LE;
+        }
+
+      if (size >= 4 && !p[0] && !p[1] && p[2] == 0xFE && p[3] == 0xFF)
+        {
+          *out_bom = 4;
+          return JSON_ENCODING_UTF32BE;
+        }
+
+      if (size >= 3 && p[0] == 0xEF && p[1] == 0xBB && p[2] == 0xBF)
+        {
+          *out_bom = 3;
+          return JSON_ENCODING_UTF8;
+        }
+
+      if (size >= 2 && p[0] == 0xFF && p[1] == 0xFE)
+        {
+          *out_bom = 2;
+          return JSON_ENCODING_UTF16LE;
+        }
+
+      if (size >= 2 && p[0] == 0xFE && p[1] == 0xFF)
+        {
+          *out_bom = 2;
+          return JSON_ENCODING_UTF16BE;
+        }
+    }
+
+  if (!(ext_flags & JSON_EXT_DETECT_ENCODING) || size < 2)
+    return JSON_ENCODING_UTF8;
+
+  // the first character of a JSON text is ASCII, so the zero bytes around it
+  // give away the width and byte order of its code units
+  if (size >= 4 && !p[0] && !p[1] && !p[2] && p[3])
+    return JSON_ENCODING_UTF32BE;
+
+  if (size >= 4 && p[0] && !p[1] && !p[2] && !p[3])
+    return JSON_ENCODING_UTF32LE;
+
+  if (!p[0] && p[1])
+    return JSON_ENCODING_UTF16BE;
+
+  if (p[0] && !p[1])
+    return JSON_ENCODING_UTF16LE;
+
+  return JSON_ENCODING_UTF8;
+}
+
+static JSON_ALWAYS_INLINE jchar32
+json_read_unit (const ju8 *p, ju8 width, json_bool big_endian)
+{
+  if (width == 2)
+    return big_endian ? (jchar32) p[0] << 8 | p[1]
+                      : (jchar32) p[1] << 8 | p[0];
+
+  return big_endian ? (jchar32) p[0] << 24 | (jchar32) p[1] << 16
+                          | (jchar32) p[2] << 8 | p[3]
+                    : (jchar32) p[3] << 24 | (jchar32) p[2] << 16
+                          | (jchar32) p[1] << 8 | p[0];
+}
+
+json_error
+json_transcode_utf8 (json_allocator *allocator, json_encoding encoding,
+                     ju32 ext_flags, const char *data, jusize size,
+                     char **text_buf, jusize *text_cap, jusize *out_size,
+                     jusize *out_pos)
+{
+  const ju8 *p = (const ju8 *) data;
+  ju8 width    = encoding >= JSON_ENCODING_UTF32LE ? 4 : 2;
+  json_bool be = encoding == JSON_ENCODING_UTF16BE
+                 || encoding == JSON_ENCODING_UTF32BE;
+  json_bool replace = !!(ext_flags & JSON_EXT_UNICODE_REPLACEMENT);
+  jusize cap = *text_cap, len = 0, i = 0;
+  char *text = *text_buf, *tmp;
+  json_error error;
+
+  // ASCII text narrows to one byte per unit, which is the usual case; the
+  // buffer only grows if there is more
+  if (cap < size / width + 16)
+    {
+      cap = size / width + 16;
+
+      if (!(tmp = allocator->json_realloc (text, cap, allocator->ctx)))
+        return JSON_ERROR_NOMEM;
+
+      *text_buf = text = tmp;
+      *text_cap = cap;
+    }
+
+  while (i < size)
+    {
+      jusize units = (size - i) / width, n;
+      jchar32 cp;
+      ju8 cp_len;
+
+      // room for the longest UTF-8 sequence
+      if (cap - len < 4)
+        {
+          jusize new_cap = cap + cap / 2 + 4;
+
+          if (!(tmp = allocator->json_realloc (text, new_cap, allocator->ctx)))
+            {
+              error = JSON_ERROR_NOMEM;
+              goto fail;
+            }
+
+          *text_buf = text = tmp;
+          *text_cap = cap = new_cap;
+        }
+
+      n = json_narrow_ascii (text + len, data + i,
+                             units < cap - len ? units : cap - len, width, be);
+      len += n;
+      i += n * width;
+
+      // the buffer may have filled up before a unit that is not ASCII
+      if (i == size || cap - len < 4)
+        continue;
+
+      if (size - i < width)
+        {
+          // a truncated unit at the end
+          cp = 0xFFFD;
+          i  = size;
+
+          if (!replace)
+            {
+              error = JSON_ERROR_BAD_ENCODING;
+              goto fail;
+            }
+        }
+      else
+        {
+          cp = json_read_unit (p + i, width, be);
+
+          if (width == 2 && cp >= 0xD800 && cp <= 0xDBFF && size - i >= 4)
+            {
+              jchar32 low = json_read_unit (p + i + 2, width, be);
+
+              if (low >= 0xDC00 && low <= 0xDFFF)
+                {
+                  cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                  i += 2;
+                }
+            }
+
+          if ((cp >= 0xD800 && cp <= 0xDFFF) || cp > 0x10FFFF)
+            {
+              if (!replace)
+                {
+                  error = JSON_ERROR_BAD_ENCODING;
+                  goto fail;
+                }
+
+              cp = 0xFFFD;
+            }
+
+          i += width;
+        }
+
+      json_buf_encode_char32 (text + len, cap - len, cp, &cp_len);
+      len += cp_len;
+    }
+
+  *out_size = len;
+
+  return JSON_ERROR_NONE;
+
+fail:
+  *out_pos = i;
+  return error;
+}
@@ -22,6 +22,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "_internal.h"
 #include "json.h"
@@ -30,105 +31,632 @@
 json_bool
 json_value_get_number (json_value *value, json_number *n)
 {
-  if (value->type != JSON_VALUE_TYPE_NUMBER)
+  if (json_value_type_of (value) != JSON_VALUE_TYPE_NUMBER)
     return JSON_FALSE;
 
-  *n = value->value.number;
+  *n = json_value_to_number (value);
   return JSON_TRUE;
 }
 
-json_error
-json_value_snprint (char *strp, jusize max_len, json_value *value,
-                    jusize *real_len)
+json_value *
+json_value_create_ext (json_allocator *allocator)
 {
-  jusize _real_len = 0;
-  int tmp;
-
-#define HANDLE_MAXLEN(LEN)                                                    \
-  if (max_len > (LEN))                                                        \
-    {                                                                         \
-      max_len -= (LEN);                                                       \
-      strp += (LEN);                                                          \
-    }                                                                         \
-  else if (max_len)                                                           \
-    {                                                                         \
-      strp += max_len;                                                        \
-      max_len = 0;                                                            \
-    }
+  json_value *value
+      = allocator->json_malloc (sizeof (json_value), allocator->ctx);
+
+  if (!value)
+    return NULL;
+
+  value->type = JSON_VALUE_TYPE_NULL;
+
+  return value;
+}
+
+json_value *
+json_value_create (void)
+{
+  return json_value_create_ext (&std_allocator);
+}
+
+/**
+ * Measures the storage below value: containers in the returned node bytes and
+ * strings and keys in chars.
+ */
+
+static jusize
+json_value_clone_measure (json_value *value, jusize *chars)
+{
+  jusize nodes = 0;
 
   switch (value->type)
     {
+    case JSON_VALUE_TYPE_OBJECT:
+      {
+        json_object *object = &value->value.object;
+
+        if (!object->size)
+          break;
+
+        nodes += object->size * sizeof (json_entry)
+                 + json_object_index_cap (object->size) * sizeof (ju32);
+
+        for (jusize i = 0; i < object->size; ++i)
+          {
+            *chars += object->entries[i].key_len + 1;
+            nodes += json_value_clone_measure (&object->entries[i].value,
+                                               chars);
+          }
+
+        break;
+      }
     case JSON_VALUE_TYPE_ARRAY:
       {
-        json_array array = value->value.array;
+        json_array *array = &value->value.array;
+
+        // packed elements are copied as they are, padded to keep the nodes
+        // after them aligned
+        if (array->kind != JSON_ARRAY_VALUES)
+          {
+            if (array->size)
+              nodes += json_packed_node_size (array);
+
+            break;
+          }
+
+        nodes += array->size * sizeof (json_value);
+
+        for (jusize i = 0; i < array->size; ++i)
+          nodes += json_value_clone_measure (array->elements + i, chars);
+
+        break;
+      }
+    case JSON_VALUE_TYPE_STRING:
+      if (value->value.string.str)
+        *chars += value->value.string.len + 1;
+      break;
+    }
+
+  return nodes;
+}
+
+/**
+ * Copies src into dst, taking storage from the clone block in depth-first
+ * order. All copied storage is marked block-owned. Packed arrays keep
+ * allocator to unpack into.
+ */
+
+static void
+json_value_clone_copy (json_allocator *allocator, json_value *dst,
+                       json_value *src, char **nodes, char **chars)
+{
+  *dst = *src;
+
+  switch (src->type)
+    {
+    case JSON_VALUE_TYPE_OBJECT:
+      {
+        json_object *from = &src->value.object;
+        json_object *to   = &dst->value.object;
 
-        tmp = snprintf (strp, max_len, "[");
+        if (!from->size)
+          {
+            memset (to, 0, sizeof (json_object));
+            break;
+          }
 
-        if (tmp < 0)
-          return JSON_ERROR_INTERNAL;
+        to->entries = (json_entry *) *nodes;
+        to->cap     = 0;
+        *nodes += from->size * sizeof (json_entry)
+                  + json_object_index_cap (from->size) * sizeof (ju32);
 
-        _real_len += tmp;
+        for (jusize i = 0; i < from->size; ++i)
+          {
+            json_entry *entry = to->entries + i;
+
+            entry->key     = *chars;
+            entry->key_len = from->entries[i].key_len;
+            entry->hash    = from->entries[i].hash;
+
+            memcpy (*chars, from->entries[i].key, entry->key_len + 1);
+            *chars += entry->key_len + 1;
+
+            json_value_clone_copy (allocator, &entry->value,
+                                   &from->entries[i].value,
+                                   nodes, chars);
+          }
 
-        HANDLE_MAXLEN ((ju32) tmp);
+        json_object_reindex (to);
+        break;
+      }
+    case JSON_VALUE_TYPE_ARRAY:
+      {
+        json_array *from = &src->value.array;
+        json_array *to   = &dst->value.array;
 
-        for (jusize i = 0; i < array.size; ++i)
+        if (!from->size)
           {
-            jusize tmplen;
-            json_error error = json_value_snprint (
-                strp, max_len, array.elements + i, &tmplen);
+            memset (to, 0, sizeof (json_array));
+            break;
+          }
 
-            if (error != JSON_ERROR_NONE)
-              return error;
+        to->cap = 0;
 
-            _real_len += tmplen;
+        if (from->kind != JSON_ARRAY_VALUES)
+          {
+            json_packed_head *head = (json_packed_head *) *nodes;
+
+            head->allocator = allocator;
+            to->elements    = (json_value *) (void *) (head + 1);
+            memcpy (to->elements, from->elements,
+                    json_packed_size (from->kind, from->size)
+                        - sizeof (json_packed_head));
+            *nodes += json_packed_node_size (from);
+            break;
+          }
 
-            HANDLE_MAXLEN (tmplen);
+        to->elements = (json_value *) *nodes;
+        *nodes += from->size * sizeof (json_value);
 
-            if (i != array.size - 1)
-              {
-                tmp = snprintf (strp, max_len, ", ");
+        for (jusize i = 0; i < from->size; ++i)
+          json_value_clone_copy (allocator, to->elements + i,
+                                 from->elements + i, nodes, chars);
+
+        break;
+      }
+    case JSON_VALUE_TYPE_STRING:
+      {
+        json_string *to = &dst->value.string;
+
+        to->cap = 0;
+
+        if (!to->str)
+          break;
+
+        memcpy (*chars, src->value.string.str, to->len + 1);
+        to->str = *chars;
+        *chars += to->len + 1;
+        break;
+      }
+    }
+}
+
+json_error
+json_value_clone_ext (json_allocator *allocator, json_value *value,
+                      json_value **out_value)
+{
+  jusize chars = 0;
+  jusize nodes = sizeof (json_value) + json_value_clone_measure (value, &chars);
+  char *block  = allocator->json_malloc (nodes + chars, allocator->ctx);
+  char *node_p, *char_p;
+
+  if (!block)
+    return JSON_ERROR_NOMEM;
+
+  // the root handle comes first, so destroying it releases the block
+  node_p = block + sizeof (json_value);
+  char_p = block + nodes;
+
+  json_value_clone_copy (allocator, (json_value *) block, value, &node_p,
+                         &char_p);
+
+  *out_value = (json_value *) block;
+
+  return JSON_ERROR_NONE;
+}
+
+json_error
+json_value_clone (json_value *value, json_value **out_value)
+{
+  return json_value_clone_ext (&std_allocator, value, out_value);
+}
+
+json_error
+json_value_copy_ext (json_allocator *allocator, json_value *dst,
+                     json_value *src)
+{
+  json_error error;
+
+  switch (src->type)
+    {
+    case JSON_VALUE_TYPE_OBJECT:
+      {
+        json_object *from = &src->value.object;
+        json_object *to   = &dst->value.object;
 
-                if (tmp < 0)
-                  return JSON_ERROR_INTERNAL;
+        dst->type = JSON_VALUE_TYPE_OBJECT;
+        *to       = (json_object) { 0 };
 
-                _real_len += tmp;
+        if ((error = json_object_reserve_ext (allocator, to, from->size))
+            != JSON_ERROR_NONE)
+          return error;
 
-                HANDLE_MAXLEN ((ju32) tmp);
+        for (jusize i = 0; i < from->size; ++i)
+          {
+            json_entry *entry = from->entries + i;
+            json_value value;
+            char *key = allocator->json_malloc (entry->key_len + 1,
+                                                allocator->ctx);
+
+            if (!key)
+              {
+                error = JSON_ERROR_NOMEM;
+                goto fail;
               }
+
+            memcpy (key, entry->key, entry->key_len + 1);
+
+            if ((error
+                 = json_value_copy_ext (allocator, &value, &entry->value))
+                != JSON_ERROR_NONE)
+              {
+                allocator->json_free (key, allocator->ctx);
+                goto fail;
+              }
+
+            // cannot fail, the entries were reserved up front
+            json_object_append_ext (allocator, to, key, entry->key_len,
+                                    entry->hash, &value);
           }
 
-        tmp = snprintf (strp, max_len, "]");
+        break;
+      }
+    case JSON_VALUE_TYPE_ARRAY:
+      {
+        json_array *from = &src->value.array;
+        json_array *to   = &dst->value.array;
+
+        dst->type = JSON_VALUE_TYPE_ARRAY;
+        *to       = (json_array) { .kind = from->kind };
 
-        if (tmp < 0)
-          return JSON_ERROR_INTERNAL;
+        if ((error = json_array_reserve_ext (allocator, to, from->size))
+            != JSON_ERROR_NONE)
+          return error;
 
-        _real_len += tmp;
+        if (from->kind != JSON_ARRAY_VALUES)
+          {
+            if (from->size)
+              memcpy (to->elements, from->elements,
+                      json_packed_size (from->kind, from->size)
+                          - sizeof (json_packed_head));
+
+            to->size = from->size;
+            break;
+          }
+
+        for (jusize i = 0; i < from->size; ++i)
+          {
+            if ((error = json_value_copy_ext (allocator, to->elements + i,
+                                              from->elements + i))
+                != JSON_ERROR_NONE)
+              goto fail;
 
-        HANDLE_MAXLEN ((ju32) tmp);
+            ++to->size;
+          }
 
         break;
       }
+    case JSON_VALUE_TYPE_STRING:
+      dst->type         = JSON_VALUE_TYPE_STRING;
+      dst->value.string = (json_string) { 0 };
+
+      if (src->value.string.str)
+        return json_string_init_ext (allocator, &dst->value.string,
+                                     src->value.string.str,
+                                     src->value.string.len);
+
+      break;
+    default:
+      *dst = *src;
+      break;
+    }
+
+  return JSON_ERROR_NONE;
+
+fail:
+  json_value_dispose_ext (allocator, dst);
+  return error;
+}
+
+json_bool
+json_value_equals (json_value *a, json_value *b)
+{
+  if (json_value_type_of (a) != json_value_type_of (b))
+    return JSON_FALSE;
+
+  switch (json_value_type_of (a))
+    {
+    case JSON_VALUE_TYPE_OBJECT:
+      {
+        json_object *oa = &a->value.object, *ob = &b->value.object;
+
+        if (oa->size != ob->size)
+          return JSON_FALSE;
+
+        for (jusize i = 0; i < oa->size; ++i)
+          {
+            json_entry *entry = oa->entries + i;
+            jusize j = json_object_find (ob, entry->key, entry->key_len,
+                                         entry->hash);
+
+            if (j == ob->size
+                || !json_value_equals (&entry->value, &ob->entries[j].value))
+              return JSON_FALSE;
+          }
+
+        return JSON_TRUE;
+      }
+    case JSON_VALUE_TYPE_ARRAY:
+      {
+        json_array *aa = &a->value.array, *ab = &b->value.array;
+        json_value tmp_a, tmp_b;
+
+        if (aa->size != ab->size)
+          return JSON_FALSE;
+
+        for (jusize i = 0; i < aa->size; ++i)
+          if (!json_value_equals (json_array_at (aa, i, &tmp_a),
+                                  json_array_at (ab, i, &tmp_b)))
+            return JSON_FALSE;
+
+        return JSON_TRUE;
+      }
+    case JSON_VALUE_TYPE_STRING:
+      {
+        json_string *sa = &a->value.string, *sb = &b->value.string;
+
+        return sa->len == sb->len
+               && (!sa->len || memcmp (sa->str, sb->str, sa->len) == 0);
+      }
     case JSON_VALUE_TYPE_NUMBER:
+      return json_value_to_number (a) == json_value_to_number (b);
+    case JSON_VALUE_TYPE_BOOL:
+      return !a->value.bool == !b->value.bool;
+    default:
+      return JSON_TRUE;
+    }
+}
+
+json_value_type
+json_value_get_type (json_value *value)
+{
+  return json_value_type_of (value);
+}
+
+json_bool
+json_value_get_object (json_value *value, json_object **o)
+{
+  if (value->type != JSON_VALUE_TYPE_OBJECT)
+    return JSON_FALSE;
+
+  *o = &value->value.object;
+  return JSON_TRUE;
+}
+
+json_bool
+json_value_get_array (json_value *value, json_array **a)
+{
+  if (value->type != JSON_VALUE_TYPE_ARRAY)
+    return JSON_FALSE;
+
+  *a = &value->value.array;
+  return JSON_TRUE;
+}
+
+void
+json_value_set_number_ext (json_allocator *allocator, json_value *value,
+                           json_number n)
+{
+  json_value_dispose_ext (allocator, value);
+
+  value->type         = JSON_VALUE_TYPE_NUMBER;
+  value->value.number = n;
+}
+
+void
+json_value_set_number (json_value *value, json_number n)
+{
+  json_value_set_number_ext (&std_allocator, value, n);
+}
+
+json_bool
+json_value_get_bool (json_value *value, json_bool *b)
+{
+  if (value->type != JSON_VALUE_TYPE_BOOL)
+    return JSON_FALSE;
+
+  *b = value->value.bool;
+  return JSON_TRUE;
+}
+
+void
+json_value_set_bool_ext (json_allocator *allocator, json_value *value,
+                         json_bool v)
+{
+  json_value_dispose_ext (allocator, value);
+
+  value->type       = JSON_VALUE_TYPE_BOOL;
+  value->value.bool = v;
+}
+
+void
+json_value_set_bool (json_value *value, json_bool v)
+{
+  json_value_set_bool_ext (&std_allocator, value, v);
+}
+
+json_bool
+json_value_is_null (json_value *value)
+{
+  return value->type == JSON_VALUE_TYPE_NULL;
+}
+
+void
+json_value_set_null_ext (json_allocator *allocator, json_value *value)
+{
+  json_value_dispose_ext (allocator, value);
+
+  value->type = JSON_VALUE_TYPE_NULL;
+}
+
+void
+json_value_set_null (json_value *value)
+{
+  json_value_set_null_ext (&std_allocator, value);
+}
+
+typedef struct json_print_buf
+{
+  char *strp;
+  jusize max_len, len;
+} json_print_buf;
+
+/**
+ * Appends to a bounded buffer with snprintf semantics: output is truncated to
+ * max_len - 1 characters and NUL-terminated, but len counts every character.
+ */
+
+static void
+json_print_emit (const char *src, jusize size, void *ctx)
+{
+  json_print_buf *out = ctx;
+
+  if (out->len < out->max_len)
+    {
+      jusize avail = out->max_len - 1 - out->len;
+      jusize n     = size < avail ? size : avail;
+
+      memcpy (out->strp + out->len, src, n);
+      out->strp[out->len + n] = '\0';
+    }
+
+  out->len += size;
+}
+
+static void
+json_print_file_emit (const char *src, jusize size, void *ctx)
+{
+  fwrite (src, 1, size, ctx);
+}
+
+json_bool
+json_value_get_string (json_value *value, json_string **s)
+{
+  if (value->type != JSON_VALUE_TYPE_STRING)
+    return JSON_FALSE;
+
+  *s = &value->value.string;
+  return JSON_TRUE;
+}
+
+void
+json_value_set_string_ext (json_allocator *allocator, json_value *value,
+                           json_string *str)
+{
+  json_value_dispose_ext (allocator, value);
+
+  value->type         = JSON_VALUE_TYPE_STRING;
+  value->value.string = *str;
+
+  allocator->json_free (str, allocator->ctx);
+}
+
+void
+json_value_set_string (json_value *value, json_string *str)
+{
+  json_value_set_string_ext (&std_allocator, value, str);
+}
+
+/**
+ * Writes the value as JSON text in the style of json_value_snprint, with
+ * ", " between elements and ": " after keys.
+ */
+
+static void
+json_value_write (json_value *value, json_emit_fn emit, void *ctx)
+{
+  switch (value->type)
+    {
+    case JSON_VALUE_TYPE_OBJECT:
       {
-        json_number number = value->value.number;
+        json_object *object = &value->value.object;
+
+        emit ("{", 1, ctx);
+
+        for (jusize i = 0; i < object->size; ++i)
+          {
+            json_entry *entry = object->entries + i;
+
+            if (i)
+              emit (", ", 2, ctx);
+
+            emit ("\"", 1, ctx);
+            json_escape_string (entry->key, entry->key_len, emit, ctx);
+            emit ("\": ", 3, ctx);
+
+            json_value_write (&entry->value, emit, ctx);
+          }
 
-        tmp = snprintf (strp, max_len, "%f", number);
+        emit ("}", 1, ctx);
+        break;
+      }
+    case JSON_VALUE_TYPE_ARRAY:
+      {
+        json_array *array = &value->value.array;
+        json_value tmp;
 
-        if (tmp < 0)
-          return JSON_ERROR_INTERNAL;
+        emit ("[", 1, ctx);
 
-        _real_len += tmp;
+        for (jusize i = 0; i < array->size; ++i)
+          {
+            if (i)
+              emit (", ", 2, ctx);
 
-        HANDLE_MAXLEN ((ju32) tmp);
+            json_value_write (json_array_at (array, i, &tmp), emit, ctx);
+          }
 
+        emit ("]", 1, ctx);
+        break;
+      }
+    case JSON_VALUE_TYPE_NUMBER:
+      {
+        char tmpbuf[JSON_DTOA_BUF_SIZE];
+        emit (tmpbuf, json_dtoa (value->value.number, tmpbuf), ctx);
         break;
       }
+    case JSON_VALUE_TYPE_RAW_NUMBER:
+      emit (value->value.raw.text, value->value.raw.len, ctx);
+      break;
+    case JSON_VALUE_TYPE_STRING:
+      emit ("\"", 1, ctx);
+      json_escape_string (value->value.string.str, value->value.string.len,
+                          emit, ctx);
+      emit ("\"", 1, ctx);
+      break;
+    case JSON_VALUE_TYPE_BOOL:
+      if (value->value.bool)
+        emit ("true", 4, ctx);
+      else
+        emit ("false", 5, ctx);
+      break;
+    case JSON_VALUE_TYPE_NULL:
+      emit ("null", 4, ctx);
+      break;
     }
+}
 
-  if (real_len)
-    *real_len = _real_len;
+json_error
+json_value_snprint (char *strp, jusize max_len, json_value *value,
+                    jusize *real_len)
+{
+  json_print_buf out = { .strp = strp, .max_len = max_len, .len = 0 };
+
+  if (strp && max_len)
+    strp[0] = '\0';
 
-#undef HANDLE_MAXLEN
+  json_value_write (value, json_print_emit, &out);
+
+  if (real_len)
+    *real_len = out.len;
 
   return JSON_ERROR_NONE;
 }
@@ -147,7 +675,7 @@ json_value_asprint (char **strp, json_value *value)
   if (!buf)
     return JSON_ERROR_NOMEM;
 
-  error = json_value_snprint (buf, len, value, NULL);
+  error = json_value_snprint (buf, len + 1, value, NULL);
 
   if (error != JSON_ERROR_NONE)
     {
@@ -164,33 +692,41 @@ json_value_asprint (char **strp, json_value *value)
 void
 json_value_print (json_value *value)
 {
+  json_value_write (value, json_print_file_emit, stdout);
+}
 
+void
+json_value_dispose_ext (json_allocator *allocator, json_value *value)
+{
   switch (value->type)
     {
-    case JSON_VALUE_TYPE_ARRAY:
-      {
-        json_array array = value->value.array;
-        printf ("[");
-        for (jusize i = 0; i < array.size; i++)
-          json_value_print (array.elements + i);
-        printf ("]");
-        break;
-      }
-    case JSON_VALUE_TYPE_STRING:
-      printf ("\"%s\"", value->value.string.str);
+    case JSON_VALUE_TYPE_OBJECT:
+      json_object_dispose_ext (allocator, &value->value.object);
       break;
-    case JSON_VALUE_TYPE_NUMBER:
-      printf ("%f", value->value.number);
+    case JSON_VALUE_TYPE_ARRAY:
+      json_array_dispose_ext (allocator, &value->value.array);
       break;
-    default:
-      printf ("<error type>");
+    case JSON_VALUE_TYPE_STRING:
+      json_string_clear_ext (allocator, &value->value.string, JSON_TRUE);
       break;
     }
 }
 
 void
-json_value_dispose_ext (json_allocator *allocator, json_value *value)
+json_value_dispose (json_value *value)
+{
+  json_value_dispose_ext (&std_allocator, value);
+}
+
+void
+json_value_destroy_ext (json_allocator *allocator, json_value *value)
+{
+  json_value_dispose_ext (allocator, value);
+  allocator->json_free (value, allocator->ctx);
+}
+
+void
+json_value_destroy (json_value *value)
 {
-  if (value->type == JSON_VALUE_TYPE_ARRAY)
-    json_array_dispose_ext (allocator, &value->value.array);
+  json_value_destroy_ext (&std_allocator, value);
 }
@@ -1,86 +1,1398 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "json_types.h"
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <json.h>
+
+#define READALL_CHUNK (1024 * 128)
+#define READALL_NOMEM -1
+#define READALL_NFILE -2
+#define READALL_ERROR -3
+
+#define TEST_MODE_DECODE   0
+#define TEST_MODE_MINIFY   1
+#define TEST_MODE_PRETTIFY 2
+#define TEST_MODE_MSGPACK  3
+#define TEST_MODE_CBOR     4
+#define TEST_MODE_SNAPSHOT 5
+#define TEST_MODE_CLONE    6
+#define TEST_MODE_PATCH    7
+#define TEST_MODE_MERGE    8
+#define TEST_MODE_REDECODE 9
+#define TEST_MODE_BATCH    10
+#define TEST_MODE_STATS    11
+#define TEST_MODE_PROFILE  12
+#define TEST_MODE_KEYS     13
+#define TEST_MODE_LAZY     14
+#define TEST_MODE_VIEW     15
+#define TEST_MODE_COLUMNS  16
+#define TEST_MODE_SLAB     17
+#define TEST_MODE_REUSE    18
+#define TEST_MODE_PIPE     19
+#define TEST_MODE_VALIDATE 20
+
+#define BATCH_SIZE    1000
+#define BATCH_THREADS 4
+#define SLAB_ROUNDS   8
+#define REUSE_ROUNDS  8
+#define MAX_DEPTH     4
+
+typedef struct test_output
+{
+  char buf[512];
+  size_t len;
+} test_output;
+
+static json_decoder_opts *decoder_opts = NULL;
+static json_decoder_opts *binary_opts  = NULL;
+static int test_mode                   = TEST_MODE_DECODE;
+static int expect_rollback             = 0;
+static int keep_pipe_open              = 0;
+
+static int
+readall (const char *filename, char **buf, size_t *size)
+{
+  FILE *fp     = NULL;
+  char *tmpbuf = NULL, *tmpbuf2;
+  size_t tmpread, tmpsize = 0;
+
+  fp = fopen (filename, "rb");
+
+  if (fp == NULL)
+    return READALL_NFILE;
+
+  tmpbuf = malloc (READALL_CHUNK);
+
+  if (tmpbuf == NULL)
+    {
+      fclose (fp);
+      return READALL_NOMEM;
+    }
+
+  while ((tmpread = fread (tmpbuf + tmpsize, 1, READALL_CHUNK, fp))
+         == READALL_CHUNK)
+    {
+      tmpsize += READALL_CHUNK;
+      tmpbuf2 = realloc (tmpbuf, tmpsize + READALL_CHUNK);
+
+      if (tmpbuf2 == NULL)
+        {
+          free (tmpbuf);
+          fclose (fp);
+          return READALL_NOMEM;
+        }
+
+      tmpbuf = tmpbuf2;
+    }
+
+  tmpsize += tmpread;
+
+  if (feof (fp) == 0)
+    {
+      free (tmpbuf);
+      fclose (fp);
+      return READALL_ERROR;
+    }
+
+  if (!tmpsize)
+    {
+      free (tmpbuf);
+      fclose (fp);
+      *buf  = NULL;
+      *size = 0;
+      return 0;
+    }
+
+  tmpbuf2 = realloc (tmpbuf, tmpsize);
+
+  if (tmpbuf2 == NULL)
+    {
+      free (tmpbuf);
+      fclose (fp);
+      return READALL_NOMEM;
+    }
+
+  *buf  = tmpbuf2;
+  *size = tmpsize;
+
+  fclose (fp);
+
+  return 0;
+}
+
+static json_error
+test_write (const char *buf, size_t size, void *ctx)
+{
+  test_output *output = ctx;
+
+  if (size >= sizeof (output->buf) - output->len)
+    return JSON_ERROR_BUF_LEN;
+
+  memcpy (output->buf + output->len, buf, size);
+  output->len += size;
+  output->buf[output->len] = '\0';
+
+  return JSON_ERROR_NONE;
+}
+
+static void
+run_format_test (const char *buf, size_t size, const char *expected)
+{
+  test_output output = { .len = 0 };
+  json_writer writer = { .ctx = &output, .json_write = test_write };
+  json_decode_error decode_error;
+  json_error error;
+
+  output.buf[0] = '\0';
+
+  if (test_mode == TEST_MODE_MINIFY)
+    error = json_minify (decoder_opts, buf, size, &writer, &decode_error);
+  else
+    error = json_prettify (decoder_opts, 2, buf, size, &writer,
+                           &decode_error);
+
+  if (error != JSON_ERROR_NONE)
+    {
+      fprintf (stderr, "%zu:%zu: error: %s\n", decode_error.row,
+               decode_error.col, json_error_to_str (decode_error.error));
+      exit (-1);
+    }
+
+  if (expected && strcmp (output.buf, expected) != 0)
+    {
+      fprintf (stderr, "expected '%s' -> got '%s'\n", expected, output.buf);
+      exit (-1);
+    }
+
+  printf ("%s\n", output.buf);
+}
+
+/**
+ * Round-trips a decoded value through MessagePack or CBOR, checking that it
+ * prints identically afterwards.
+ */
+
+static json_value *
+run_binary_test (json_value *value)
+{
+  json_decoder_opts *opts = binary_opts ? binary_opts : decoder_opts;
+  char before[512], after[512];
+  json_decode_error decode_error;
+  json_value *decoded;
+  json_error error;
+  char *bin;
+  size_t size;
+
+  if (test_mode == TEST_MODE_MSGPACK)
+    error = json_msgpack_encode (value, &bin, &size);
+  else
+    error = json_cbor_encode (value, &bin, &size);
+
+  if (error != JSON_ERROR_NONE)
+    {
+      fprintf (stderr, "error: %s\n", json_error_to_str (error));
+      exit (-1);
+    }
+
+  if (test_mode == TEST_MODE_MSGPACK)
+    decoded = json_msgpack_decode (opts, bin, size, &decode_error);
+  else
+    decoded = json_cbor_decode (opts, bin, size, &decode_error);
+
+  free (bin);
+
+  if (decoded == NULL)
+    {
+      fprintf (stderr, "%zu: error: %s\n", decode_error.col,
+               json_error_to_str (decode_error.error));
+      exit (-1);
+    }
+
+  json_value_snprint (before, sizeof (before), value, NULL);
+  json_value_snprint (after, sizeof (after), decoded, NULL);
+
+  if (strcmp (before, after) != 0)
+    {
+      fprintf (stderr, "round-trip '%s' -> got '%s'\n", before, after);
+      exit (-1);
+    }
+
+  json_value_destroy (value);
+
+  return decoded;
+}
+
+/**
+ * Copies a snapshot value into a json_value through the read API, checking
+ * that each member is also found by key.
+ */
+
+static json_value *
+snapshot_to_value (const json_snapshot_value *snap)
+{
+  json_value *value = json_value_create ();
+  json_number n;
+  json_bool b;
+  const char *str;
+  jusize len;
+
+  switch (json_snapshot_get_type (snap))
+    {
+    case JSON_VALUE_TYPE_OBJECT:
+      {
+        json_object *object;
+
+        json_value_destroy (value);
+        value = json_decode (NULL, "{}", 2, NULL);
+        json_value_get_object (value, &object);
+
+        for (jusize i = 0; i < json_snapshot_size (snap); ++i)
+          {
+            const json_snapshot_value *child
+                = json_snapshot_object_at (snap, i, &str, &len);
+            json_value *member;
+
+            if (json_snapshot_object_get (snap, str) != child)
+              {
+                fprintf (stderr, "lookup of '%s' failed\n", str);
+                exit (-1);
+              }
+
+            // the contents are moved into the object, only the handle is left
+            member = snapshot_to_value (child);
+            json_object_put (object, str, member);
+            free (member);
+          }
+
+        break;
+      }
+    case JSON_VALUE_TYPE_ARRAY:
+      {
+        json_array *array;
+
+        json_value_destroy (value);
+        value = json_decode (NULL, "[]", 2, NULL);
+        json_value_get_array (value, &array);
+
+        for (jusize i = 0; i < json_snapshot_size (snap); ++i)
+          {
+            json_value *element
+                = snapshot_to_value (json_snapshot_array_get (snap, i));
+            json_array_append (array, element);
+            free (element);
+          }
+
+        break;
+      }
+    case JSON_VALUE_TYPE_NUMBER:
+      json_snapshot_get_number (snap, &n);
+      json_value_set_number (value, n);
+      break;
+    case JSON_VALUE_TYPE_STRING:
+      {
+        json_string *string = json_string_create ();
+
+        json_snapshot_get_string (snap, &str, &len);
+        json_string_append_from_buf (string, str, len);
+        json_value_set_string (value, string);
+        break;
+      }
+    case JSON_VALUE_TYPE_BOOL:
+      json_snapshot_get_bool (snap, &b);
+      json_value_set_bool (value, b);
+      break;
+    case JSON_VALUE_TYPE_NULL:
+      break;
+    }
+
+  return value;
+}
+
+/**
+ * Writes a decoded value to a snapshot and reads it back, checking that it
+ * prints identically afterwards.
+ */
+
+static json_value *
+run_snapshot_test (json_value *value)
+{
+  char path[] = "/tmp/libjson-snapshot-XXXXXX";
+  char before[512], after[512];
+  json_snapshot *snapshot;
+  json_value *copy;
+  json_error error;
+  int fd;
+
+  if ((fd = mkstemp (path)) < 0)
+    {
+      fprintf (stderr, "failed to create '%s'\n", path);
+      exit (-1);
+    }
+
+  error = json_snapshot_write (value, fd);
+  close (fd);
+
+  if (error == JSON_ERROR_NONE)
+    error = json_snapshot_open (path, &snapshot);
+
+  unlink (path);
+
+  if (error != JSON_ERROR_NONE)
+    {
+      fprintf (stderr, "error: %s\n", json_error_to_str (error));
+      exit (-1);
+    }
+
+  copy = snapshot_to_value (json_snapshot_root (snapshot));
+  json_snapshot_close (snapshot);
+
+  json_value_snprint (before, sizeof (before), value, NULL);
+  json_value_snprint (after, sizeof (after), copy, NULL);
+
+  if (strcmp (before, after) != 0)
+    {
+      fprintf (stderr, "snapshot '%s' -> got '%s'\n", before, after);
+      exit (-1);
+    }
+
+  json_value_destroy (value);
+
+  return copy;
+}
+
+/**
+ * Applies the same few edits to any document, growing and shrinking its
+ * containers and strings.
+ */
+
+static void
+mutate (json_value *value)
+{
+  json_object *object;
+  json_array *array;
+  json_string *string;
+  json_value *tmp;
+
+  if (json_value_get_object (value, &object))
+    {
+      json_object_remove (object, "a");
+      json_object_remove (object, "k03");
+
+      tmp = json_value_create ();
+      json_value_set_bool (tmp, JSON_TRUE);
+      json_object_put (object, "added", tmp);
+      free (tmp);
+
+      if ((tmp = json_object_get (object, "b")) != NULL)
+        mutate (tmp);
+    }
+  else if (json_value_get_array (value, &array))
+    {
+      if ((tmp = json_array_get (array, 0)) != NULL)
+        mutate (tmp);
+
+      tmp = json_value_create ();
+      json_array_append (array, tmp);
+      free (tmp);
+    }
+  else if (json_value_get_string (value, &string))
+    json_string_append (string, 0x21);
+}
+
+/**
+ * Clones a decoded value and edits both, checking that they print
+ * identically afterwards.
+ */
+
+static json_value *
+run_clone_test (json_value *value)
+{
+  char before[512], after[512];
+  json_value *clone;
+  json_error error;
+
+  if ((error = json_value_clone (value, &clone)) != JSON_ERROR_NONE)
+    {
+      fprintf (stderr, "error: %s\n", json_error_to_str (error));
+      exit (-1);
+    }
+
+  mutate (value);
+  mutate (clone);
+
+  json_value_snprint (before, sizeof (before), value, NULL);
+  json_value_snprint (after, sizeof (after), clone, NULL);
+
+  if (strcmp (before, after) != 0)
+    {
+      fprintf (stderr, "clone '%s' -> got '%s'\n", before, after);
+      exit (-1);
+    }
+
+  json_value_destroy (value);
+
+  return clone;
+}
+
+/**
+ * Applies the patch in element 1 of a decoded [doc, patch] pair atomically to
+ * the document in element 0 and to a clone of it, checking that both print
+ * identically afterwards. With expect_rollback the patch must fail and leave
+ * the document untouched.
+ */
+
+static json_value *
+run_patch_test (json_value *value)
+{
+  char before[512], after[512], original[512];
+  json_value *doc, *patch, *clone, *tmp;
+  json_error error, clone_error;
+  json_array *pair;
+
+  if (!json_value_get_array (value, &pair)
+      || !(patch = json_array_get (pair, 1)))
+    {
+      fprintf (stderr, "expected [doc, patch]\n");
+      exit (-1);
+    }
+
+  // move the document out of the pair, leaving null in its place
+  doc = json_value_create ();
+  tmp = json_value_create ();
+  json_array_replace (pair, 0, tmp, doc);
+  free (tmp);
+
+  json_value_snprint (original, sizeof (original), doc, NULL);
+
+  if ((error = json_value_clone (doc, &clone)) != JSON_ERROR_NONE)
+    {
+      fprintf (stderr, "error: %s\n", json_error_to_str (error));
+      exit (-1);
+    }
+
+  if (test_mode == TEST_MODE_PATCH)
+    {
+      error       = json_patch_apply (doc, patch, JSON_TRUE);
+      clone_error = json_patch_apply (clone, patch, JSON_TRUE);
+    }
+  else
+    {
+      error       = json_merge_patch_apply (doc, patch, JSON_TRUE);
+      clone_error = json_merge_patch_apply (clone, patch, JSON_TRUE);
+    }
+
+  json_value_snprint (before, sizeof (before), doc, NULL);
+  json_value_snprint (after, sizeof (after), clone, NULL);
+
+  if (error != clone_error || strcmp (before, after) != 0)
+    {
+      fprintf (stderr, "patch '%s' -> clone got '%s'\n", before, after);
+      exit (-1);
+    }
+
+  if (expect_rollback && strcmp (before, original) != 0)
+    {
+      fprintf (stderr, "rollback '%s' -> got '%s'\n", original, before);
+      exit (-1);
+    }
+
+  if ((error != JSON_ERROR_NONE) != expect_rollback)
+    {
+      fprintf (stderr, "error: %s\n", json_error_to_str (error));
+      exit (-1);
+    }
+
+  json_value_destroy (clone);
+  json_value_destroy (value);
+
+  return doc;
+}
+
+/**
+ * Applies a single edit to the text and updates value with json_redecode,
+ * checking that it agrees with decoding the edited text from scratch.
+ * Successful edits are kept.
+ */
+
+static void
+redecode_edit (json_value *value, char **buf, size_t *size, size_t start,
+               size_t edit_len, const char *insert)
+{
+  size_t insert_len = strlen (insert);
+  size_t new_size   = *size - edit_len + insert_len;
+  char *new_buf     = malloc (new_size + 1);
+  char *before, *after, *expected;
+  json_value *full;
+  json_error error;
+
+  memcpy (new_buf, *buf, start);
+  memcpy (new_buf + start, insert, insert_len);
+  memcpy (new_buf + start + insert_len, *buf + start + edit_len,
+          *size - start - edit_len);
+
+  json_value_asprint (&before, value);
+
+  error = json_redecode (decoder_opts, value, *buf, *size, new_buf, new_size,
+                         start, edit_len, NULL);
+  full  = json_decode (decoder_opts, new_buf, new_size, NULL);
+
+  json_value_asprint (&after, value);
+
+  if (full)
+    json_value_asprint (&expected, full);
+  else
+    expected = before;
+
+  if ((error == JSON_ERROR_NONE) != (full != NULL)
+      || strcmp (after, expected) != 0)
+    {
+      fprintf (stderr, "redecode '%.*s' -> got '%s'\n", (int) new_size,
+               new_buf, after);
+      exit (-1);
+    }
+
+  if (full)
+    {
+      json_value_destroy (full);
+      free (expected);
+      free (*buf);
+      *buf  = new_buf;
+      *size = new_size;
+    }
+  else
+    free (new_buf);
+
+  free (before);
+  free (after);
+}
+
+/**
+ * Inserts, deletes and replaces a character at every offset of the text in
+ * turn, keeping each edit that leaves it valid.
+ */
+
+static json_value *
+run_redecode_test (json_value *value, char **buf, size_t *size)
+{
+  for (size_t i = 0; i < *size && i < 4096; ++i)
+    {
+      redecode_edit (value, buf, size, i, 0, "1");
+      redecode_edit (value, buf, size, i, 1, "");
+
+      if (i < *size)
+        redecode_edit (value, buf, size, i, 1, "\"");
+    }
+
+  return value;
+}
+
+/**
+ * Decodes a batch of copies and truncated copies of the text on a pool,
+ * checking every result and error against decoding it serially.
+ */
+
+static void
+run_batch_test (const char *buf, size_t size)
+{
+  static json_input inputs[BATCH_SIZE];
+  static json_value *outputs[BATCH_SIZE];
+  static json_decode_error errors[BATCH_SIZE];
+  json_pool *pool = json_pool_create (decoder_opts, BATCH_THREADS);
+
+  if (!pool)
+    {
+      fprintf (stderr, "failed to create pool\n");
+      exit (-1);
+    }
+
+  for (size_t i = 0; i < BATCH_SIZE; ++i)
+    inputs[i] = (json_input) { buf, i % 2 ? i % (size + 1) : size };
+
+  json_decode_batch (pool, inputs, BATCH_SIZE, outputs, errors);
+  json_pool_destroy (pool);
+
+  for (size_t i = 0; i < BATCH_SIZE; ++i)
+    {
+      json_decode_error error;
+      json_value *value
+          = json_decode (decoder_opts, inputs[i].buf, inputs[i].size, &error);
+      char *expected = NULL, *got = NULL;
+
+      if (value)
+        json_value_asprint (&expected, value);
+
+      if (outputs[i])
+        json_value_asprint (&got, outputs[i]);
+
+      if (!value != !outputs[i]
+          || (value && strcmp (expected, got) != 0)
+          || (!value
+              && (error.error != errors[i].error || error.row != errors[i].row
+                  || error.col != errors[i].col)))
+        {
+          fprintf (stderr, "batch input %zu differs from serial decode\n", i);
+          exit (-1);
+        }
+
+      if (value)
+        {
+          json_value_destroy (value);
+          json_value_destroy (outputs[i]);
+        }
+
+      free (expected);
+      free (got);
+    }
+}
+
+/**
+ * Decodes the text through a counting allocator with stats enabled, checking
+ * that destroying the value releases everything it allocated.
+ *
+ * @return - the value counts by type, as a JSON array
+ */
+
+static json_value *
+run_stats_test (const char *buf, size_t size)
+{
+  json_decoder_opts opts = decoder_opts ? *decoder_opts
+                                        : (json_decoder_opts) STD_DECODER_OPTS;
+  json_counting_allocator counting;
+  json_decode_stats stats = { { 0 } };
+  json_decode_error decode_error;
+  json_alloc_stats *alloc = &counting.stats;
+  json_value *value;
+  char counts[256];
+
+  json_counting_allocator_init (&counting, NULL);
+
+  opts.allocator = &counting.allocator;
+  opts.stats     = &stats;
+
+  if (!(value = json_decode (&opts, buf, size, &decode_error)))
+    {
+      fprintf (stderr, "%zu:%zu: error: %s\n", decode_error.row,
+               decode_error.col, json_error_to_str (decode_error.error));
+      exit (-1);
+    }
+
+  json_value_destroy_ext (&counting.allocator, value);
+
+  if (alloc->bytes_live || alloc->frees != alloc->allocs
+      || alloc->bytes_peak == 0)
+    {
+      fprintf (stderr, "%zu allocs, %zu frees, %zu bytes live\n",
+               alloc->allocs, alloc->frees, alloc->bytes_live);
+      exit (-1);
+    }
+
+  snprintf (counts, sizeof (counts), "[%zu, %zu, %zu, %zu, %zu, %zu]",
+            stats.values[JSON_VALUE_TYPE_OBJECT],
+            stats.values[JSON_VALUE_TYPE_ARRAY],
+            stats.values[JSON_VALUE_TYPE_NUMBER],
+            stats.values[JSON_VALUE_TYPE_STRING],
+            stats.values[JSON_VALUE_TYPE_BOOL],
+            stats.values[JSON_VALUE_TYPE_NULL]);
+
+  return json_decode (NULL, counts, strlen (counts), NULL);
+}
+
+/**
+ * Decodes the text repeatedly through a slab allocator over a counting
+ * allocator, checking that every round prints like the first, that rounds
+ * after the first reuse freed blocks instead of taking new slabs, and that
+ * releasing the slab allocator returns everything.
+ *
+ * @return - the value decoded with the default allocator
+ */
+
+static json_value *
+run_slab_test (const char *buf, size_t size)
+{
+  json_decoder_opts opts = decoder_opts ? *decoder_opts
+                                        : (json_decoder_opts) STD_DECODER_OPTS;
+  json_counting_allocator counting;
+  json_slab_allocator slab;
+  json_decode_error decode_error;
+  json_value *value;
+  char *expected = NULL;
+  size_t slab_bytes = 0;
+
+  json_counting_allocator_init (&counting, NULL);
+  json_slab_allocator_init (&slab, &counting.allocator);
+
+  opts.allocator = &slab.allocator;
+
+  if (!(value = json_decode (decoder_opts, buf, size, &decode_error)))
+    {
+      fprintf (stderr, "%zu:%zu: error: %s\n", decode_error.row,
+               decode_error.col, json_error_to_str (decode_error.error));
+      exit (-1);
+    }
+
+  json_value_asprint (&expected, value);
+
+  for (size_t i = 0; i < SLAB_ROUNDS; ++i)
+    {
+      json_value *round = json_decode (&opts, buf, size, NULL);
+      char *got         = NULL;
+
+      if (!round)
+        {
+          fprintf (stderr, "slab round %zu failed to decode\n", i);
+          exit (-1);
+        }
+
+      json_value_asprint (&got, round);
+
+      if (strcmp (expected, got) != 0)
+        {
+          fprintf (stderr, "slab round %zu differs from default decode\n", i);
+          exit (-1);
+        }
+
+      free (got);
+      json_value_destroy_ext (&slab.allocator, round);
+
+      if (i == 0)
+        slab_bytes = slab.slab_bytes;
+      else if (slab.slab_bytes != slab_bytes)
+        {
+          fprintf (stderr, "slab round %zu grew slabs from %zu to %zu bytes\n",
+                   i, slab_bytes, (size_t) slab.slab_bytes);
+          exit (-1);
+        }
+    }
+
+  json_slab_allocator_release (&slab);
+
+  if (counting.stats.bytes_live)
+    {
+      fprintf (stderr, "%zu bytes live after release\n",
+               counting.stats.bytes_live);
+      exit (-1);
+    }
+
+  free (expected);
+
+  return value;
+}
+
+/**
+ * Decodes the text and a truncated copy in turn with one decoder over a
+ * counting allocator, checking that every full decode prints like the
+ * first, that the decoder holds the same scratch memory after every round
+ * and that destroying it returns everything.
+ *
+ * @return - the value of the first round
+ */
+
+static json_value *
+run_reuse_test (const char *buf, size_t size)
+{
+  json_decoder_opts opts = decoder_opts ? *decoder_opts
+                                        : (json_decoder_opts) STD_DECODER_OPTS;
+  json_counting_allocator counting;
+  json_decoder *decoder;
+  json_decode_error decode_error;
+  json_value *value;
+  char *expected = NULL;
+  size_t held    = 0;
+
+  json_counting_allocator_init (&counting, NULL);
+
+  opts.allocator = &counting.allocator;
+
+  if (!(decoder = json_decoder_create (&opts)))
+    {
+      fprintf (stderr, "failed to create decoder\n");
+      exit (-1);
+    }
+
+  if (!(value = json_decoder_decode (decoder, buf, size, &decode_error)))
+    {
+      fprintf (stderr, "%zu:%zu: error: %s\n", decode_error.row,
+               decode_error.col, json_error_to_str (decode_error.error));
+      exit (-1);
+    }
+
+  json_value_asprint (&expected, value);
+
+  for (size_t i = 0; i < REUSE_ROUNDS; ++i)
+    {
+      json_value *round = json_decoder_decode (decoder, buf, size, NULL);
+      json_value *cut   = json_decoder_decode (decoder, buf, size / 2, NULL);
+      char *got         = NULL;
 
-#include <json.h>
+      if (!round)
+        {
+          fprintf (stderr, "reuse round %zu failed to decode\n", i);
+          exit (-1);
+        }
 
-#define READALL_CHUNK (1024 * 128)
-#define READALL_NOMEM -1
-#define READALL_NFILE -2
-#define READALL_ERROR -3
+      json_value_asprint (&got, round);
 
-static json_decoder_opts *decoder_opts = NULL;
+      if (strcmp (expected, got) != 0)
+        {
+          fprintf (stderr, "reuse round %zu differs from the first\n", i);
+          exit (-1);
+        }
 
-static int
-readall (const char *filename, char **buf, size_t *size)
+      free (got);
+      json_value_destroy_ext (&counting.allocator, round);
+
+      if (cut)
+        json_value_destroy_ext (&counting.allocator, cut);
+
+      if (i == 0)
+        held = counting.stats.bytes_live;
+      else if (counting.stats.bytes_live != held)
+        {
+          fprintf (stderr, "reuse round %zu holds %zu bytes, not %zu\n", i,
+                   counting.stats.bytes_live, held);
+          exit (-1);
+        }
+    }
+
+  json_value_destroy_ext (&counting.allocator, value);
+  json_decoder_destroy (decoder);
+
+  if (counting.stats.bytes_live)
+    {
+      fprintf (stderr, "%zu bytes live after destroy\n",
+               counting.stats.bytes_live);
+      exit (-1);
+    }
+
+  free (expected);
+
+  return json_decode (decoder_opts, buf, size, NULL);
+}
+
+typedef struct pipe_writer
 {
-  FILE *fp     = NULL;
-  char *tmpbuf = NULL, *tmpbuf2;
-  size_t tmpread, tmpsize = 0;
+  int fd;
+  const char *buf;
+  size_t size;
+} pipe_writer;
 
-  fp = fopen (filename, "rb");
+/**
+ * Writes the text to a pipe a few bytes at a time, so that the reader sees
+ * it arrive in pieces that split tokens. The first few pieces are spaced
+ * out so that they are read one at a time.
+ */
 
-  if (fp == NULL)
-    return READALL_NFILE;
+static void *
+pipe_write (void *arg)
+{
+  pipe_writer *writer = arg;
+  struct timespec pause = { 0, 1000000 };
+  size_t pos = 0, chunk = 1;
 
-  tmpbuf = malloc (READALL_CHUNK);
+  while (pos < writer->size)
+    {
+      size_t n = writer->size - pos < chunk ? writer->size - pos : chunk;
+      ssize_t written;
 
-  if (tmpbuf == NULL)
+      if ((written = write (writer->fd, writer->buf + pos, n)) < 0)
+        break;
+
+      pos += (size_t) written;
+      chunk = chunk % 13 + 1;
+
+      if (pos < 64)
+        nanosleep (&pause, NULL);
+    }
+
+  close (writer->fd);
+
+  return NULL;
+}
+
+/**
+ * Checks that a pipelined decode gives the same value or error as decoding
+ * the whole text.
+ */
+
+static void
+check_pipe_result (const char *source, json_value *expected,
+                   json_decode_error *expected_error, json_value *got,
+                   json_decode_error *error)
+{
+  char *expected_str = NULL, *got_str = NULL;
+
+  if (!expected != !got
+      || (!got
+          && (error->error != expected_error->error
+              || error->row != expected_error->row
+              || error->col != expected_error->col)))
     {
-      fclose (fp);
-      return READALL_NOMEM;
+      fprintf (stderr, "pipelined decode from %s differs\n", source);
+      exit (-1);
     }
 
-  while ((tmpread = fread (tmpbuf + tmpsize, 1, READALL_CHUNK, fp))
-         == READALL_CHUNK)
+  if (!got)
+    return;
+
+  json_value_asprint (&expected_str, expected);
+  json_value_asprint (&got_str, got);
+
+  if (strcmp (expected_str, got_str) != 0)
     {
-      tmpsize += READALL_CHUNK;
-      tmpbuf2 = realloc (tmpbuf, tmpsize + READALL_CHUNK);
+      fprintf (stderr, "pipelined decode from %s differs\n", source);
+      exit (-1);
+    }
 
-      if (tmpbuf2 == NULL)
+  free (expected_str);
+  free (got_str);
+  json_value_destroy (got);
+}
+
+/**
+ * Decodes the file through its descriptor and through a pipe that it is
+ * written to a few bytes at a time, checking both against decoding the
+ * whole text.
+ *
+ * @return - the value decoded from the whole text, or NULL with its error
+ */
+
+static json_value *
+run_pipe_test (const char *filename, const char *buf, size_t size,
+               json_decode_error *decode_error)
+{
+  json_value *value = json_decode (decoder_opts, buf, size, decode_error);
+  json_decode_error error;
+  pipe_writer writer;
+  pthread_t thread;
+  int fd, fds[2];
+
+  if ((fd = open (filename, O_RDONLY)) < 0)
+    {
+      fprintf (stderr, "failed to open '%s'\n", filename);
+      exit (-1);
+    }
+
+  check_pipe_result ("file", value, decode_error,
+                     json_decode_fd_pipelined (decoder_opts, fd, &error),
+                     &error);
+  close (fd);
+
+  if (pipe (fds) != 0)
+    {
+      fprintf (stderr, "failed to create pipe\n");
+      exit (-1);
+    }
+
+  writer = (pipe_writer) { fds[1], buf, size };
+
+  if (pthread_create (&thread, NULL, pipe_write, &writer) != 0)
+    {
+      fprintf (stderr, "failed to start writer\n");
+      exit (-1);
+    }
+
+  check_pipe_result ("pipe", value, decode_error,
+                     json_decode_fd_pipelined (decoder_opts, fds[0], &error),
+                     &error);
+
+  pthread_join (thread, NULL);
+  close (fds[0]);
+
+  // -i writes the whole text but leaves the pipe open, so a decode that
+  // waits for its end never returns
+  if (keep_pipe_open)
+    {
+      if (pipe (fds) != 0 || write (fds[1], buf, size) != (ssize_t) size)
         {
-          free (tmpbuf);
-          fclose (fp);
-          return READALL_NOMEM;
+          fprintf (stderr, "failed to fill pipe\n");
+          exit (-1);
         }
 
-      tmpbuf = tmpbuf2;
+      check_pipe_result ("open pipe", value, decode_error,
+                         json_decode_fd_pipelined (decoder_opts, fds[0],
+                                                   &error),
+                         &error);
+
+      close (fds[1]);
+      close (fds[0]);
     }
 
-  tmpsize += tmpread;
+  return value;
+}
 
-  if (feof (fp) == 0)
+/**
+ * Validates the text through a counting allocator, checking that it fails
+ * with the error decoding reports, or passes where decoding only found a
+ * duplicate key, and that nothing was allocated unless the text needed
+ * transcoding.
+ *
+ * @return - the value decoded from the text, or NULL with its error
+ */
+
+static json_value *
+run_validate_test (const char *buf, size_t size,
+                   json_decode_error *decode_error)
+{
+  json_decoder_opts opts = decoder_opts ? *decoder_opts
+                                        : (json_decoder_opts) STD_DECODER_OPTS;
+  json_value *value = json_decode (decoder_opts, buf, size, decode_error);
+  json_counting_allocator counting;
+  json_decode_error error;
+  json_error got;
+  int utf8, same;
+
+  json_counting_allocator_init (&counting, NULL);
+
+  opts.allocator = &counting.allocator;
+  got            = json_validate (&opts, buf, size, &error);
+
+  // UTF-16 and UTF-32 text starts with a marker byte or a zero byte
+  utf8 = size < 2
+         || (buf[0] && buf[1] && (unsigned char) buf[0] < 0xFE);
+
+  if (value)
+    same = got == JSON_ERROR_NONE;
+  else if (got == JSON_ERROR_NONE)
+    same = decode_error->error == JSON_ERROR_DUP_KEY;
+  else
+    same = got == decode_error->error && error.row == decode_error->row
+           && error.col == decode_error->col;
+
+  if (!same)
     {
-      free (tmpbuf);
-      fclose (fp);
-      return READALL_ERROR;
+      fprintf (stderr, "validation differs from decoding: %zu:%zu: %s\n",
+               error.row, error.col, json_error_to_str (got));
+      exit (-1);
     }
 
-  if (!tmpsize)
+  if ((utf8 && counting.stats.allocs) || counting.stats.bytes_live)
     {
-      free (tmpbuf);
-      fclose (fp);
-      *buf  = NULL;
-      *size = 0;
-      return 0;
+      fprintf (stderr, "validation allocated %zu times\n",
+               counting.stats.allocs);
+      exit (-1);
     }
 
-  tmpbuf2 = realloc (tmpbuf, tmpsize);
+  return value;
+}
 
-  if (tmpbuf2 == NULL)
+/**
+ * Decodes the text with and without lazy numbers, checking that both encode
+ * to the same MessagePack, which converts every raw number.
+ *
+ * @return - the value with lazy numbers, which prints their text verbatim
+ */
+
+static json_value *
+run_lazy_test (const char *buf, size_t size)
+{
+  json_decoder_opts opts = decoder_opts ? *decoder_opts
+                                        : (json_decoder_opts) STD_DECODER_OPTS;
+  json_decode_error decode_error;
+  json_value *lazy, *eager;
+  char *lazy_bin, *eager_bin;
+  size_t lazy_size, eager_size;
+
+  opts.lazy_numbers = JSON_TRUE;
+
+  if (!(lazy = json_decode (&opts, buf, size, &decode_error))
+      || !(eager = json_decode (decoder_opts, buf, size, &decode_error)))
     {
-      free (tmpbuf);
-      fclose (fp);
-      return READALL_NOMEM;
+      fprintf (stderr, "%zu:%zu: error: %s\n", decode_error.row,
+               decode_error.col, json_error_to_str (decode_error.error));
+      exit (-1);
     }
 
-  *buf  = tmpbuf2;
-  *size = tmpsize;
+  if (json_msgpack_encode (lazy, &lazy_bin, &lazy_size) != JSON_ERROR_NONE
+      || json_msgpack_encode (eager, &eager_bin, &eager_size)
+             != JSON_ERROR_NONE)
+    {
+      fprintf (stderr, "failed to encode the values\n");
+      exit (-1);
+    }
 
-  fclose (fp);
+  if (lazy_size != eager_size || memcmp (lazy_bin, eager_bin, lazy_size))
+    {
+      fprintf (stderr, "lazy numbers converted differently\n");
+      exit (-1);
+    }
 
-  return 0;
+  free (lazy_bin);
+  free (eager_bin);
+  json_value_destroy (eager);
+
+  return lazy;
+}
+
+/**
+ * Reads the leading numbers and bools of an array in bulk.
+ *
+ * @return - the counts of numbers and bools and whether the numbers could be
+ * viewed in place, as a JSON array
+ */
+
+static json_value *
+run_view_test (json_value *value)
+{
+  json_number numbers[64];
+  json_bool bools[64];
+  jusize n_numbers = 0, n_bools = 0;
+  const json_number *view = NULL;
+  json_array *array;
+  char counts[64];
+
+  if (json_value_get_array (value, &array))
+    {
+      n_numbers = json_array_get_numbers (array, numbers, 64);
+      n_bools   = json_array_get_bools (array, bools, 64);
+      view      = json_array_view_numbers (array);
+    }
+
+  // the view is only valid until json_array_get unpacks the array
+  if (view && memcmp (view, numbers, n_numbers * sizeof (json_number)))
+    {
+      fprintf (stderr, "view differs from the copied numbers\n");
+      exit (-1);
+    }
+
+  for (jusize i = 0; i < n_numbers; ++i)
+    {
+      json_number n;
+
+      if (!json_value_get_number (json_array_get (array, i), &n)
+          || n != numbers[i])
+        {
+          fprintf (stderr, "number %zu read differently in bulk\n", i);
+          exit (-1);
+        }
+    }
+
+  for (jusize i = 0; i < n_bools; ++i)
+    {
+      json_bool b;
+
+      if (!json_value_get_bool (json_array_get (array, i), &b)
+          || !b != !bools[i])
+        {
+          fprintf (stderr, "bool %zu read differently in bulk\n", i);
+          exit (-1);
+        }
+    }
+
+  snprintf (counts, sizeof (counts), "[%zu, %zu, %s]", n_numbers, n_bools,
+            view ? "true" : "false");
+
+  json_value_destroy (value);
+
+  return json_decode (NULL, counts, strlen (counts), NULL);
+}
+
+/**
+ * Extracts the columns id, name, ok and tags from an array of objects,
+ * checking each column's count of valid cells.
+ *
+ * @return - the columns, with null for invalid cells and the length of each
+ * tags array, as a JSON array
+ */
+
+static json_value *
+run_columns_test (json_value *value)
+{
+  static const char *const fields[] = { "id", "name", "ok", "tags" };
+  static const json_value_type types[]
+      = { JSON_VALUE_TYPE_NUMBER, JSON_VALUE_TYPE_STRING,
+          JSON_VALUE_TYPE_BOOL, JSON_VALUE_TYPE_ARRAY };
+  json_column columns[4];
+  json_value *result;
+  json_array *array;
+  char out[512];
+  size_t len = 0;
+
+  if (!json_value_get_array (value, &array)
+      || json_array_to_columns (array, fields, types, 4, columns)
+             != JSON_ERROR_NONE)
+    {
+      fprintf (stderr, "failed to extract the columns\n");
+      exit (-1);
+    }
+
+  len += snprintf (out + len, sizeof (out) - len, "[");
+
+  for (size_t c = 0; c < 4; ++c)
+    {
+      json_column *column = columns + c;
+      size_t n_valid      = 0;
+
+      len += snprintf (out + len, sizeof (out) - len, c ? ", [" : "[");
+
+      for (size_t i = 0; i < column->size; ++i)
+        {
+          const char *sep = i ? ", " : "";
+
+          if (!(column->valid[i / 8] & (1 << (i % 8))))
+            {
+              len += snprintf (out + len, sizeof (out) - len, "%snull", sep);
+              continue;
+            }
+
+          ++n_valid;
+
+          if (column->numbers)
+            len += snprintf (out + len, sizeof (out) - len, "%s%g", sep,
+                             column->numbers[i]);
+          else if (column->strings)
+            len += snprintf (out + len, sizeof (out) - len, "%s\"%.*s\"",
+                             sep, (int) column->lens[i], column->strings[i]);
+          else if (column->bools)
+            len += snprintf (out + len, sizeof (out) - len, "%s%s", sep,
+                             column->bools[i] ? "true" : "false");
+          else
+            {
+              json_array *tags;
+              size_t n_tags = 0;
+
+              json_value_get_array (column->values[i], &tags);
+
+              while (json_array_get (tags, n_tags))
+                ++n_tags;
+
+              len += snprintf (out + len, sizeof (out) - len, "%s%zu", sep,
+                               n_tags);
+            }
+        }
+
+      len += snprintf (out + len, sizeof (out) - len, "]");
+
+      if (n_valid != column->n_valid)
+        {
+          fprintf (stderr, "column %zu counted %zu valid cells, found %zu\n",
+                   c, column->n_valid, n_valid);
+          exit (-1);
+        }
+    }
+
+  snprintf (out + len, sizeof (out) - len, "]");
+
+  json_columns_dispose (columns, 4);
+  json_value_destroy (value);
+
+  if (!(result = json_decode (NULL, out, strlen (out), NULL)))
+    {
+      fprintf (stderr, "bad columns '%s'\n", out);
+      exit (-1);
+    }
+
+  return result;
+}
+
+/**
+ * Looks up a fixed set of keys with shared handles in every object of an
+ * array, checking each result against json_object_get.
+ *
+ * @return - the number of objects holding each key, as a JSON array
+ */
+
+static json_value *
+run_keys_test (json_value *value)
+{
+  static const char *names[] = { "id", "name", "tags", "k15", "missing" };
+  size_t hits[sizeof (names) / sizeof (names[0])] = { 0 };
+  json_key keys[sizeof (names) / sizeof (names[0])];
+  json_array *array;
+  json_object *object;
+  json_value *element;
+  char counts[256];
+
+  if (!json_value_get_array (value, &array))
+    {
+      fprintf (stderr, "expected an array of objects\n");
+      exit (-1);
+    }
+
+  for (size_t k = 0; k < sizeof (names) / sizeof (names[0]); ++k)
+    keys[k] = json_key_make (names[k]);
+
+  for (size_t i = 0; (element = json_array_get (array, i)); ++i)
+    {
+      if (!json_value_get_object (element, &object))
+        continue;
+
+      for (size_t k = 0; k < sizeof (names) / sizeof (names[0]); ++k)
+        {
+          json_value *found = json_object_get_key (object, keys + k);
+
+          if (found != json_object_get (object, names[k]))
+            {
+              fprintf (stderr, "element %zu: lookup of '%s' differs\n", i,
+                       names[k]);
+              exit (-1);
+            }
+
+          hits[k] += found != NULL;
+        }
+    }
+
+  json_value_destroy (value);
+
+  snprintf (counts, sizeof (counts), "[%zu, %zu, %zu, %zu, %zu]", hits[0],
+            hits[1], hits[2], hits[3], hits[4]);
+
+  return json_decode (NULL, counts, strlen (counts), NULL);
+}
+
+/**
+ * Decodes the text with a profile, checking that every byte is charged to
+ * exactly one phase. Only meaningful in a -Dprofiling=true build.
+ *
+ * @return - the number of number, string, literal, array and object phases,
+ * as a JSON array
+ */
+
+static json_value *
+run_profile_test (const char *buf, size_t size)
+{
+  json_decoder_opts opts = decoder_opts ? *decoder_opts
+                                        : (json_decoder_opts) STD_DECODER_OPTS;
+  json_decode_profile profile = { 0 };
+  json_decode_error decode_error;
+  json_value *value;
+  unsigned long long bytes = 0;
+  char counts[256];
+
+  opts.profile = &profile;
+
+  if (!(value = json_decode (&opts, buf, size, &decode_error)))
+    {
+      fprintf (stderr, "%zu:%zu: error: %s\n", decode_error.row,
+               decode_error.col, json_error_to_str (decode_error.error));
+      exit (-1);
+    }
+
+  json_value_destroy (value);
+
+  for (int i = 0; i < JSON_DECODE_PHASES; ++i)
+    bytes += profile.bytes[i];
+
+  if (bytes != size)
+    {
+      fprintf (stderr, "profiled %llu of %zu bytes\n", bytes, size);
+      exit (-1);
+    }
+
+  snprintf (counts, sizeof (counts), "[%llu, %llu, %llu, %llu, %llu]",
+            (unsigned long long) profile.calls[JSON_DECODE_PHASE_NUMBER],
+            (unsigned long long) profile.calls[JSON_DECODE_PHASE_STRING],
+            (unsigned long long) profile.calls[JSON_DECODE_PHASE_LITERAL],
+            (unsigned long long) profile.calls[JSON_DECODE_PHASE_ARRAY],
+            (unsigned long long) profile.calls[JSON_DECODE_PHASE_OBJECT]);
+
+  return json_decode (NULL, counts, strlen (counts), NULL);
 }
 
 static void
@@ -114,8 +1426,35 @@ run_test (const char *filename, const char *expected)
       exit (-1);
     }
 
+  if (test_mode == TEST_MODE_BATCH)
+    run_batch_test (buf, size);
+
+  if (test_mode == TEST_MODE_MINIFY || test_mode == TEST_MODE_PRETTIFY)
+    {
+      run_format_test (buf, size, expected);
+      free (buf);
+      return;
+    }
+
   json_decode_error decode_error;
-  json_value *value = json_decode (decoder_opts, buf, size, &decode_error);
+  json_value *value;
+
+  if (test_mode == TEST_MODE_STATS)
+    value = run_stats_test (buf, size);
+  else if (test_mode == TEST_MODE_PROFILE)
+    value = run_profile_test (buf, size);
+  else if (test_mode == TEST_MODE_LAZY)
+    value = run_lazy_test (buf, size);
+  else if (test_mode == TEST_MODE_SLAB)
+    value = run_slab_test (buf, size);
+  else if (test_mode == TEST_MODE_REUSE)
+    value = run_reuse_test (buf, size);
+  else if (test_mode == TEST_MODE_PIPE)
+    value = run_pipe_test (filename, buf, size, &decode_error);
+  else if (test_mode == TEST_MODE_VALIDATE)
+    value = run_validate_test (buf, size, &decode_error);
+  else
+    value = json_decode (decoder_opts, buf, size, &decode_error);
 
   if (value == NULL)
     {
@@ -124,6 +1463,23 @@ run_test (const char *filename, const char *expected)
       exit (-1);
     }
 
+  if (test_mode == TEST_MODE_MSGPACK || test_mode == TEST_MODE_CBOR)
+    value = run_binary_test (value);
+  else if (test_mode == TEST_MODE_SNAPSHOT)
+    value = run_snapshot_test (value);
+  else if (test_mode == TEST_MODE_KEYS)
+    value = run_keys_test (value);
+  else if (test_mode == TEST_MODE_VIEW)
+    value = run_view_test (value);
+  else if (test_mode == TEST_MODE_COLUMNS)
+    value = run_columns_test (value);
+  else if (test_mode == TEST_MODE_CLONE)
+    value = run_clone_test (value);
+  else if (test_mode == TEST_MODE_PATCH || test_mode == TEST_MODE_MERGE)
+    value = run_patch_test (value);
+  else if (test_mode == TEST_MODE_REDECODE)
+    value = run_redecode_test (value, &buf, &size);
+
   if (expected)
     {
       char tmpbuf[512];
@@ -144,6 +1500,7 @@ run_test (const char *filename, const char *expected)
       printf ("\n");
     }
 
+  json_value_destroy (value);
   free (buf);
 }
 
@@ -151,6 +1508,10 @@ int
 main (int argc, char *argv[])
 {
   static json_decoder_opts ext_opts = STD_DECODER_OPTS;
+  static json_decoder_opts packed_opts, depth_opts;
+  int pack_arrays = 0;
+  ju32 max_depth  = JSON_ANY_DEPTH;
+
   // we allow all extensions for ext tests
   ext_opts.ext_flags = JSON_EXT_ALL;
 
@@ -172,16 +1533,111 @@ main (int argc, char *argv[])
           if (arg[0] == '-')
             while ((++arg)[0])
               {
-                if (arg[0] == 'e')
+                switch (arg[0])
                   {
+                  case 'e':
                     decoder_opts = &ext_opts;
-                    goto run_tests;
+                    break;
+                  case 'm':
+                    test_mode = TEST_MODE_MINIFY;
+                    break;
+                  case 'p':
+                    test_mode = TEST_MODE_PRETTIFY;
+                    break;
+                  case 'b':
+                    test_mode = TEST_MODE_MSGPACK;
+                    break;
+                  case 'c':
+                    test_mode = TEST_MODE_CBOR;
+                    break;
+                  case 's':
+                    test_mode = TEST_MODE_SNAPSHOT;
+                    break;
+                  case 'k':
+                    test_mode = TEST_MODE_CLONE;
+                    break;
+                  case 'j':
+                    test_mode = TEST_MODE_PATCH;
+                    break;
+                  case 'g':
+                    test_mode = TEST_MODE_MERGE;
+                    break;
+                  case 'r':
+                    expect_rollback = 1;
+                    break;
+                  case 'u':
+                    test_mode = TEST_MODE_REDECODE;
+                    break;
+                  case 't':
+                    test_mode = TEST_MODE_BATCH;
+                    break;
+                  case 'a':
+                    test_mode = TEST_MODE_STATS;
+                    break;
+                  case 'f':
+                    test_mode = TEST_MODE_PROFILE;
+                    break;
+                  case 'y':
+                    test_mode = TEST_MODE_KEYS;
+                    break;
+                  case 'l':
+                    test_mode = TEST_MODE_LAZY;
+                    break;
+                  case 'd':
+                    pack_arrays = 1;
+                    break;
+                  case 'v':
+                    test_mode = TEST_MODE_VIEW;
+                    break;
+                  case 'o':
+                    test_mode = TEST_MODE_COLUMNS;
+                    break;
+                  case 'z':
+                    test_mode = TEST_MODE_SLAB;
+                    break;
+                  case 'x':
+                    test_mode = TEST_MODE_REUSE;
+                    break;
+                  case 'w':
+                    test_mode = TEST_MODE_PIPE;
+                    break;
+                  case 'i':
+                    keep_pipe_open = 1;
+                    break;
+                  case 'q':
+                    test_mode = TEST_MODE_VALIDATE;
+                    break;
+                  case 'h':
+                    max_depth = MAX_DEPTH;
+                    break;
                   }
               }
         }
     }
 
-run_tests:
+  // -d packs arrays under any other mode and options
+  if (pack_arrays)
+    {
+      packed_opts = decoder_opts ? *decoder_opts
+                                 : (json_decoder_opts) STD_DECODER_OPTS;
+      packed_opts.pack_arrays = JSON_TRUE;
+      decoder_opts            = &packed_opts;
+    }
+
+  // -h limits the nesting depth the same way, but only of the binary decode
+  // under -b and -c, so that the text can be deeper than the limit
+  if (max_depth != JSON_ANY_DEPTH)
+    {
+      depth_opts = decoder_opts ? *decoder_opts
+                                : (json_decoder_opts) STD_DECODER_OPTS;
+      depth_opts.max_depth = max_depth;
+
+      if (test_mode == TEST_MODE_MSGPACK || test_mode == TEST_MODE_CBOR)
+        binary_opts = &depth_opts;
+      else
+        decoder_opts = &depth_opts;
+    }
+
   for (int i = 1; i < argc;)
     {
       char *filename = argv[i];